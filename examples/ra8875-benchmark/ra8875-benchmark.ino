@@ -0,0 +1,579 @@
+#pragma GCC diagnostic warning "-Wall"
+#include "NiftyRA8875.h"
+
+// Fixed workloads for comparing library versions and boards.
+//
+// Every workload uses a fixed random seed, so each run draws exactly the same thing. Results
+//  are printed to Serial as CSV, one line per workload:
+//
+//   name,ops,us,ops_per_s,spi_bytes_per_op,wait_us
+//
+// spi_bytes_per_op and wait_us come from the library's SPI cost counters, and are -1 unless
+//  RA8875_ENABLE_STATS is set in NiftyRA8875.h. Lines starting with # are comments.
+//
+// The sketch also runs on a host machine against the emulator; see extras/host/README.md.
+
+const int csPin = 10;
+
+RA8875 tft = RA8875(csPin);
+
+const unsigned long seed = 8875;
+
+int width;
+int height;
+
+void beginBench(void);
+void endBench(const char *name, uint32_t ops);
+void pixelBench(void);
+void burstBench(void);
+void bitmapBench(void);
+void monoBench(void);
+void hlineBench(void);
+void vlineBench(void);
+void rectBench(void);
+void gradientBench(void);
+void fillRectsBench(void);
+void polylineBench(void);
+void triangleBench(void);
+void circleBench(void);
+void ellipseBench(void);
+void roundRectBench(void);
+void rasterBench(void);
+void copyBench(void);
+void textBench(int size);
+void printCharBench(void);
+void printIntBench(void);
+void logLine(char *buffer, size_t size, int i);
+void consoleBench(void);
+void screen(void);
+void listBench(void);
+void clearBench(void);
+
+uint32_t benchStart;
+
+void setup()
+{
+  Serial.begin(9600);
+
+  delay(2000);
+
+  if (!tft.init(480, 272, 16))
+  {
+    Serial.println("# TFT init failed.");
+    return;
+  }
+
+  tft.clearMemory();
+  tft.setBacklight(true);
+
+  width = tft.getWidth();
+  height = tft.getHeight();
+
+  Serial.print("# NiftyRA8875 benchmark "); Serial.print(width); Serial.print("x"); Serial.println(height);
+  Serial.println("name,ops,us,ops_per_s,spi_bytes_per_op,wait_us");
+
+  pixelBench();
+  burstBench();
+  bitmapBench();
+  monoBench();
+  hlineBench();
+  vlineBench();
+  rectBench();
+  gradientBench();
+  fillRectsBench();
+  polylineBench();
+  triangleBench();
+  circleBench();
+  ellipseBench();
+  roundRectBench();
+  rasterBench();
+  copyBench();
+  for (int size = 1; size <= 4; size++)
+    textBench(size);
+  printCharBench();
+  printIntBench();
+  consoleBench();
+  listBench();
+  clearBench();
+
+  Serial.println("# done");
+}
+
+void beginBench(void)
+{
+  randomSeed(seed);
+#if RA8875_ENABLE_STATS
+  tft.resetStats();
+#endif
+  benchStart = micros();
+}
+
+void endBench(const char *name, uint32_t ops)
+{
+  // Let any pipelined work finish so it's counted
+  tft.sync();
+
+  uint32_t us = micros() - benchStart;
+
+  long bytesPerOp = -1;
+  long waitUs = -1;
+
+#if RA8875_ENABLE_STATS
+  uint32_t bytes = 0;
+  waitUs = 0;
+  for (int i = 0; i < RA8875_OP_COUNT; i++)
+  {
+    bytes += tft.getStats((enum RA8875_Stat_Op) i).bytes;
+    waitUs += tft.getStats((enum RA8875_Stat_Op) i).waitMicros;
+  }
+  bytesPerOp = bytes / ops;
+#endif
+
+  Serial.print(name); Serial.print(",");
+  Serial.print(ops); Serial.print(",");
+  Serial.print(us); Serial.print(",");
+  Serial.print((uint32_t) ((uint64_t) ops * 1000000 / max(us, (uint32_t) 1))); Serial.print(",");
+  Serial.print(bytesPerOp); Serial.print(",");
+  Serial.println(waitUs);
+}
+
+// Single pixels at random positions
+void pixelBench(void)
+{
+  const uint32_t ops = 5000;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+    tft.drawPixel(random(0, width), random(0, height), random(0, 0xFFFF));
+  endBench("pixel", ops);
+}
+
+// Full screen of pixels as one stream. One op is one pixel.
+void burstBench(void)
+{
+  uint16_t row[64];
+
+  beginBench();
+  tft.beginPixels(0, 0);
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x += 64)
+    {
+      int n = min(64, width - x);
+      for (int i = 0; i < n; i++)
+        row[i] = RGB565(x + i, y, 128);
+      tft.pushPixels(row, n);
+    }
+  }
+  tft.endPixels();
+  endBench("burst", (uint32_t) width * height);
+}
+
+// 32x32 RGB565 images at random positions, partly off screen
+void bitmapBench(void)
+{
+  const uint32_t ops = 200;
+  static uint16_t image[32 * 32];
+
+  for (int i = 0; i < 32 * 32; i++)
+    image[i] = RGB565(i % 32 * 8, i / 32 * 8, 255);
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+    tft.drawBitmap(random(-16, width - 16), random(-16, height - 16), 32, 32, image, 32 * sizeof(uint16_t), RA8875_BITMAP_RGB565);
+  endBench("bitmap32", ops);
+}
+
+// The same 32x32 images as 1bpp, expanded to colour by the BTE
+void monoBench(void)
+{
+  const uint32_t ops = 200;
+  static uint8_t image[32 / 8 * 32];
+
+  for (int i = 0; i < 32 / 8 * 32; i++)
+    image[i] = (i & 4) ? 0xAA : 0x55;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+    tft.drawMono(random(-16, width - 16), random(-16, height - 16), 32, 32, image, RGB565(255, 255, 255), RGB565(0, 0, 255));
+  endBench("mono32", ops);
+}
+
+void hlineBench(void)
+{
+  const uint32_t ops = 1000;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+  {
+    int y = random(0, height);
+    tft.drawLine(random(0, width), y, random(0, width), y, random(0, 0xFFFF));
+  }
+  endBench("hline", ops);
+}
+
+void vlineBench(void)
+{
+  const uint32_t ops = 1000;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+  {
+    int x = random(0, width);
+    tft.drawLine(x, random(0, height), x, random(0, height), random(0, 0xFFFF));
+  }
+  endBench("vline", ops);
+}
+
+void rectBench(void)
+{
+  const uint32_t ops = 500;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+  {
+    int x = random(0, width - 64), y = random(0, height - 64);
+    tft.fillRect(x, y, x + random(1, 64), y + random(1, 64), random(0, 0xFFFF));
+  }
+  endBench("fillRect", ops);
+}
+
+// Vertical bars a step apart, each in its own colour, as the demo's gradient test draws them
+void gradientBench(void)
+{
+  const int steps = 256;
+  int barHeight = height / 4;
+
+  beginBench();
+  for (int i = 0; i < steps; i++)
+  {
+    int x = (long) width * i / steps;
+    tft.fillRect(x, 0, x + 1, barHeight, RGB565(i, 0, 0));
+    tft.fillRect(x, barHeight, x + 1, barHeight * 2, RGB565(0, i, 0));
+    tft.fillRect(x, barHeight * 2, x + 1, barHeight * 3, RGB565(0, 0, i));
+    tft.fillRect(x, barHeight * 3, x + 1, barHeight * 4, RGB565(i, i, i));
+  }
+  endBench("gradient", steps * 4);
+}
+
+// A bar graph in one colour, 60 bars per call
+void fillRectsBench(void)
+{
+  const int graphs = 8;
+  const int bars = 60;
+  RA8875_Rect rects[bars];
+
+  beginBench();
+  for (int g = 0; g < graphs; g++)
+  {
+    for (int i = 0; i < bars; i++)
+    {
+      rects[i].x1 = i * width / bars;
+      rects[i].x2 = rects[i].x1 + width / bars - 2;
+      rects[i].y1 = random(0, height - 1);
+      rects[i].y2 = height - 1;
+    }
+    tft.fillRects(rects, bars, random(0, 0xFFFF));
+  }
+  endBench("fillRects", graphs * bars);
+}
+
+// A chart trace, one op per segment: joined drawLine() calls, then drawPolyline()
+void polylineBench(void)
+{
+  const int points = 121;
+  RA8875_Point trace[points];
+
+  randomSeed(seed);
+  for (int i = 0; i < points; i++)
+  {
+    trace[i].x = i * (width - 1) / (points - 1);
+    trace[i].y = random(0, height);
+  }
+
+  beginBench();
+  for (int i = 1; i < points; i++)
+    tft.drawLine(trace[i - 1].x, trace[i - 1].y, trace[i].x, trace[i].y, RGB565(255, 255, 0));
+  endBench("lineChain", points - 1);
+
+  beginBench();
+  tft.drawPolyline(trace, points, RGB565(0, 255, 255));
+  endBench("polyline", points - 1);
+}
+
+void triangleBench(void)
+{
+  const uint32_t ops = 500;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+  {
+    tft.fillTriangle(random(0, width), random(0, height), random(0, width), random(0, height),
+      random(0, width), random(0, height), random(0, 0xFFFF));
+  }
+  endBench("fillTriangle", ops);
+}
+
+void circleBench(void)
+{
+  const uint32_t ops = 200;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+    tft.fillCircle(random(0, width), random(0, height), random(1, 100), random(0, 0xFFFF));
+  endBench("fillCircle", ops);
+}
+
+// Filled ellipses of random sizes, by the ellipse engine
+void ellipseBench(void)
+{
+  const uint32_t ops = 200;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+    tft.fillEllipse(random(0, width), random(0, height), random(1, 100), random(1, 60), random(0, 0xFFFF));
+  endBench("fillEllipse", ops);
+}
+
+// Rounded buttons: first built from two rects and four circles, then by the ellipse engine
+void roundRectBench(void)
+{
+  const uint32_t ops = 200;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+  {
+    int x1 = random(0, width - 120), y1 = random(0, height - 60);
+    int x2 = x1 + random(40, 120), y2 = y1 + random(30, 60), r = 10;
+    uint16_t color = random(0, 0xFFFF);
+
+    tft.fillRect(x1 + r, y1, x2 - r, y2, color);
+    tft.fillRect(x1, y1 + r, x2, y2 - r, color);
+    tft.fillCircle(x1 + r, y1 + r, r, color);
+    tft.fillCircle(x2 - r, y1 + r, r, color);
+    tft.fillCircle(x1 + r, y2 - r, r, color);
+    tft.fillCircle(x2 - r, y2 - r, r, color);
+  }
+  endBench("roundRectParts", ops);
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+  {
+    int x1 = random(0, width - 120), y1 = random(0, height - 60);
+    int x2 = x1 + random(40, 120), y2 = y1 + random(30, 60);
+
+    tft.fillRoundRect(x1, y1, x2, y2, 10, random(0, 0xFFFF));
+  }
+  endBench("fillRoundRect", ops);
+}
+
+// Shapes the engine can't draw, rasterised into spans by the library
+void rasterBench(void)
+{
+  const uint32_t ops = 100;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+    tft.drawThickLine(random(0, width), random(0, height), random(0, width), random(0, height), random(2, 10),
+                      random(0, 0xFFFF));
+  endBench("thickLine", ops);
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+    tft.drawLineAA(random(0, width), random(0, height), random(0, width), random(0, height), random(0, 0xFFFF), 0);
+  endBench("lineAA", ops);
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+  {
+    int start = random(0, 360);
+
+    tft.drawArc(random(0, width), random(0, height), random(10, 80), random(2, 20), start, start + random(10, 350),
+                random(0, 0xFFFF));
+  }
+  endBench("arc", ops);
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+  {
+    RA8875_Point star[5];
+    uint16_t count = 5;
+
+    for (int p = 0; p < 5; p++)
+    {
+      star[p].x = random(0, width);
+      star[p].y = random(0, height);
+    }
+    tft.fillComplexPolygon(star, &count, 1, random(0, 0xFFFF));
+  }
+  endBench("complexPolygon", ops);
+}
+
+// 64x64 block moves within layer 1
+void copyBench(void)
+{
+  const uint32_t ops = 200;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+    tft.copy(1, random(0, width - 64), random(0, height - 64), 64, 64, 1, random(0, width - 64), random(0, height - 64));
+  endBench("copy64", ops);
+}
+
+// One op is one character
+void textBench(int size)
+{
+  const char *line = "The quick brown fox 0123456789";
+  const int lines = 8;
+  char name[8] = "text1";
+  name[4] = '0' + size;
+
+  tft.clearMemory();
+  tft.setTextSize(size);
+
+  beginBench();
+  tft.setCursor(0, 0);
+  for (int i = 0; i < lines; i++)
+    tft.println(line);
+  endBench(name, (uint32_t) lines * (strlen(line) + 2));
+
+  tft.setTextSize(1);
+}
+
+// One character per call, as Print does for print(char)
+void printCharBench(void)
+{
+  const uint32_t ops = 480;
+
+  tft.clearMemory();
+
+  beginBench();
+  tft.setCursor(0, 0);
+  for (uint32_t i = 0; i < ops; i++)
+    tft.print((char) ('A' + i % 26));
+  endBench("printChar", ops);
+}
+
+// Short numbers, one line each, as a log or readout would print them. Ops are characters,
+//  counting the line ends.
+void printIntBench(void)
+{
+  const int lines = 64;
+  uint32_t chars = 0;
+
+  tft.clearMemory();
+
+  beginBench();
+  tft.setCursor(0, 0);
+  for (int i = 0; i < lines; i++)
+  {
+    long value = (i * 7919L) % 100000;
+    chars += tft.println(value);
+    if (i % 16 == 15)
+      tft.setCursor(0, 0);
+  }
+  endBench("printInt", chars);
+}
+
+// A line of a made-up sensor log
+void logLine(char *buffer, size_t size, int i)
+{
+  snprintf(buffer, size, "%05d sensor %d reads %d", i * 37, i % 5, (i * 7919) % 1000);
+}
+
+// A scrolling log, one op per line once the screen is full: first through a console, then by
+//  clearing and reprinting the visible lines, as a sketch would without one
+void consoleBench(void)
+{
+  const int lines = 32;
+  const int rows = height / RA8875_ROM_TEXT_HEIGHT;
+  char line[40];
+  RA8875_Console console;
+
+  tft.setConsole(&console, 0, 0, width - 1, height - 1, 0);
+  for (int i = 0; i < rows; i++)
+  {
+    logLine(line, sizeof(line), i);
+    tft.println(line);
+  }
+
+  beginBench();
+  for (int i = rows; i < rows + lines; i++)
+  {
+    logLine(line, sizeof(line), i);
+    tft.println(line);
+  }
+  endBench("console", lines);
+
+  tft.endConsole();
+  tft.setScrollOffset(0, 0);
+
+  beginBench();
+  for (int i = rows; i < rows + lines; i++)
+  {
+    tft.clearMemory();
+    tft.setCursor(0, 0);
+    for (int j = i - rows + 2; j <= i; j++)
+    {
+      logLine(line, sizeof(line), j);
+      tft.println(line);
+    }
+  }
+  endBench("reprint", lines);
+}
+
+// A small static screen: panels, frames and labels
+void screen(void)
+{
+  tft.setTextColor(255, 255, 255);
+  for (int i = 0; i < 6; i++)
+  {
+    int x = (i % 3) * 160, y = (i / 3) * 136;
+
+    tft.fillRect(x + 4, y + 4, x + 155, y + 131, RGB565(32, 32, 96));
+    tft.drawRect(x + 4, y + 4, x + 155, y + 131, RGB565(128, 128, 192));
+    tft.setCursor(x + 12, y + 12);
+    tft.print("Channel ");
+    tft.print(i + 1);
+  }
+}
+
+// The same screen drawn by its calls and replayed from a display list, one op per screen
+void listBench(void)
+{
+  const uint32_t ops = 16;
+  static uint8_t list[1024];
+  RA8875_Recorder recorder;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+    screen();
+  endBench("screen", ops);
+
+  tft.beginRecording(&recorder, list, sizeof(list));
+  screen();
+  if (!tft.endRecording())
+  {
+    Serial.println("# display list too long");
+    return;
+  }
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+    tft.playDisplayList(list);
+  endBench("replay", ops);
+}
+
+void clearBench(void)
+{
+  const uint32_t ops = 4;
+
+  beginBench();
+  for (uint32_t i = 0; i < ops; i++)
+    tft.clearMemory();
+  endBench("clearMemory", ops);
+}
+
+void loop()
+{
+}
@@ -3,8 +3,21 @@
 
 const int csPin = 10;
 const int resetPin = 9;
+const int intPin = 8;
 
 //RA8875 tft = RA8875(csPin, resetPin);
+//RA8875 tft = RA8875(csPin, resetPin, intPin);
+
+void textTest();
+void textColorTest();
+void smpteBarsTest();
+void gradientTest();
+void pixelTest();
+void pixelBurstTest();
+void triangleTest();
+void triangleRun(bool pipelined);
+void circleTest();
+void circleRun(bool pipelined);
 RA8875 tft = RA8875(csPin);
 
 void setup()
@@ -46,6 +59,10 @@ void setup()
 
   delay(1000);
 
+  pixelBurstTest();
+
+  delay(1000);
+
   triangleTest();
   
   delay(1000);
@@ -212,13 +229,69 @@ void pixelTest()
     
 }
 
+// Fills the screen with a horizontal gradient, once pixel by pixel and once as a single stream.
+void pixelBurstTest()
+{
+  Serial.println("Pixel burst test.");
+
+  int width = tft.getWidth();
+  int height = tft.getHeight();
+  uint32_t bytes = (uint32_t) width * height * 2;
+
+  uint32_t starttime = millis();
+
+  tft.setDrawPosition(0, 0);
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+      tft.pushPixel(RGB565(x * 255L / width, 0, 255 - (x * 255L / width)));
+  }
+
+  uint32_t elapsedtime = millis() - starttime;
+  Serial.print("pushPixel() fill took "); Serial.print(elapsedtime); Serial.print(" ms, ");
+  Serial.print(bytes * 1000 / (elapsedtime ? elapsedtime : 1)); Serial.println(" pixel bytes/s");
+
+  starttime = millis();
+
+  // A small buffer at a time, so a wide display doesn't need a whole row on the stack
+  uint16_t chunk[32];
+
+  tft.beginPixels(0, 0);
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x += 32)
+    {
+      int count = min(width - x, 32);
+      for (int i = 0; i < count; i++)
+        chunk[i] = RGB565((x + i) * 255L / width, 0, 255 - ((x + i) * 255L / width));
+      tft.pushPixels(chunk, count);
+    }
+  }
+  tft.endPixels();
+
+  elapsedtime = millis() - starttime;
+  Serial.print("pushPixels() fill took "); Serial.print(elapsedtime); Serial.print(" ms, ");
+  Serial.print(bytes * 1000 / (elapsedtime ? elapsedtime : 1)); Serial.println(" pixel bytes/s");
+}
+
 void triangleTest()
 {
   Serial.println("Triangle test.");
 
+  // Same triangles both times. When pipelined, computing the next triangle overlaps the fill of
+  //  the previous one.
+  triangleRun(false);
+  triangleRun(true);
+}
+
+void triangleRun(bool pipelined)
+{
   int width = tft.getWidth();
   int height = tft.getHeight();
 
+  tft.setPipelined(pipelined);
+  randomSeed(1);
+
   uint32_t starttime = millis();
 
   for (int i = 0; i < 2000; i++)
@@ -235,17 +308,30 @@ void triangleTest()
     tft.fillTriangle(x1, y1, x2, y2, x3, y3, color);
   }
 
+  tft.sync();
+
   uint32_t elapsedtime = millis() - starttime;
-  Serial.print("Triangle test took "); Serial.print(elapsedtime); Serial.println(" ms");
+  Serial.print(pipelined ? "Triangle test (pipelined) took " : "Triangle test took "); Serial.print(elapsedtime); Serial.println(" ms");
+
+  tft.setPipelined(false);
 }
 
 void circleTest()
 {
   Serial.println("Circle test.");
 
+  circleRun(false);
+  circleRun(true);
+}
+
+void circleRun(bool pipelined)
+{
   int width = tft.getWidth();
   int height = tft.getHeight();
 
+  tft.setPipelined(pipelined);
+  randomSeed(1);
+
   uint32_t starttime = millis();
 
   for (int i = 0; i < 200; i++)
@@ -259,8 +345,12 @@ void circleTest()
     tft.fillCircle(x, y, r, color);
   }
 
+  tft.sync();
+
   uint32_t elapsedtime = millis() - starttime;
-  Serial.print("Circle test took "); Serial.print(elapsedtime); Serial.println(" ms");
+  Serial.print(pipelined ? "Circle test (pipelined) took " : "Circle test took "); Serial.print(elapsedtime); Serial.println(" ms");
+
+  tft.setPipelined(false);
 }
 
 void loop()
@@ -0,0 +1,151 @@
+// Host implementations of the Arduino core functions declared in Arduino.h.
+
+#include "Arduino.h"
+#include "SPI.h"
+
+#include <chrono>
+
+HostSerial Serial;
+SPIClass SPI;
+
+static unsigned long long s_delayedMicros = 0;
+
+static int (*s_digitalReadHook)(void *context, int pin) = NULL;
+static void *s_digitalReadContext = NULL;
+
+static unsigned long long (*s_clockHook)(void *context) = NULL;
+static void *s_clockContext = NULL;
+
+static void (*s_delayHook)(void *context, unsigned long long us) = NULL;
+static void *s_delayContext = NULL;
+
+static unsigned long long elapsedMicros(void)
+{
+  if (s_clockHook)
+    return s_clockHook(s_clockContext) + s_delayedMicros;
+
+  static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::duration d = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration_cast<std::chrono::microseconds>(d).count() + s_delayedMicros;
+}
+
+unsigned long millis(void) { return elapsedMicros() / 1000; }
+unsigned long micros(void) { return elapsedMicros(); }
+
+static void addDelay(unsigned long long us)
+{
+  if (s_delayHook)
+    s_delayHook(s_delayContext, us);
+  else
+    s_delayedMicros += us;
+}
+
+void delay(unsigned long ms) { addDelay(ms * 1000ULL); }
+void delayMicroseconds(unsigned int us) { addDelay(us); }
+void yield(void) {}
+
+void hostSetClockHook(unsigned long long (*hook)(void *context), void *context)
+{
+  s_clockHook = hook;
+  s_clockContext = context;
+}
+
+void hostSetDelayHook(void (*hook)(void *context, unsigned long long us), void *context)
+{
+  s_delayHook = hook;
+  s_delayContext = context;
+}
+
+void pinMode(int pin, int mode) { (void) pin; (void) mode; }
+void digitalWrite(int pin, int value) { (void) pin; (void) value; }
+
+int digitalRead(int pin)
+{
+  return s_digitalReadHook ? s_digitalReadHook(s_digitalReadContext, pin) : HIGH;
+}
+
+void hostSetDigitalReadHook(int (*hook)(void *context, int pin), void *context)
+{
+  s_digitalReadHook = hook;
+  s_digitalReadContext = context;
+}
+
+// Same generator on every host, so seeded runs are reproducible
+static uint32_t s_randomState = 1;
+
+static uint32_t nextRandom(void)
+{
+  s_randomState = s_randomState * 1103515245UL + 12345UL;
+  return (s_randomState >> 1) & 0x7FFFFFFF;
+}
+
+long random(long howbig)
+{
+  if (howbig <= 0)
+    return 0;
+  return nextRandom() % howbig;
+}
+
+long random(long howsmall, long howbig)
+{
+  if (howsmall >= howbig)
+    return howsmall;
+  return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed)
+{
+  if (seed != 0)
+    s_randomState = seed;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--)
+    n += write(*buffer++);
+  return n;
+}
+
+size_t Print::print(long n, int base)
+{
+  if ((base == DEC) && (n < 0))
+    return print('-') + print((unsigned long) -n, base);
+  return print((unsigned long) n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *p = &buf[sizeof(buf) - 1];
+  *p = '\0';
+
+  if (base < 2)
+    base = 10;
+
+  do
+  {
+    unsigned long digit = n % base;
+    n /= base;
+    *--p = (digit < 10) ? ('0' + digit) : ('A' + digit - 10);
+  } while (n);
+
+  return write(p);
+}
+
+size_t Print::print(double n, int digits)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return write(buf);
+}
+
+size_t HostSerial::write(uint8_t c)
+{
+  return (fputc(c, stdout) == EOF) ? 0 : 1;
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size)
+{
+  return fwrite(buffer, 1, size, stdout);
+}
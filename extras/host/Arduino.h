@@ -0,0 +1,105 @@
+// Minimal stand-in for the Arduino core, for building the library on a host machine.
+// Only what the library and its examples use is provided.
+
+#ifndef RA8875_HOST_ARDUINO_H
+#define RA8875_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define HIGH 1
+#define LOW  0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PROGMEM
+#define F(s) (s)
+#define pgm_read_byte(p)  (*(const uint8_t *) (p))
+#define pgm_read_word(p)  (*(const uint16_t *) (p))
+#define pgm_read_dword(p) (*(const uint32_t *) (p))
+#define pgm_read_ptr(p)   (*(void * const *) (p))
+#define memcpy_P memcpy
+#define strlen_P strlen
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+template <typename T, typename U> inline T min(T a, U b) { return (a < (T) b) ? a : (T) b; }
+template <typename T, typename U> inline T max(T a, U b) { return (a > (T) b) ? a : (T) b; }
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// Time is virtual: delay() advances the clock instead of sleeping, so sketches run at full speed.
+// By default the clock otherwise follows the host's clock. A hook can supply the time instead,
+//  e.g. the emulator's model of how long the SPI traffic so far would take. A delay hook then
+//  lets delays advance that model too, so the device sees the time pass.
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+void hostSetClockHook(unsigned long long (*hook)(void *context), void *context);
+void hostSetDelayHook(void (*hook)(void *context, unsigned long long us), void *context);
+
+// Pins do nothing, except that reads can be answered by a hook (e.g. an emulated INT line).
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+void hostSetDigitalReadHook(int (*hook)(void *context, int pin), void *context);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+class Print
+{
+public:
+  virtual ~Print() {};
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str ? write((const uint8_t *) str, strlen(str)) : 0; };
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *) buffer, size); };
+
+  size_t print(const char *s) { return write(s); };
+  size_t print(char c) { return write((uint8_t) c); };
+  size_t print(unsigned char n, int base = DEC) { return print((unsigned long) n, base); };
+  size_t print(int n, int base = DEC) { return print((long) n, base); };
+  size_t print(unsigned int n, int base = DEC) { return print((unsigned long) n, base); };
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(double n, int digits = 2);
+
+  size_t println(void) { return write("\r\n"); };
+  template <typename T> size_t println(T x) { size_t n = print(x); return n + println(); };
+  template <typename T> size_t println(T x, int arg) { size_t n = print(x, arg); return n + println(); };
+};
+
+// Serial output goes to stdout
+class HostSerial : public Print
+{
+public:
+  void begin(unsigned long baud) { (void) baud; };
+  operator bool() { return true; };
+  size_t write(uint8_t c);
+  size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,1089 @@
+#include "RA8875Emulator.h"
+
+RA8875Emulator::RA8875Emulator()
+{
+  memset(m_regs, 0, sizeof(m_regs));
+  m_regs[RA8875_REG_PLLC1] = 0x07;  // Reset defaults: SYS_CLK is the crystal
+  m_regs[RA8875_REG_PLLC2] = 0x03;
+
+  m_selected    = false;
+  m_cycle       = CYCLE_NONE;
+  m_typePending = false;
+  m_reg         = 0;
+
+  m_pixelHalf = false;
+  m_pixelHigh = 0;
+  m_curX  = 0;
+  m_curY  = 0;
+  m_textX = 0;
+  m_textY = 0;
+
+  m_width  = 0;
+  m_height = 0;
+  m_depth  = 8;
+  m_layers[0] = NULL;
+  m_layers[1] = NULL;
+
+  // Rough figures for a 60MHz SYS_CLK. Override to model other setups.
+  m_spiClock = RA8875_SPI_SPEED;
+  m_drawRate = 30000000;
+  m_bteRate  = 15000000;
+
+  m_timeNs         = 0;
+  m_drawBusyUntil  = 0;
+  m_bteBusyUntil   = 0;
+  m_memBusyUntil   = 0;
+  m_clearBusyUntil = 0;
+  m_drawBusyBit    = 0;
+
+  m_bteWriteCount = 0;
+  m_bteWriteIndex = 0;
+
+  memset(m_patterns, 0, sizeof(m_patterns));
+  m_patternIndex = 0;
+
+  m_intPin    = -1;
+  m_intStatus = 0;
+
+  resetCounters();
+}
+
+RA8875Emulator::~RA8875Emulator()
+{
+  delete[] m_layers[0];
+  delete[] m_layers[1];
+}
+
+// SYS_CLK as configured by PLLC1 and PLLC2, assuming a RA8875_CRYSTAL_FREQ crystal.
+uint32_t RA8875Emulator::getSysClock(void)
+{
+  uint64_t hz = (uint64_t) RA8875_CRYSTAL_FREQ * ((m_regs[RA8875_REG_PLLC1] & 0x1F) + 1);
+  return hz / (1 << (m_regs[RA8875_REG_PLLC2] & 0x07));
+}
+
+void RA8875Emulator::resetCounters(void)
+{
+  memset(&m_counters, 0, sizeof(m_counters));
+}
+
+// --- Bus ---
+
+void RA8875Emulator::select(void)
+{
+  m_selected    = true;
+  m_typePending = true;
+  m_counters.selects++;
+}
+
+void RA8875Emulator::deselect(void)
+{
+  m_selected = false;
+  m_cycle    = CYCLE_NONE;
+}
+
+uint8_t RA8875Emulator::transfer(uint8_t x)
+{
+  m_counters.bytes++;
+  m_timeNs += 8000000000ULL / m_spiClock;
+
+  if (!m_selected)
+    return 0xFF;
+
+  // First byte after CS goes low selects the cycle type
+  if (m_typePending)
+  {
+    m_typePending = false;
+
+    switch (x & 0xC0)
+    {
+      case RA8875_CMD_WRITE:   m_cycle = CYCLE_CMD_WRITE;   m_counters.cmdWrites++;   break;
+      case RA8875_DATA_WRITE:  m_cycle = CYCLE_DATA_WRITE;  m_counters.dataWrites++;  break;
+      case RA8875_DATA_READ:   m_cycle = CYCLE_DATA_READ;   m_counters.dataReads++;   break;
+      case RA8875_STATUS_READ: m_cycle = CYCLE_STATUS_READ; m_counters.statusReads++; break;
+    }
+
+    // Writes may be clocked at up to SYS_CLK / 3, reads only up to SYS_CLK / 6
+    bool read = (m_cycle == CYCLE_DATA_READ) || (m_cycle == CYCLE_STATUS_READ);
+    if (m_spiClock > getSysClock() / (read ? 6 : 3))
+      m_counters.clockViolations++;
+
+    return 0;
+  }
+
+  switch (m_cycle)
+  {
+    case CYCLE_CMD_WRITE:
+      m_reg = x;
+      if (m_reg == RA8875_REG_MRWC)
+        m_pixelHalf = false;
+      return 0;
+
+    case CYCLE_DATA_WRITE:
+      if (upsetsEngine())
+        m_counters.engineOverruns++;
+
+      if (m_reg == RA8875_REG_MRWC)
+        memoryWrite(x);
+      else
+        writeRegister(m_reg, x);
+      return 0;
+
+    case CYCLE_DATA_READ:
+      return readRegister(m_reg);
+
+    case CYCLE_STATUS_READ:
+      return readStatus();
+
+    default:
+      return 0xFF;
+  }
+}
+
+// --- Registers ---
+
+void RA8875Emulator::writeRegister(uint8_t reg, uint8_t x)
+{
+  switch (reg)
+  {
+    case RA8875_REG_DCR:
+      m_regs[reg] = x & ~0xC0;
+      if (x & 0xC0)
+        startDraw(x);
+      return;
+
+    case RA8875_REG_ELLCR:
+      m_regs[reg] = x & ~0x80;
+      if (x & 0x80)
+        startEllipse(x);
+      return;
+
+    case RA8875_REG_BECR0:
+      m_regs[reg] = x & ~0x80;
+      if (x & 0x80)
+        startBTE();
+      return;
+
+    case RA8875_REG_MCLR:
+      m_regs[reg] = x & ~0x80;
+      if (x & 0x80)
+        startClear(x);
+      return;
+
+    case RA8875_REG_INTC2:
+      m_intStatus &= ~x;  // Write 1 to clear
+      return;
+
+    case RA8875_REG_PTNO:
+      m_regs[reg] = x;
+      m_patternIndex = 0;
+      return;
+  }
+
+  m_regs[reg] = x;
+
+  switch (reg)
+  {
+    case RA8875_REG_SYSR:
+    case RA8875_REG_HDWR:
+    case RA8875_REG_VDHR0:
+    case RA8875_REG_VDHR1:
+      configure();
+      break;
+
+    case RA8875_REG_CURH0:
+    case RA8875_REG_CURH1:
+      m_curX = regX(RA8875_REG_CURH0);
+      break;
+
+    case RA8875_REG_CURV0:
+    case RA8875_REG_CURV1:
+      m_curY = regY(RA8875_REG_CURV0);
+      break;
+
+    case RA8875_REG_FCURX0:
+    case RA8875_REG_FCURX1:
+      m_textX = regX(RA8875_REG_FCURX0);
+      break;
+
+    case RA8875_REG_FCURY0:
+    case RA8875_REG_FCURY1:
+      m_textY = regY(RA8875_REG_FCURY0);
+      break;
+  }
+}
+
+uint8_t RA8875Emulator::readRegister(uint8_t reg)
+{
+  bool busy;
+
+  switch (reg)
+  {
+    case RA8875_REG_DCR:
+      busy = (m_timeNs < m_drawBusyUntil);
+      checkBusy(busy);
+      return m_regs[reg] | (busy ? m_drawBusyBit : 0);
+
+    case RA8875_REG_ELLCR:
+      busy = (m_timeNs < m_drawBusyUntil);
+      checkBusy(busy);
+      return m_regs[reg] | (busy ? 0x80 : 0);
+
+    case RA8875_REG_BECR0:
+      busy = (m_timeNs < m_bteBusyUntil);
+      checkBusy(busy);
+      return m_regs[reg] | (busy ? 0x80 : 0);
+
+    case RA8875_REG_MCLR:
+      busy = (m_timeNs < m_clearBusyUntil);
+      checkBusy(busy);
+      return m_regs[reg] | (busy ? 0x80 : 0);
+
+    case RA8875_REG_INTC2:
+      isInterruptAsserted();
+      return m_intStatus;
+
+    case RA8875_REG_FCURX0: return m_textX & 0xFF;
+    case RA8875_REG_FCURX1: return m_textX >> 8;
+    case RA8875_REG_FCURY0: return m_textY & 0xFF;
+    case RA8875_REG_FCURY1: return m_textY >> 8;
+    case RA8875_REG_CURH0:  return m_curX & 0xFF;
+    case RA8875_REG_CURH1:  return m_curX >> 8;
+    case RA8875_REG_CURV0:  return m_curY & 0xFF;
+    case RA8875_REG_CURV1:  return m_curY >> 8;
+
+    case RA8875_REG_MRWC:
+      return 0;  // Memory reads aren't modelled
+  }
+
+  return m_regs[reg];
+}
+
+// Whether a data write now could upset a drawing operation still running. Nothing says the chip
+//  latches the draw engine's coordinates and colour when an operation starts, so any register
+//  written before it finishes counts. A BTE fed through MRWC expects its pixels.
+bool RA8875Emulator::upsetsEngine(void)
+{
+  bool draw  = (m_timeNs < m_drawBusyUntil) || (m_timeNs < m_clearBusyUntil);
+  bool bte   = (m_bteWriteCount == 0) && (m_timeNs < m_bteBusyUntil);
+
+  return draw || bte;
+}
+
+// Status register: bit 7 is memory read/write busy, bit 6 is BTE busy.
+uint8_t RA8875Emulator::readStatus(void)
+{
+  uint8_t status = 0;
+
+  if (m_timeNs < m_memBusyUntil)
+    status |= 0x80;
+  if (m_timeNs < m_bteBusyUntil)
+    status |= 0x40;
+
+  checkBusy(status != 0);
+
+  return status;
+}
+
+bool RA8875Emulator::isInterruptAsserted(void)
+{
+  // The BTE interrupt fires once the operation has had time to finish
+  if ((m_bteBusyUntil != 0) && (m_timeNs >= m_bteBusyUntil))
+  {
+    m_intStatus |= RA8875_INT_BTE;
+    m_bteBusyUntil = 0;
+  }
+
+  return (m_intStatus & m_regs[RA8875_REG_INTC1]) != 0;
+}
+
+int RA8875Emulator::hostDigitalRead(void *context, int pin)
+{
+  RA8875Emulator *emu = (RA8875Emulator *) context;
+
+  // Each poll of a pin takes some time on the MCU
+  emu->m_timeNs += 1000;
+
+  if (pin != emu->m_intPin)
+    return HIGH;
+
+  return emu->isInterruptAsserted() ? LOW : HIGH;  // Active low
+}
+
+// Picks up a change of display size or colour depth.
+void RA8875Emulator::configure(void)
+{
+  int width  = (m_regs[RA8875_REG_HDWR] + 1) * 8;
+  int height = reg16(RA8875_REG_VDHR0) + 1;
+  int depth  = (m_regs[RA8875_REG_SYSR] & 0x0C) ? 16 : 8;
+
+  if ((width == m_width) && (height == m_height) && (depth == m_depth))
+    return;
+
+  m_width  = width;
+  m_height = height;
+  m_depth  = depth;
+
+  for (int i = 0; i < 2; i++)
+  {
+    delete[] m_layers[i];
+    m_layers[i] = new uint16_t[m_width * m_height];
+    memset(m_layers[i], 0, m_width * m_height * sizeof(uint16_t));
+  }
+}
+
+// Reads a colour from three consecutive R, G, B registers (FGCR, BGCR or BGTR).
+uint16_t RA8875Emulator::colorFromRegs(uint8_t reg)
+{
+  uint8_t r = m_regs[reg], g = m_regs[reg + 1], b = m_regs[reg + 2];
+
+  if (m_depth == 16)
+    return ((r & 0x1F) << 11) | ((g & 0x3F) << 5) | (b & 0x1F);
+  else
+    return ((r & 0x07) << 5) | ((g & 0x07) << 2) | (b & 0x03);
+}
+
+// --- Memory ---
+
+// Only 8bpp, or 16bpp up to 480 pixels wide, has room for a second layer.
+int RA8875Emulator::getLayerCount(void)
+{
+  return ((m_depth == 16) && (m_width > 480)) ? 1 : 2;
+}
+
+bool RA8875Emulator::inActiveWindow(int x, int y)
+{
+  return (x >= regX(RA8875_REG_HSAW0)) && (x <= regX(RA8875_REG_HEAW0)) &&
+         (y >= regY(RA8875_REG_VSAW0)) && (y <= regY(RA8875_REG_VEAW0));
+}
+
+void RA8875Emulator::plot(int layer, int x, int y, uint16_t color)
+{
+  if ((layer >= getLayerCount()) || (x < 0) || (y < 0) || (x >= m_width) || (y >= m_height))
+    return;
+
+  m_layers[layer][y * m_width + x] = color;
+}
+
+uint16_t RA8875Emulator::peek(int layer, int x, int y)
+{
+  if ((layer >= getLayerCount()) || (x < 0) || (y < 0) || (x >= m_width) || (y >= m_height))
+    return 0;
+
+  return m_layers[layer][y * m_width + x];
+}
+
+uint16_t RA8875Emulator::getPixel(int layer, int x, int y)
+{
+  return peek(layer - 1, x, y);
+}
+
+// Marks a unit busy for long enough to process the given number of pixels.
+// Operations queue up behind whatever is still running.
+void RA8875Emulator::busyFor(uint64_t *until, uint32_t pixels, uint32_t rate)
+{
+  uint64_t ns = (uint64_t) pixels * 1000000000ULL / rate;
+  uint64_t start = (*until > m_timeNs) ? *until : m_timeNs;
+
+  *until = start + ns;
+
+  m_counters.busyNs += ns;
+  m_counters.pixelsDrawn += pixels;
+}
+
+// --- Memory write port ---
+
+void RA8875Emulator::memoryWrite(uint8_t x)
+{
+  // A BTE operation waiting for data from the MCU takes it all
+  if (m_bteWriteCount > 0)
+  {
+    uint8_t op = m_regs[RA8875_REG_BECR1] & 0x0F;
+    if ((op == 0x08) || (op == 0x09))
+    {
+      bteExpandByte(x);
+      return;
+    }
+
+    if ((m_depth == 8) || m_pixelHalf)
+    {
+      bteWritePixel((m_depth == 8) ? x : ((m_pixelHigh << 8) | x));
+      m_pixelHalf = false;
+    }
+    else
+    {
+      m_pixelHigh = x;
+      m_pixelHalf = true;
+    }
+    return;
+  }
+
+  // Text mode
+  if (m_regs[RA8875_REG_MWCR0] & 0x80)
+  {
+    if (m_timeNs < m_memBusyUntil)
+      m_counters.textOverruns++;
+    writeChar(x);
+    return;
+  }
+
+  // Pattern RAM destination
+  if ((m_regs[RA8875_REG_MWCR1] & 0x0C) == 0x0C)
+  {
+    if ((m_depth == 8) || m_pixelHalf)
+    {
+      uint16_t color = (m_depth == 8) ? x : ((m_pixelHigh << 8) | x);
+      m_patterns[(patternBase() + m_patternIndex++) % RA8875_EMULATOR_PATTERN_RAM] = color;
+      m_pixelHalf = false;
+    }
+    else
+    {
+      m_pixelHigh = x;
+      m_pixelHalf = true;
+    }
+    return;
+  }
+
+  if (m_depth == 8)
+    writePixel(x);
+  else if (!m_pixelHalf)
+  {
+    m_pixelHigh = x;
+    m_pixelHalf = true;
+  }
+  else
+  {
+    writePixel((m_pixelHigh << 8) | x);
+    m_pixelHalf = false;
+  }
+}
+
+void RA8875Emulator::writePixel(uint16_t color)
+{
+  if (inActiveWindow(m_curX, m_curY))
+    plot(writeLayer(), m_curX, m_curY, color);
+
+  m_counters.pixelsWritten++;
+
+  advanceCursor();
+}
+
+// Moves the memory write cursor left to right, top to bottom, wrapping within the active window.
+void RA8875Emulator::advanceCursor(void)
+{
+  if (m_regs[RA8875_REG_MWCR0] & 0x02)
+    return;  // Auto-increment disabled
+
+  if (++m_curX > regX(RA8875_REG_HEAW0))
+  {
+    m_curX = regX(RA8875_REG_HSAW0);
+
+    if (++m_curY > regY(RA8875_REG_VEAW0))
+      m_curY = regY(RA8875_REG_VSAW0);
+  }
+}
+
+// Draws a character cell at the text cursor and advances it.
+void RA8875Emulator::writeChar(uint8_t c)
+{
+  uint8_t fncr1 = m_regs[RA8875_REG_FNCR1];
+  int xScale = ((fncr1 >> 2) & 0x03) + 1;
+  int yScale = (fncr1 & 0x03) + 1;
+
+  int cellW = RA8875_ROM_TEXT_WIDTH;
+  int cellH = RA8875_ROM_TEXT_HEIGHT;
+
+  // External ROM fonts are 16, 24 or 32 pixels high, half as wide
+  if (m_regs[RA8875_REG_FNCR0] & 0x20)
+  {
+    cellH = 16 + 8 * ((m_regs[RA8875_REG_FWTSR] >> 6) & 0x03);
+    cellW = cellH / 2;
+  }
+
+  cellW *= xScale;
+  cellH *= yScale;
+
+  // Wrap to the next line if the character won't fit
+  if (m_textX + cellW - 1 > regX(RA8875_REG_HEAW0))
+  {
+    m_textX = regX(RA8875_REG_HSAW0);
+    m_textY += cellH;
+  }
+
+  uint16_t fg = colorFromRegs(RA8875_REG_FGCR0);
+  uint16_t bg = colorFromRegs(RA8875_REG_BGCR0);
+  bool transparent = (fncr1 & 0x40);
+  int layer = writeLayer();
+
+  for (int y = 0; y < cellH; y++)
+  {
+    for (int x = 0; x < cellW; x++)
+    {
+      int px = m_textX + x, py = m_textY + y;
+      if (!inActiveWindow(px, py))
+        continue;
+
+      // Outline of the cell, inset by one pixel, for anything but a space
+      bool edge = (x == 1) || (x == cellW - 2) || (y == 1) || (y == cellH - 2);
+      bool inside = (x >= 1) && (x <= cellW - 2) && (y >= 1) && (y <= cellH - 2);
+
+      if ((c != ' ') && edge && inside)
+        plot(layer, px, py, fg);
+      else if (!transparent)
+        plot(layer, px, py, bg);
+    }
+  }
+
+  busyFor(&m_memBusyUntil, cellW * cellH, m_drawRate);
+
+  m_textX += cellW;
+}
+
+// --- Draw engine ---
+
+void RA8875Emulator::startDraw(uint8_t dcr)
+{
+  int layer = writeLayer();
+  uint16_t color = colorFromRegs(RA8875_REG_FGCR0);
+  bool fill = (dcr & 0x20);
+  uint32_t pixels;
+
+  int x1 = regX(RA8875_REG_DLHSR0), y1 = regY(RA8875_REG_DLVSR0);
+  int x2 = regX(RA8875_REG_DLHER0), y2 = regY(RA8875_REG_DLVER0);
+
+  if (dcr & 0x40)
+  {
+    pixels = drawCircle(layer, regX(RA8875_REG_DCHR0), regY(RA8875_REG_DCVR0), m_regs[RA8875_REG_DCRR], color, fill);
+    m_drawBusyBit = 0x40;
+  }
+  else
+  {
+    if (dcr & 0x01)
+      pixels = drawTriangle(layer, x1, y1, x2, y2, regX(RA8875_REG_DTPH0), regY(RA8875_REG_DTPV0), color, fill);
+    else if (dcr & 0x10)
+      pixels = drawRect(layer, x1, y1, x2, y2, color, fill);
+    else
+      pixels = drawLine(layer, x1, y1, x2, y2, color);
+
+    m_drawBusyBit = 0x80;
+  }
+
+  busyFor(&m_drawBusyUntil, pixels, m_drawRate);
+}
+
+uint32_t RA8875Emulator::drawLine(int layer, int x1, int y1, int x2, int y2, uint16_t color)
+{
+  int dx = abs(x2 - x1), sx = (x1 < x2) ? 1 : -1;
+  int dy = -abs(y2 - y1), sy = (y1 < y2) ? 1 : -1;
+  int err = dx + dy;
+  uint32_t count = 0;
+
+  for (;;)
+  {
+    if (inActiveWindow(x1, y1))
+      plot(layer, x1, y1, color);
+    count++;
+
+    if ((x1 == x2) && (y1 == y2))
+      break;
+
+    int e2 = 2 * err;
+    if (e2 >= dy)
+    {
+      err += dy;
+      x1 += sx;
+    }
+    if (e2 <= dx)
+    {
+      err += dx;
+      y1 += sy;
+    }
+  }
+
+  return count;
+}
+
+// ELLCR bit 5 selects a rounded rect, bit 4 a curve with bits 1-0 giving the quarter
+void RA8875Emulator::startEllipse(uint8_t ellcr)
+{
+  int layer = writeLayer();
+  uint16_t color = colorFromRegs(RA8875_REG_FGCR0);
+  bool fill = (ellcr & 0x40);
+  int a = regX(RA8875_REG_ELLA0), b = regX(RA8875_REG_ELLB0);
+  uint32_t pixels;
+
+  if (ellcr & 0x20)
+  {
+    pixels = drawRoundRect(layer, regX(RA8875_REG_DLHSR0), regY(RA8875_REG_DLVSR0), regX(RA8875_REG_DLHER0),
+                           regY(RA8875_REG_DLVER0), a, b, color, fill);
+  }
+  else
+  {
+    uint8_t parts = (ellcr & 0x10) ? (1 << (ellcr & 0x03)) : 0x0F;
+    pixels = drawEllipse(layer, regX(RA8875_REG_DEHR0), regY(RA8875_REG_DEVR0), a, b, color, fill, parts);
+  }
+
+  // Only ELLCR shows this one as busy
+  m_drawBusyBit = 0;
+  busyFor(&m_drawBusyUntil, pixels, m_drawRate);
+}
+
+uint32_t RA8875Emulator::drawHSpan(int layer, int x1, int x2, int y, uint16_t color)
+{
+  if (x1 > x2)
+  {
+    int t = x1;
+    x1 = x2;
+    x2 = t;
+  }
+
+  for (int x = x1; x <= x2; x++)
+  {
+    if (inActiveWindow(x, y))
+      plot(layer, x, y, color);
+  }
+
+  return x2 - x1 + 1;
+}
+
+uint32_t RA8875Emulator::drawRect(int layer, int x1, int y1, int x2, int y2, uint16_t color, bool fill)
+{
+  int top = (y1 < y2) ? y1 : y2, bottom = (y1 < y2) ? y2 : y1;
+  uint32_t count = 0;
+
+  if (fill)
+  {
+    for (int y = top; y <= bottom; y++)
+      count += drawHSpan(layer, x1, x2, y, color);
+  }
+  else
+  {
+    count += drawLine(layer, x1, y1, x2, y1, color);
+    count += drawLine(layer, x1, y2, x2, y2, color);
+    count += drawLine(layer, x1, y1, x1, y2, color);
+    count += drawLine(layer, x2, y1, x2, y2, color);
+  }
+
+  return count;
+}
+
+uint32_t RA8875Emulator::drawTriangle(int layer, int x1, int y1, int x2, int y2, int x3, int y3, uint16_t color, bool fill)
+{
+  uint32_t count = 0;
+
+  if (!fill)
+  {
+    count += drawLine(layer, x1, y1, x2, y2, color);
+    count += drawLine(layer, x2, y2, x3, y3, color);
+    count += drawLine(layer, x3, y3, x1, y1, color);
+    return count;
+  }
+
+  // Sort by y
+  int t;
+  if (y1 > y2) { t = y1; y1 = y2; y2 = t; t = x1; x1 = x2; x2 = t; }
+  if (y2 > y3) { t = y2; y2 = y3; y3 = t; t = x2; x2 = x3; x3 = t; }
+  if (y1 > y2) { t = y1; y1 = y2; y2 = t; t = x1; x1 = x2; x2 = t; }
+
+  for (int y = y1; y <= y3; y++)
+  {
+    // Long edge 1-3, and short edge 1-2 or 2-3
+    int xa = (y3 == y1) ? x1 : x1 + (x3 - x1) * (y - y1) / (y3 - y1);
+    int xb;
+
+    if (y < y2)
+      xb = x1 + (x2 - x1) * (y - y1) / (y2 - y1);
+    else if (y3 == y2)
+      xb = x2;
+    else
+      xb = x2 + (x3 - x2) * (y - y2) / (y3 - y2);
+
+    count += drawHSpan(layer, xa, xb, y, color);
+  }
+
+  return count;
+}
+
+// Half-width of an ellipse's row dy away from the centre. The outermost row is measured half a
+//  pixel in, so a flat top or bottom gets the run of pixels the curve passes through.
+static int ellipseX(int a, int b, int dy)
+{
+  if (b == 0)
+    return a;
+
+  double y = (dy == b) ? b - 0.5 : dy;
+  double t = 1.0 - y * y / ((double) b * b);
+  return (int) (a * sqrt((t > 0) ? t : 0) + 0.5);
+}
+
+// parts has a bit for each quarter, numbered as ELLCR numbers curves: lower left, upper left,
+//  upper right, lower right
+uint32_t RA8875Emulator::drawEllipse(int layer, int cx, int cy, int a, int b, uint16_t color, bool fill, uint8_t parts)
+{
+  static const int8_t signs[4][2] = { { -1, 1 }, { -1, -1 }, { 1, -1 }, { 1, 1 } };
+  uint32_t count = 0;
+
+  for (int dy = 0; dy <= b; dy++)
+  {
+    // An outline row runs from where the next row out ends, so steep parts stay connected
+    int x = ellipseX(a, b, dy);
+    int inner = (fill || (dy == b)) ? 0 : min(x, ellipseX(a, b, dy + 1) + 1);
+
+    for (int q = 0; q < 4; q++)
+    {
+      if (parts & (1 << q))
+        count += drawHSpan(layer, cx + signs[q][0] * inner, cx + signs[q][0] * x, cy + signs[q][1] * dy, color);
+    }
+  }
+
+  return count;
+}
+
+uint32_t RA8875Emulator::drawRoundRect(int layer, int x1, int y1, int x2, int y2, int a, int b, uint16_t color, bool fill)
+{
+  int left = min(x1, x2), right = max(x1, x2), top = min(y1, y2), bottom = max(y1, y2);
+  uint32_t count = 0;
+
+  count += drawEllipse(layer, left + a, bottom - b, a, b, color, fill, 0x01);
+  count += drawEllipse(layer, left + a, top + b, a, b, color, fill, 0x02);
+  count += drawEllipse(layer, right - a, top + b, a, b, color, fill, 0x04);
+  count += drawEllipse(layer, right - a, bottom - b, a, b, color, fill, 0x08);
+
+  if (fill)
+  {
+    count += drawRect(layer, left, top + b, right, bottom - b, color, true);
+    count += drawRect(layer, left + a, top, right - a, bottom, color, true);
+  }
+  else
+  {
+    count += drawLine(layer, left + a, top, right - a, top, color);
+    count += drawLine(layer, left + a, bottom, right - a, bottom, color);
+    count += drawLine(layer, left, top + b, left, bottom - b, color);
+    count += drawLine(layer, right, top + b, right, bottom - b, color);
+  }
+
+  return count;
+}
+
+uint32_t RA8875Emulator::drawCircle(int layer, int cx, int cy, int r, uint16_t color, bool fill)
+{
+  int x = r, y = 0, err = 1 - r;
+  uint32_t count = 0;
+
+  while (x >= y)
+  {
+    if (fill)
+    {
+      count += drawHSpan(layer, cx - x, cx + x, cy + y, color);
+      count += drawHSpan(layer, cx - x, cx + x, cy - y, color);
+      count += drawHSpan(layer, cx - y, cx + y, cy + x, color);
+      count += drawHSpan(layer, cx - y, cx + y, cy - x, color);
+    }
+    else
+    {
+      const int pts[8][2] = { { x, y }, { y, x }, { -y, x }, { -x, y }, { -x, -y }, { -y, -x }, { y, -x }, { x, -y } };
+      for (int i = 0; i < 8; i++)
+      {
+        if (inActiveWindow(cx + pts[i][0], cy + pts[i][1]))
+          plot(layer, cx + pts[i][0], cy + pts[i][1], color);
+      }
+      count += 8;
+    }
+
+    y++;
+    if (err < 0)
+      err += 2 * y + 1;
+    else
+    {
+      x--;
+      err += 2 * (y - x) + 1;
+    }
+  }
+
+  return count;
+}
+
+// --- BTE ---
+
+void RA8875Emulator::startBTE(void)
+{
+  uint8_t becr1 = m_regs[RA8875_REG_BECR1];
+  uint8_t op = becr1 & 0x0F;
+  uint8_t ropCode = becr1 >> 4;
+
+  int srcX = regX(RA8875_REG_HSBE0), srcY = regY(RA8875_REG_VSBE0);
+  int dstX = regX(RA8875_REG_HDBE0), dstY = regY(RA8875_REG_VDBE0);
+  int srcLayer = (m_regs[RA8875_REG_VSBE1] & 0x80) ? 1 : 0;
+  int dstLayer = (m_regs[RA8875_REG_VDBE1] & 0x80) ? 1 : 0;
+  int width  = reg16(RA8875_REG_BEWR0) & 0x3FF;
+  int height = reg16(RA8875_REG_BEHR0) & 0x3FF;
+
+  uint16_t key = colorFromRegs(RA8875_REG_FGCR0);
+
+  switch (op)
+  {
+    case 0x00:  // Write with ROP
+    case 0x04:  // Transparent write
+    case 0x08:  // Colour expansion
+    case 0x09:  // Colour expansion with transparency
+      // Pixels arrive through MRWC. The engine stays busy until the last one.
+      m_bteWriteCount = width * height;
+      m_bteWriteIndex = 0;
+      m_bteBusyUntil  = UINT64_MAX;
+      return;
+
+    case 0x06:  // Pattern fill with ROP
+    case 0x07:  // Pattern fill with transparency
+    {
+      int size = (m_regs[RA8875_REG_PTNO] & 0x80) ? 16 : 8;
+      uint16_t patternKey = colorFromRegs(RA8875_REG_BGTR0);
+
+      for (int y = 0; y < height; y++)
+      {
+        for (int x = 0; x < width; x++)
+        {
+          uint16_t s = m_patterns[(patternBase() + (y % size) * size + (x % size)) % RA8875_EMULATOR_PATTERN_RAM];
+
+          if (op == 0x07)
+          {
+            if (s != patternKey)
+              plot(dstLayer, dstX + x, dstY + y, s);
+          }
+          else
+            plot(dstLayer, dstX + x, dstY + y, rop(ropCode, s, peek(dstLayer, dstX + x, dstY + y)));
+        }
+      }
+      break;
+    }
+
+    case 0x02:  // Move in positive direction with ROP
+    case 0x05:  // Transparent move in positive direction
+      for (int y = 0; y < height; y++)
+      {
+        for (int x = 0; x < width; x++)
+        {
+          uint16_t s = peek(srcLayer, srcX + x, srcY + y);
+
+          if (op == 0x05)
+          {
+            if (s != key)
+              plot(dstLayer, dstX + x, dstY + y, s);
+          }
+          else
+            plot(dstLayer, dstX + x, dstY + y, rop(ropCode, s, peek(dstLayer, dstX + x, dstY + y)));
+        }
+      }
+      break;
+
+    case 0x03:  // Move in negative direction with ROP. Points are the bottom right corners.
+      for (int y = 0; y < height; y++)
+      {
+        for (int x = 0; x < width; x++)
+        {
+          uint16_t s = peek(srcLayer, srcX - x, srcY - y);
+          plot(dstLayer, dstX - x, dstY - y, rop(ropCode, s, peek(dstLayer, dstX - x, dstY - y)));
+        }
+      }
+      break;
+
+    default:
+      break;  // Not modelled
+  }
+
+  busyFor(&m_bteBusyUntil, width * height, m_bteRate);
+}
+
+// Start of the selected pattern in pattern RAM
+int RA8875Emulator::patternBase(void)
+{
+  uint8_t ptno = m_regs[RA8875_REG_PTNO];
+  return (ptno & 0x80) ? (ptno & 0x03) * 256 : (ptno & 0x0F) * 64;
+}
+
+// Places one pixel of a write BTE operation.
+void RA8875Emulator::bteWritePixel(uint16_t s)
+{
+  uint8_t becr1 = m_regs[RA8875_REG_BECR1];
+  int dstX = regX(RA8875_REG_HDBE0), dstY = regY(RA8875_REG_VDBE0);
+  int dstLayer = (m_regs[RA8875_REG_VDBE1] & 0x80) ? 1 : 0;
+  int width = reg16(RA8875_REG_BEWR0) & 0x3FF;
+
+  int x = dstX + m_bteWriteIndex % width;
+  int y = dstY + m_bteWriteIndex / width;
+
+  if ((becr1 & 0x0F) == 0x04)
+  {
+    if (s != colorFromRegs(RA8875_REG_FGCR0))
+      plot(dstLayer, x, y, s);
+  }
+  else if ((becr1 & 0x0F) == 0x08)
+    plot(dstLayer, x, y, colorFromRegs(s ? RA8875_REG_FGCR0 : RA8875_REG_BGCR0));
+  else if ((becr1 & 0x0F) == 0x09)
+  {
+    if (s)
+      plot(dstLayer, x, y, colorFromRegs(RA8875_REG_FGCR0));
+  }
+  else
+    plot(dstLayer, x, y, rop(becr1 >> 4, s, peek(dstLayer, x, y)));
+
+  m_counters.pixelsWritten++;
+
+  if (++m_bteWriteIndex == m_bteWriteCount)
+  {
+    // Done as soon as the last pixel is in
+    m_bteWriteCount = 0;
+    m_bteBusyUntil  = 0;
+    busyFor(&m_bteBusyUntil, 1, m_bteRate);
+    m_counters.pixelsDrawn += m_bteWriteIndex - 1;
+  }
+}
+
+// Expands one byte of a colour expansion BTE into pixels, starting from the bit given in the ROP
+//  field. Each row starts on a new byte, so bits left over at the end of a row are dropped.
+void RA8875Emulator::bteExpandByte(uint8_t x)
+{
+  int width = reg16(RA8875_REG_BEWR0) & 0x3FF;
+
+  for (int bit = (m_regs[RA8875_REG_BECR1] >> 4) & 0x07; (bit >= 0) && (m_bteWriteCount > 0); bit--)
+  {
+    bteWritePixel((x >> bit) & 0x01);
+    if (m_bteWriteIndex % width == 0)
+      break;
+  }
+}
+
+// Applies one of the 16 raster operations to a source and destination pixel.
+uint16_t RA8875Emulator::rop(uint8_t op, uint16_t s, uint16_t d)
+{
+  uint16_t mask = (m_depth == 16) ? 0xFFFF : 0x00FF;
+  uint16_t r;
+
+  switch (op & 0x0F)
+  {
+    case 0x0: r = 0; break;
+    case 0x1: r = ~(s | d); break;
+    case 0x2: r = ~s & d; break;
+    case 0x3: r = ~s; break;
+    case 0x4: r = s & ~d; break;
+    case 0x5: r = ~d; break;
+    case 0x6: r = s ^ d; break;
+    case 0x7: r = ~(s & d); break;
+    case 0x8: r = s & d; break;
+    case 0x9: r = ~(s ^ d); break;
+    case 0xA: r = d; break;
+    case 0xB: r = ~s | d; break;
+    case 0xC: r = s; break;
+    case 0xD: r = s | ~d; break;
+    case 0xE: r = s | d; break;
+    default:  r = 0xFFFF; break;
+  }
+
+  return r & mask;
+}
+
+// --- Memory clear ---
+
+// Clears the current layer, or just the active window if bit 6 is set, to the background colour.
+void RA8875Emulator::startClear(uint8_t mclr)
+{
+  uint16_t bg = colorFromRegs(RA8875_REG_BGCR0);
+  int layer = writeLayer();
+  bool window = (mclr & 0x40);
+  uint32_t count = 0;
+
+  for (int y = 0; y < m_height; y++)
+  {
+    for (int x = 0; x < m_width; x++)
+    {
+      if (window && !inActiveWindow(x, y))
+        continue;
+
+      plot(layer, x, y, bg);
+      count++;
+    }
+  }
+
+  busyFor(&m_clearBusyUntil, count, m_drawRate);
+}
+
+// --- Output ---
+
+void RA8875Emulator::toRGB(uint16_t pixel, uint8_t *rgb)
+{
+  if (m_depth == 16)
+  {
+    rgb[0] = ((pixel >> 11) & 0x1F) * 255 / 31;
+    rgb[1] = ((pixel >> 5) & 0x3F) * 255 / 63;
+    rgb[2] = (pixel & 0x1F) * 255 / 31;
+  }
+  else
+  {
+    rgb[0] = ((pixel >> 5) & 0x07) * 255 / 7;
+    rgb[1] = ((pixel >> 2) & 0x07) * 255 / 7;
+    rgb[2] = (pixel & 0x03) * 255 / 3;
+  }
+}
+
+// Works out which pixel is shown at a screen position, applying the scroll window and layer mode.
+uint16_t RA8875Emulator::displayPixel(int x, int y)
+{
+  int sx1 = regX(RA8875_REG_HSSW0), sx2 = regX(RA8875_REG_HESW0);
+  int sy1 = regY(RA8875_REG_VSSW0), sy2 = regY(RA8875_REG_VESW0);
+
+  if ((sx2 > sx1) && (sy2 > sy1) && (x >= sx1) && (x <= sx2) && (y >= sy1) && (y <= sy2))
+  {
+    int w = sx2 - sx1 + 1, h = sy2 - sy1 + 1;
+    x = sx1 + (x - sx1 + regX(RA8875_REG_HOFS0)) % w;
+    y = sy1 + (y - sy1 + regY(RA8875_REG_VOFS0)) % h;
+  }
+
+  uint16_t p1 = peek(0, x, y);
+  uint16_t p2 = peek(1, x, y);
+
+  switch (m_regs[RA8875_REG_LTPR0] & 0x07)
+  {
+    case RA8875_LAYER_2:
+      return p2;
+    case RA8875_LAYER_LIGHTEN:
+      return (p1 > p2) ? p1 : p2;
+    case RA8875_LAYER_TRANSPARENT:
+      return (p1 == colorFromRegs(RA8875_REG_BGTR0)) ? p2 : p1;
+    case RA8875_LAYER_OR:
+      return p1 | p2;
+    case RA8875_LAYER_AND:
+      return p1 & p2;
+    default:
+      return p1;
+  }
+}
+
+// Writes a binary PPM. Layer -1 is the composed display.
+bool RA8875Emulator::writePPM(const char *path, int layer)
+{
+  FILE *f = fopen(path, "wb");
+  if (!f)
+    return false;
+
+  fprintf(f, "P6\n%d %d\n255\n", m_width, m_height);
+
+  for (int y = 0; y < m_height; y++)
+  {
+    for (int x = 0; x < m_width; x++)
+    {
+      uint8_t rgb[3];
+      toRGB((layer < 0) ? displayPixel(x, y) : peek(layer, x, y), rgb);
+      fwrite(rgb, 1, 3, f);
+    }
+  }
+
+  return fclose(f) == 0;
+}
+
+bool RA8875Emulator::writeLayerPPM(int layer, const char *path)
+{
+  return writePPM(path, layer - 1);
+}
+
+bool RA8875Emulator::writeDisplayPPM(const char *path)
+{
+  return writePPM(path, -1);
+}
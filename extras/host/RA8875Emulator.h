@@ -0,0 +1,198 @@
+// Register-level emulator of the RA8875, for running the library on a host machine.
+//
+// It sits on the other end of RA8875_RecordingBus and decodes the same SPI cycles the chip sees:
+//  command writes, data writes, data reads and status reads. It models the register file, the
+//  memory write cursor and active window, both layers, the draw engine (lines, rects, triangles,
+//  circles, ellipses, curves, rounded rects), BTE moves, writes, colour expansion, pattern fills and their transparent variants,
+//  the pattern RAM, text mode cursor advance and MCLR.
+//
+// Time is modelled from SPI traffic: each byte takes 8 SPI clocks, and drawing operations keep
+//  the busy flags set for a time derived from the number of pixels they touch. That makes the
+//  number of polls a driver does, and the time it would spend waiting, comparable across runs.
+//
+// Text is drawn as outlined character cells, since the font ROM isn't available.
+
+#ifndef RA8875_EMULATOR_H
+#define RA8875_EMULATOR_H
+
+#include "NiftyRA8875.h"
+
+// Pattern RAM holds sixteen 8x8 or four 16x16 patterns
+#define RA8875_EMULATOR_PATTERN_RAM 1024
+
+class RA8875Emulator : public RA8875_BusDevice
+{
+public:
+  struct Counters
+  {
+    uint32_t bytes;            // SPI bytes, including cycle type bytes
+    uint32_t selects;          // CS assertions
+    uint32_t cmdWrites;        // Command write cycles
+    uint32_t dataWrites;       // Data write cycles
+    uint32_t dataReads;        // Data read cycles
+    uint32_t statusReads;      // Status read cycles
+    uint32_t busyPolls;        // Reads of a status or control register that returned busy
+    uint32_t pixelsWritten;    // Pixels written through MRWC
+    uint32_t pixelsDrawn;      // Pixels touched by the draw engine, BTE, text and MCLR
+    uint64_t busyNs;           // Time the chip spent busy with drawing operations
+    uint32_t clockViolations;  // Cycles clocked faster than SYS_CLK allows
+    uint32_t textOverruns;     // Characters written while the previous one was still being drawn
+    uint32_t engineOverruns;   // Data writes that could upset a drawing operation still running
+  };
+
+  RA8875Emulator();
+  virtual ~RA8875Emulator();
+
+  // RA8875_BusDevice
+  virtual void select(void);
+  virtual void deselect(void);
+  virtual uint8_t transfer(uint8_t x);
+  virtual void setClock(uint32_t hz) { m_spiClock = hz; };
+
+  // Timing model. The SPI clock follows the driver's transactions, but can be set here for
+  //  drivers that don't pass it on.
+  void setSPIClock(uint32_t hz) { m_spiClock = hz; };
+  uint32_t getSysClock(void);
+  void setDrawRate(uint32_t pixelsPerSecond) { m_drawRate = pixelsPerSecond; };
+  void setBTERate(uint32_t pixelsPerSecond) { m_bteRate = pixelsPerSecond; };
+  uint64_t getTimeNs(void) { return m_timeNs; };
+
+  // Counters
+  const Counters &getCounters(void) { return m_counters; };
+  void resetCounters(void);
+
+  // INT pin
+  void setIntPin(int pin) { m_intPin = pin; };
+  bool isInterruptAsserted(void);
+
+  // Host hooks. Pass hostMicros to hostSetClockHook(), hostDelay to hostSetDelayHook() and
+  //  hostDigitalRead to hostSetDigitalReadHook(), with the emulator as context.
+  static unsigned long long hostMicros(void *context) { return ((RA8875Emulator *) context)->m_timeNs / 1000; };
+  static void hostDelay(void *context, unsigned long long us) { ((RA8875Emulator *) context)->m_timeNs += us * 1000; };
+  static int hostDigitalRead(void *context, int pin);
+
+  // Register file
+  uint8_t getReg(uint8_t reg) { return m_regs[reg]; };
+
+  // Memory
+  int getWidth(void) { return m_width; };
+  int getHeight(void) { return m_height; };
+  int getDepth(void) { return m_depth; };
+  int getLayerCount(void);
+  uint16_t getPixel(int layer, int x, int y);
+
+  // Output. The display image applies the layer mode (LTPR0) and scroll offsets.
+  bool writeLayerPPM(int layer, const char *path);
+  bool writeDisplayPPM(const char *path);
+
+private:
+  enum Cycle
+  {
+    CYCLE_NONE,
+    CYCLE_CMD_WRITE,
+    CYCLE_DATA_WRITE,
+    CYCLE_DATA_READ,
+    CYCLE_STATUS_READ
+  };
+
+  uint8_t m_regs[256];
+
+  // Bus state
+  bool m_selected;
+  enum Cycle m_cycle;
+  bool m_typePending;
+  uint8_t m_reg;
+
+  // Memory write state
+  bool m_pixelHalf;
+  uint8_t m_pixelHigh;
+  int m_curX;
+  int m_curY;
+  int m_textX;
+  int m_textY;
+
+  // BTE operation taking its source from the MCU
+  int m_bteWriteCount;
+  int m_bteWriteIndex;
+
+  // Pattern RAM
+  uint16_t m_patterns[RA8875_EMULATOR_PATTERN_RAM];
+  int m_patternIndex;
+
+  // Memory, allocated when the display size is configured
+  int m_width;
+  int m_height;
+  int m_depth;
+  uint16_t *m_layers[2];
+
+  // Timing
+  uint32_t m_spiClock;
+  uint32_t m_drawRate;
+  uint32_t m_bteRate;
+  uint64_t m_timeNs;
+  uint64_t m_drawBusyUntil;
+  uint64_t m_bteBusyUntil;
+  uint64_t m_memBusyUntil;
+  uint64_t m_clearBusyUntil;
+  uint8_t m_drawBusyBit;
+
+  int m_intPin;
+  uint8_t m_intStatus;
+
+  Counters m_counters;
+
+  // Register helpers
+  int reg16(uint8_t lowReg) { return m_regs[lowReg] | (m_regs[lowReg + 1] << 8); };
+  int regX(uint8_t lowReg) { return reg16(lowReg) & 0x3FF; };
+  int regY(uint8_t lowReg) { return reg16(lowReg) & 0x1FF; };
+
+  void writeRegister(uint8_t reg, uint8_t x);
+  uint8_t readRegister(uint8_t reg);
+  uint8_t readStatus(void);
+  void checkBusy(bool busy) { if (busy) m_counters.busyPolls++; };
+  bool upsetsEngine(void);
+
+  void configure(void);
+  uint16_t colorFromRegs(uint8_t reg);
+  int writeLayer(void) { return m_regs[RA8875_REG_MWCR1] & 0x01; };
+
+  // Memory access
+  bool inActiveWindow(int x, int y);
+  void plot(int layer, int x, int y, uint16_t color);
+  uint16_t peek(int layer, int x, int y);
+  void busyFor(uint64_t *until, uint32_t pixels, uint32_t rate);
+
+  // Memory write port
+  void memoryWrite(uint8_t x);
+  void writePixel(uint16_t color);
+  void advanceCursor(void);
+  void writeChar(uint8_t c);
+
+  // Draw engine
+  void startDraw(uint8_t dcr);
+  uint32_t drawLine(int layer, int x1, int y1, int x2, int y2, uint16_t color);
+  uint32_t drawHSpan(int layer, int x1, int x2, int y, uint16_t color);
+  uint32_t drawRect(int layer, int x1, int y1, int x2, int y2, uint16_t color, bool fill);
+  uint32_t drawTriangle(int layer, int x1, int y1, int x2, int y2, int x3, int y3, uint16_t color, bool fill);
+  uint32_t drawCircle(int layer, int cx, int cy, int r, uint16_t color, bool fill);
+  void startEllipse(uint8_t ellcr);
+  uint32_t drawEllipse(int layer, int cx, int cy, int a, int b, uint16_t color, bool fill, uint8_t parts);
+  uint32_t drawRoundRect(int layer, int x1, int y1, int x2, int y2, int a, int b, uint16_t color, bool fill);
+
+  // BTE
+  void startBTE(void);
+  void bteWritePixel(uint16_t s);
+  void bteExpandByte(uint8_t x);
+  int patternBase(void);
+  uint16_t rop(uint8_t op, uint16_t s, uint16_t d);
+
+  // Memory clear
+  void startClear(uint8_t mclr);
+
+  // Output
+  void toRGB(uint16_t pixel, uint8_t *rgb);
+  uint16_t displayPixel(int x, int y);
+  bool writePPM(const char *path, int layer);
+};
+
+#endif
@@ -0,0 +1,40 @@
+// Minimal stand-in for the Arduino SPI library, for building on a host machine.
+// Transfers go nowhere and read back as zero (i.e. never busy). Use RA8875_RecordingBus to
+//  connect the driver to something.
+
+#ifndef RA8875_HOST_SPI_H
+#define RA8875_HOST_SPI_H
+
+#include "Arduino.h"
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings
+{
+public:
+  uint32_t clock;
+  uint8_t bitOrder;
+  uint8_t dataMode;
+
+  SPISettings() : clock(4000000), bitOrder(MSBFIRST), dataMode(SPI_MODE0) {};
+  SPISettings(uint32_t c, uint8_t b, uint8_t m) : clock(c), bitOrder(b), dataMode(m) {};
+};
+
+class SPIClass
+{
+public:
+  void begin(void) {};
+  void end(void) {};
+  void beginTransaction(SPISettings settings) { (void) settings; };
+  void endTransaction(void) {};
+  uint8_t transfer(uint8_t x) { (void) x; return 0x00; };
+  uint16_t transfer16(uint16_t x) { (void) x; return 0x0000; };
+  void transfer(void *buf, size_t count) { memset(buf, 0x00, count); };
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,167 @@
+// Measures the dirty-rectangle compositor on typical dashboard updates, against the emulator.
+//
+// Each scenario draws a static screen into layer 2, presents it once, then runs a number of frames
+//  that each change a few things and call present(). Per frame, it reports the copies made, the
+//  pixels they covered and the modelled time present() took, next to a full-screen copy. At the
+//  end, layer 1 must match layer 2 exactly, or damage was missed.
+//
+//   compositor_bench [frames] [setup cost]
+//
+// Output is CSV:
+//
+//   scenario,frames,copies_per_frame,pixels_per_frame,present_us,full_pixels,full_us,mismatches
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "NiftyRA8875.h"
+#include "RA8875Emulator.h"
+
+static const int width  = 480;
+static const int height = 272;
+
+static const uint16_t background = RGB565(0, 0, 64);
+static const uint16_t panel      = RGB565(32, 32, 96);
+
+// Four numeric readouts, each digit a 12x20 block whose shade stands in for its value
+static void labels(RA8875 &tft, int frame)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    int x = 20 + i * 110, y = 20;
+    int value = (frame * (i + 3) * 7) % 1000;
+
+    for (int d = 0; d < 3; d++, value /= 10)
+      tft.fillRect(x + (2 - d) * 14, y, x + (2 - d) * 14 + 11, y + 19, RGB565(value % 10 * 25, 255, 0));
+  }
+}
+
+// A gauge needle, erased and redrawn
+static void needle(RA8875 &tft, int frame)
+{
+  static const int cx = 120, cy = 200, r = 60;
+
+  if (frame > 0)
+  {
+    float a = (frame - 1) * 0.05f;
+    tft.drawLine(cx, cy, cx + (int) (r * cosf(a)), cy - (int) (r * sinf(a)), panel);
+  }
+
+  float a = frame * 0.05f;
+  tft.drawLine(cx, cy, cx + (int) (r * cosf(a)), cy - (int) (r * sinf(a)), RGB565(255, 0, 0));
+}
+
+// Eight bars, each cleared and refilled to a new height
+static void bars(RA8875 &tft, int frame)
+{
+  for (int i = 0; i < 8; i++)
+  {
+    int x = 260 + i * 24, top = 140, bottom = 250;
+    int h = 10 + (frame * (i + 1) * 13) % 100;
+
+    tft.fillRect(x, top, x + 15, bottom - h - 1, panel);
+    tft.fillRect(x, bottom - h, x + 15, bottom, RGB565(0, 200, 255));
+  }
+}
+
+// A strip chart that scrolls left by two pixels and draws a new segment
+static void chart(RA8875 &tft, int frame)
+{
+  static const int x1 = 20, x2 = 459, y1 = 60, y2 = 119;
+
+  tft.copy(2, x1 + 2, y1, x2 - x1 - 1, y2 - y1 + 1, 2, x1, y1);
+  tft.fillRect(x2 - 1, y1, x2, y2, panel);
+
+  int ya = y1 + 30 + (int) (25 * sinf((frame - 1) * 0.2f));
+  int yb = y1 + 30 + (int) (25 * sinf(frame * 0.2f));
+  tft.drawLine(x2 - 2, ya, x2, yb, RGB565(255, 255, 0));
+}
+
+static void mixed(RA8875 &tft, int frame)
+{
+  labels(tft, frame);
+  needle(tft, frame);
+  bars(tft, frame);
+  if (frame % 4 == 0)
+    chart(tft, frame);
+}
+
+static void run(const char *name, void (*update)(RA8875 &, int), int frames, uint32_t setupCost)
+{
+  RA8875 tft(10);
+  RA8875Emulator emu;
+  tft.getBus().setDevice(&emu);
+  hostSetDigitalReadHook(RA8875Emulator::hostDigitalRead, &emu);
+  hostSetClockHook(RA8875Emulator::hostMicros, &emu);
+  hostSetDelayHook(RA8875Emulator::hostDelay, &emu);
+
+  tft.init(width, height, 16);
+
+  RA8875_Compositor compositor;
+  tft.setCompositor(&compositor, setupCost);
+
+  // Static screen
+  tft.setDrawLayer(2);
+  tft.fillRect(0, 0, width - 1, height - 1, background);
+  tft.fillRect(10, 10, width - 11, 50, panel);
+  tft.fillRect(10, 55, width - 11, 124, panel);
+  tft.fillRect(10, 130, width - 11, height - 11, panel);
+  update(tft, 0);
+  tft.present();
+
+  uint32_t copies = 0, pixels = 0;
+  uint64_t presentNs = 0;
+
+  for (int frame = 1; frame <= frames; frame++)
+  {
+    update(tft, frame);
+
+    uint64_t start = emu.getTimeNs();
+    tft.present();
+    tft.sync();
+    presentNs += emu.getTimeNs() - start;
+
+    copies += compositor.copies;
+    pixels += compositor.copiedPixels;
+  }
+
+  // Anything drawn but not presented shows up as a difference between the layers
+  int mismatches = 0;
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      if (emu.getPixel(1, x, y) != emu.getPixel(2, x, y))
+        mismatches++;
+    }
+  }
+
+  // A full-screen copy, for comparison
+  uint64_t start = emu.getTimeNs();
+  tft.copy(2, 0, 0, width, height, 1, 0, 0);
+  tft.sync();
+  uint64_t fullNs = emu.getTimeNs() - start;
+
+  printf("%s,%d,%.2f,%.0f,%.1f,%d,%.1f,%d\n", name, frames, (double) copies / frames, (double) pixels / frames,
+         presentNs / 1000.0 / frames, width * height, fullNs / 1000.0, mismatches);
+
+  hostSetDelayHook(NULL, NULL);
+  hostSetClockHook(NULL, NULL);
+  hostSetDigitalReadHook(NULL, NULL);
+  tft.getBus().setDevice(NULL);
+}
+
+int main(int argc, char **argv)
+{
+  int frames = (argc > 1) ? atoi(argv[1]) : 100;
+  uint32_t setupCost = (argc > 2) ? atoi(argv[2]) : RA8875_COMPOSITOR_SETUP_COST;
+
+  printf("scenario,frames,copies_per_frame,pixels_per_frame,present_us,full_pixels,full_us,mismatches\n");
+  run("labels", labels, frames, setupCost);
+  run("needle", needle, frames, setupCost);
+  run("bars", bars, frames, setupCost);
+  run("chart", chart, frames, setupCost);
+  run("mixed", mixed, frames, setupCost);
+
+  return 0;
+}
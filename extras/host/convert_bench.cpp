@@ -0,0 +1,166 @@
+// Measures the RGB888 conversion kernels on the host, in pixels per second.
+//
+// The kernel is picked at compile time, so build once per kernel and compare:
+//
+//   convert_bench [pixels per row] [rows]
+//
+// Times are real host CPU time, not the virtual clock used for sketches. Before timing, the
+//  output of each function is compared byte for byte with the portable kernel's, written out
+//  again below, with and without dithering, for row lengths and positions that leave every
+//  possible tail. It exits non-zero if any differ.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "NiftyRA8875Convert.h"
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef void (*PlainFn)(uint8_t *, const uint8_t *, size_t);
+typedef void (*DitherFn)(uint8_t *, const uint8_t *, size_t, int, int);
+
+static const int maxCheckLength = 67;
+
+static int failures = 0;
+
+static const uint8_t bayer[4][4] =
+{
+  {  0,  8,  2, 10 },
+  { 12,  4, 14,  6 },
+  {  3, 11,  1,  9 },
+  { 15,  7, 13,  5 }
+};
+
+// Adds the dither amount for pattern value m to a channel that loses drop bits, saturating
+static uint8_t dithered(uint8_t v, int m, int drop)
+{
+  int s = v + ((m << drop) >> 4);
+  return (s > 255) ? 255 : s;
+}
+
+// The portable kernel, one pixel at a time, to check whichever kernel was built against
+static void reference(uint8_t *dst, const uint8_t *src, size_t count, bool rgb565, bool dither, int x, int y)
+{
+  for (size_t i = 0; i < count; i++, src += 3)
+  {
+    uint8_t r = src[0], g = src[1], b = src[2];
+    int m = bayer[y & 3][(x + i) & 3];
+
+    if (rgb565)
+    {
+      if (dither)
+      {
+        r = dithered(r, m, 3);
+        g = dithered(g, m, 2);
+        b = dithered(b, m, 3);
+      }
+      dst[i * 2]     = (r & 0xF8) | (g >> 5);
+      dst[i * 2 + 1] = ((g << 3) & 0xE0) | (b >> 3);
+    }
+    else
+    {
+      if (dither)
+      {
+        r = dithered(r, m, 5);
+        g = dithered(g, m, 5);
+        b = dithered(b, m, 6);
+      }
+      dst[i] = (r & 0xE0) | ((g & 0xE0) >> 3) | (b >> 6);
+    }
+  }
+}
+
+// Compares a function with the reference for every length up to maxCheckLength, from a different
+//  place in src each time, at each dither pattern position
+static void check(const char *name, PlainFn plain, DitherFn dither, bool rgb565, const uint8_t *src)
+{
+  uint8_t got[maxCheckLength * 2], want[maxCheckLength * 2];
+  int positions = dither ? 4 : 1;
+
+  for (int count = 1; count <= maxCheckLength; count++)
+  {
+    for (int x = 0; x < positions; x++)
+    {
+      for (int y = 0; y < positions; y++)
+      {
+        const uint8_t *row = src + (count * 4 + x) * 3;
+        size_t bytes = count * (rgb565 ? 2 : 1);
+
+        if (plain)
+          plain(got, row, count);
+        else
+          dither(got, row, count, x, y);
+        reference(want, row, count, rgb565, dither != NULL, x, y);
+
+        if (memcmp(got, want, bytes) != 0)
+        {
+          fprintf(stderr, "FAIL: %s differs from the portable kernel for %d pixels at %d,%d\n", name, count, x, y);
+          failures++;
+          return;
+        }
+      }
+    }
+  }
+}
+
+static void bench(const char *name, PlainFn plain, DitherFn dither, const uint8_t *src, uint8_t *dst, int width, int rows)
+{
+  // Repeat until enough time has passed to measure
+  long passes = 0;
+  double start = now(), elapsed;
+  do
+  {
+    for (int y = 0; y < rows; y++)
+    {
+      if (plain)
+        plain(dst, src + (size_t) y * width * 3, width);
+      else
+        dither(dst, src + (size_t) y * width * 3, width, 0, y);
+    }
+    passes++;
+    elapsed = now() - start;
+  } while (elapsed < 0.5);
+
+  printf("%s,%d,%.0f\n", name, RA8875_CONVERT_KERNEL, (double) passes * width * rows / elapsed);
+}
+
+int main(int argc, char **argv)
+{
+  int width = (argc > 1) ? atoi(argv[1]) : 800;
+  int rows  = (argc > 2) ? atoi(argv[2]) : 480;
+
+  uint8_t *src = new uint8_t[(size_t) width * rows * 3];
+  uint8_t *dst = new uint8_t[(size_t) width * 2];
+
+  uint8_t *checkSrc = new uint8_t[(maxCheckLength * 5 + 4) * 3];
+
+  for (size_t i = 0; i < (size_t) width * rows * 3; i++)
+    src[i] = rand();
+
+  // Random pixels, with runs of bright ones that saturate when dithered
+  for (int i = 0; i < (maxCheckLength * 5 + 4) * 3; i++)
+    checkSrc[i] = ((i / 24) % 3 == 0) ? 248 + rand() % 8 : rand();
+
+  check("rgb888To565", RA8875_rgb888To565, NULL, true, checkSrc);
+  check("rgb888To332", RA8875_rgb888To332, NULL, false, checkSrc);
+  check("rgb888To565Dither", NULL, RA8875_rgb888To565Dither, true, checkSrc);
+  check("rgb888To332Dither", NULL, RA8875_rgb888To332Dither, false, checkSrc);
+
+  printf("name,kernel,pixels_per_s\n");
+  bench("rgb888To565", RA8875_rgb888To565, NULL, src, dst, width, rows);
+  bench("rgb888To332", RA8875_rgb888To332, NULL, src, dst, width, rows);
+  bench("rgb888To565Dither", NULL, RA8875_rgb888To565Dither, src, dst, width, rows);
+  bench("rgb888To332Dither", NULL, RA8875_rgb888To332Dither, src, dst, width, rows);
+
+  delete[] checkSrc;
+  delete[] src;
+  delete[] dst;
+
+  return failures ? 1 : 0;
+}
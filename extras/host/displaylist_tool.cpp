@@ -0,0 +1,208 @@
+// Records a display list offline, against the emulator, and prints it as a C array for flash.
+//
+// The screen drawn here stands in for a sketch's static screen: edit drawScreen() to match the
+//  sketch's drawing calls, at the same size and depth, and include the output in the sketch:
+//
+//   displaylist_tool [array name] > screen.h
+//
+//   #include "screen.h"
+//   tft.playDisplayList(screen, true);
+//
+// The tool also replays the list on a second emulator and checks it draws the same pixels as the
+//  calls did, sending no more bytes. On stderr it reports the list size, the SPI bytes and
+//  modelled time of drawing directly and of replaying, and the host CPU time each takes with
+//  nothing attached to the bus, which is the MCU's share of the work:
+//
+//   list_bytes,direct_bytes,direct_us,replay_bytes,replay_us,direct_cpu_us,replay_cpu_us,mismatches
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "NiftyRA8875.h"
+#include "RA8875Emulator.h"
+
+static const int width  = 480;
+static const int height = 272;
+static const int depth  = 16;
+
+static const size_t listSize = 65536;
+
+static const int cpuRuns = 200;
+
+static void drawScreen(RA8875 &tft)
+{
+  static const uint16_t background = RGB565(0, 0, 64);
+  static const uint16_t panel      = RGB565(32, 32, 96);
+  static const uint16_t frame      = RGB565(128, 128, 192);
+
+  tft.fillRect(0, 0, width - 1, height - 1, background);
+
+  // Title bar
+  tft.fillRect(0, 0, width - 1, 23, panel);
+  tft.setCursor(8, 4);
+  tft.setTextColor(255, 255, 255);
+  tft.print("Boiler room");
+
+  // Gauge faces with ticks
+  for (int g = 0; g < 3; g++)
+  {
+    int cx = 80 + g * 160, cy = 130;
+
+    tft.fillCircle(cx, cy, 60, panel);
+    tft.drawCircle(cx, cy, 60, frame);
+    for (int t = 0; t <= 10; t++)
+    {
+      static const int8_t cosTable[] = { -50, -48, -40, -29, -15, 0, 15, 29, 40, 48, 50 };
+      static const int8_t sinTable[] = { 0, 15, 29, 40, 48, 50, 48, 40, 29, 15, 0 };
+
+      tft.drawLine(cx + cosTable[t], cy - sinTable[t], cx + cosTable[t] * 11 / 10, cy - sinTable[t] * 11 / 10, frame);
+    }
+
+    tft.setCursor(cx - 20, cy + 30);
+    tft.print(g == 0 ? "Temp" : (g == 1 ? "Press" : "Flow"));
+  }
+
+  // Status strip with a pixel gradient
+  tft.drawRect(8, 210, width - 9, 263, frame);
+  for (int y = 212; y < 262; y++)
+  {
+    uint16_t row[width - 20];
+    for (int x = 0; x < width - 20; x++)
+      row[x] = RGB565(x * 255 / (width - 20), 64, y * 4 - 848);
+    tft.beginPixels(10, y);
+    tft.pushPixels(row, width - 20);
+    tft.endPixels();
+  }
+}
+
+struct Device
+{
+  RA8875 tft;
+  RA8875Emulator emu;
+
+  Device() : tft(10)
+  {
+    tft.getBus().setDevice(&emu);
+    hostSetDigitalReadHook(RA8875Emulator::hostDigitalRead, &emu);
+    hostSetClockHook(RA8875Emulator::hostMicros, &emu);
+    hostSetDelayHook(RA8875Emulator::hostDelay, &emu);
+    tft.init(width, height, depth);
+  }
+
+  ~Device()
+  {
+    hostSetDelayHook(NULL, NULL);
+    hostSetClockHook(NULL, NULL);
+    hostSetDigitalReadHook(NULL, NULL);
+    tft.getBus().setDevice(NULL);
+  }
+
+  // Modelled time since start, once everything sent has finished
+  uint64_t finish(uint64_t start)
+  {
+    tft.sync();
+    return emu.getTimeNs() - start;
+  }
+
+  // Host CPU time per draw, in microseconds, of the calls or of replaying list. The emulator is
+  //  detached, so only the library's own work is counted, and the chip never reads as busy.
+  double cpuTime(const uint8_t *list)
+  {
+    tft.getBus().setDevice(NULL);
+
+    clock_t start = clock();
+    for (int i = 0; i < cpuRuns; i++)
+    {
+      if (list)
+        tft.playDisplayList(list, true);
+      else
+        drawScreen(tft);
+    }
+    double us = (double) (clock() - start) * 1000000 / CLOCKS_PER_SEC / cpuRuns;
+
+    tft.getBus().setDevice(&emu);
+    return us;
+  }
+};
+
+int main(int argc, char **argv)
+{
+  const char *name = (argc > 1) ? argv[1] : "displayList";
+
+  uint8_t *list = new uint8_t[listSize];
+  RA8875_Recorder recorder;
+  size_t length;
+  uint32_t directBytes, replayBytes;
+  uint64_t directNs, replayNs;
+  double directCpuUs, replayCpuUs;
+  int mismatches = 0;
+
+  // Direct drawing, for comparison
+  {
+    Device dev;
+    uint32_t bytes = dev.emu.getCounters().bytes;
+    uint64_t start = dev.emu.getTimeNs();
+    drawScreen(dev.tft);
+    directNs = dev.finish(start);
+    directBytes = dev.emu.getCounters().bytes - bytes;
+
+    directCpuUs = dev.cpuTime(NULL);
+  }
+
+  // Recording, which draws as well
+  Device recorded;
+  recorded.tft.beginRecording(&recorder, list, listSize);
+  drawScreen(recorded.tft);
+  length = recorded.tft.endRecording();
+
+  if (length == 0)
+  {
+    fprintf(stderr, "List doesn't fit in %u bytes\n", (unsigned) listSize);
+    return 1;
+  }
+
+  // Replay
+  {
+    Device dev;
+    uint32_t bytes = dev.emu.getCounters().bytes;
+    uint64_t start = dev.emu.getTimeNs();
+    if (!dev.tft.playDisplayList(list, true))
+    {
+      fprintf(stderr, "List rejected\n");
+      return 1;
+    }
+    replayNs = dev.finish(start);
+    replayBytes = dev.emu.getCounters().bytes - bytes;
+
+    for (int y = 0; y < height; y++)
+    {
+      for (int x = 0; x < width; x++)
+      {
+        if (dev.emu.getPixel(1, x, y) != recorded.emu.getPixel(1, x, y))
+          mismatches++;
+      }
+    }
+
+    replayCpuUs = dev.cpuTime(list);
+  }
+
+  printf("// Display list for %dx%d at %d bpp, made by displaylist_tool\n", width, height, depth);
+  printf("const uint8_t %s[%u] PROGMEM =\n{", name, (unsigned) length);
+  for (size_t i = 0; i < length; i++)
+    printf("%s0x%02X%s", (i % 16) ? " " : "\n  ", list[i], (i + 1 < length) ? "," : "");
+  printf("\n};\n");
+
+  fprintf(stderr, "list_bytes,direct_bytes,direct_us,replay_bytes,replay_us,direct_cpu_us,replay_cpu_us,mismatches\n");
+  fprintf(stderr, "%u,%u,%.1f,%u,%.1f,%.1f,%.1f,%d\n", (unsigned) length, directBytes, directNs / 1000.0, replayBytes,
+          replayNs / 1000.0, directCpuUs, replayCpuUs, mismatches);
+
+  delete[] list;
+
+  if (replayBytes > directBytes)
+  {
+    fprintf(stderr, "Replay sent more bytes than drawing directly\n");
+    return 1;
+  }
+
+  return mismatches ? 1 : 0;
+}
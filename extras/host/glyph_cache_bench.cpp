@@ -0,0 +1,234 @@
+// Measures what the glyph cache saves per character, for a range of glyph sizes, against the
+//  emulator, and checks that it keeps out of layers used as frame buffers.
+//
+// For each size, a made-up font of 16 glyphs fills layer 1 with text twice, pipelined: drawn
+//  directly, and copied from a warmed-up cache at the bottom of layer 2. Both must leave the same
+//  pixels. This is done at the full SPI clock and again capped at 8 MHz, as on a 16 MHz AVR. It
+//  then checks that setCompositor() and beginFrame() turn the cache off, and that setGlyphCache()
+//  refuses a layer either of them uses. It exits non-zero if any check fails. Passing "int" waits
+//  for the BTE on the emulator's INT line instead of polling.
+//
+//   glyph_cache_bench [int]
+//
+// Output is CSV, per character:
+//
+//   spi_khz,glyph,chars,uncached_bytes,cached_bytes,uncached_us,cached_us
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NiftyRA8875.h"
+#include "RA8875Emulator.h"
+
+static const int width  = 480;
+static const int height = 272;
+
+static const int glyphCount = 16;
+
+static const int sizes[][2] = { { 6, 8 }, { 8, 12 }, { 12, 16 }, { 16, 20 }, { 20, 24 }, { 28, 32 }, { 40, 48 } };
+
+// SPI write clock limits; 0 leaves it at SYS_CLK / 3
+static const uint32_t spiLimits[] = { 0, 8000000 };
+
+static const uint16_t ink = RGB565(255, 200, 0);
+
+static const int intPin = 3;
+
+static bool useInt = false;
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    fprintf(stderr, "FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+// Glyphs 'A' onwards of one size, each a different scatter of about a third of its pixels
+struct TestFont
+{
+  RA8875_Glyph glyphs[glyphCount];
+  uint8_t bitmap[glyphCount * 40 * 48 / 8 + glyphCount];
+  RA8875_Font font;
+
+  TestFont(int w, int h)
+  {
+    memset(bitmap, 0, sizeof(bitmap));
+    uint16_t offset = 0;
+
+    for (int g = 0; g < glyphCount; g++)
+    {
+      RA8875_Glyph glyph = { offset, (uint8_t) w, (uint8_t) h, (uint8_t) (w + 2), 0, (int8_t) -h };
+      glyphs[g] = glyph;
+
+      for (int i = 0; i < w * h; i++)
+      {
+        if (((i % w) * 7 + (i / w) * 13 + g * 5) % 11 < 4)
+          bitmap[offset + i / 8] |= 0x80 >> (i % 8);
+      }
+
+      offset += (w * h + 7) / 8;
+    }
+
+    font.bitmap   = bitmap;
+    font.glyph    = glyphs;
+    font.first    = 'A';
+    font.last     = 'A' + glyphCount - 1;
+    font.yAdvance = h + 4;
+  }
+};
+
+struct Device
+{
+  RA8875 tft;
+  RA8875Emulator emu;
+
+  Device(uint32_t spiLimit = 0) : tft(10, -1, useInt ? intPin : -1)
+  {
+    tft.getBus().setDevice(&emu);
+    emu.setIntPin(intPin);
+    hostSetDigitalReadHook(RA8875Emulator::hostDigitalRead, &emu);
+    hostSetClockHook(RA8875Emulator::hostMicros, &emu);
+    hostSetDelayHook(RA8875Emulator::hostDelay, &emu);
+    tft.init(width, height, 16);
+    tft.setSPIClock(spiLimit);
+    tft.setPipelined(true);
+    tft.sync();
+  }
+
+  ~Device()
+  {
+    hostSetDelayHook(NULL, NULL);
+    hostSetClockHook(NULL, NULL);
+    hostSetDigitalReadHook(NULL, NULL);
+    tft.getBus().setDevice(NULL);
+  }
+};
+
+struct Result
+{
+  int chars;
+  uint32_t bytes;
+  uint64_t ns;
+};
+
+// Fills layer 1 with rows of the font's glyphs in turn
+static Result fill(Device &dev, const TestFont &font)
+{
+  uint32_t bytes = dev.emu.getCounters().bytes;
+  uint64_t start = dev.emu.getTimeNs();
+
+  Result result = { 0, 0, 0 };
+
+  for (int y = font.font.yAdvance; y <= height; y += font.font.yAdvance)
+  {
+    for (int x = 0; x + font.glyphs[0].xAdvance <= width; )
+    {
+      x += dev.tft.drawFontChar(x, y, 'A' + result.chars % glyphCount, ink);
+      result.chars++;
+    }
+  }
+
+  dev.tft.sync();
+
+  result.bytes = dev.emu.getCounters().bytes - bytes;
+  result.ns    = dev.emu.getTimeNs() - start;
+
+  return result;
+}
+
+// Draws each glyph once, so they're all in the cache if there is one. Glyphs hang above the
+//  baseline, and one clipped by the top of the screen wouldn't be cached.
+static void warmUp(Device &dev, const TestFont &font)
+{
+  for (int g = 0; g < glyphCount; g++)
+    dev.tft.drawFontChar(0, font.font.yAdvance, 'A' + g, ink);
+}
+
+static void measure(int w, int h, uint32_t spiLimit)
+{
+  TestFont font(w, h);
+
+  Device direct(spiLimit);
+  direct.tft.setFont(&font.font);
+  warmUp(direct, font);
+  Result uncached = fill(direct, font);
+
+  Device cached(spiLimit);
+  RA8875_Glyph_Cache cache;
+  cached.tft.setFont(&font.font);
+  check(cached.tft.setGlyphCache(&cache), "no default glyph cache");
+  warmUp(cached, font);
+
+  uint32_t misses = cache.misses;
+  Result hits = fill(cached, font);
+  check((misses == glyphCount) && (cache.misses == misses), "glyphs missed the cache after warming up");
+
+  bool same = true;
+  for (int y = 0; y < height; y++)
+    for (int x = 0; x < width; x++)
+      same = same && (cached.emu.getPixel(1, x, y) == direct.emu.getPixel(1, x, y));
+  check(same, "cached glyphs drew different pixels");
+
+  printf("%u,%dx%d,%d,%.1f,%.1f,%.2f,%.2f\n", cached.tft.getSPIWriteClock() / 1000, w, h, uncached.chars, (double) uncached.bytes / uncached.chars,
+         (double) hits.bytes / hits.chars, uncached.ns / 1000.0 / uncached.chars, hits.ns / 1000.0 / hits.chars);
+}
+
+// Whether drawing a character went through the cache
+static bool usesCache(Device &dev, RA8875_Glyph_Cache &cache)
+{
+  uint32_t lookups = cache.hits + cache.misses;
+  dev.tft.drawFontChar(10, 40, 'A', ink);
+  return cache.hits + cache.misses != lookups;
+}
+
+static void checkBuffers(void)
+{
+  TestFont font(12, 16);
+  RA8875_Glyph_Cache cache;
+  RA8875_Compositor compositor;
+
+  {
+    Device dev;
+    dev.tft.setFont(&font.font);
+    dev.tft.setGlyphCache(&cache);
+    check(usesCache(dev, cache), "glyph cache not used");
+
+    dev.tft.setCompositor(&compositor);
+    check(!usesCache(dev, cache), "glyph cache left in a compositor back buffer");
+    check(!dev.tft.setGlyphCache(&cache), "default glyph cache accepted in a compositor back buffer");
+    check(!dev.tft.setGlyphCache(&cache, 2, 0, 200, width, 72), "glyph cache accepted in a compositor back buffer");
+    check(dev.tft.setGlyphCache(&cache, 1, 0, 200, width, 72), "glyph cache refused in layer 1 with a compositor");
+    check(usesCache(dev, cache), "glyph cache in layer 1 not used with a compositor");
+
+    dev.tft.setCompositor(NULL);
+    check(dev.tft.setGlyphCache(&cache), "default glyph cache refused after the compositor was turned off");
+  }
+
+  {
+    Device dev;
+    dev.tft.setFont(&font.font);
+    dev.tft.setGlyphCache(&cache, 1, 0, 200, width, 72);
+
+    dev.tft.beginFrame();
+    check(!usesCache(dev, cache), "glyph cache left in a double buffer");
+    check(!dev.tft.setGlyphCache(&cache, 1, 0, 200, width, 72), "glyph cache accepted in a double buffer");
+  }
+}
+
+int main(int argc, char **argv)
+{
+  useInt = (argc > 1) && (strcmp(argv[1], "int") == 0);
+
+  printf("spi_khz,glyph,chars,uncached_bytes,cached_bytes,uncached_us,cached_us\n");
+
+  for (size_t c = 0; c < sizeof(spiLimits) / sizeof(spiLimits[0]); c++)
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+      measure(sizes[s][0], sizes[s][1], spiLimits[c]);
+
+  checkBuffers();
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+// Measures the SPI traffic saved by waiting for BTE completion on the INT pin, against the
+//  emulator driving a simulated interrupt line.
+//
+// The same BTE copies run three ways: polling the status register, waiting on the INT pin, and
+//  with an INT pin that never fires, so every wait times out and falls back to polling. It checks
+//  that the INT pin wait reads no status at all, that each way draws the same pixels, and that a
+//  dead line still completes every copy. It exits non-zero if any check fails.
+//
+//   interrupt_check [ops]
+//
+// Output is CSV, per operation:
+//
+//   mode,ops,bytes_per_op,status_reads_per_op,bytes_saved_per_op,us_per_op
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "NiftyRA8875.h"
+#include "RA8875Emulator.h"
+
+static const int width  = 480;
+static const int height = 272;
+
+static const int intPin = 3;
+
+enum Mode
+{
+  MODE_POLLED,
+  MODE_INTERRUPT,
+  MODE_DEAD_LINE
+};
+
+struct Result
+{
+  uint32_t bytes;
+  uint32_t statusReads;
+  uint64_t ns;
+  uint16_t pixels[4];
+};
+
+// Copies of a few sizes from a pattern in layer 2 to layer 1
+static void copies(RA8875 &tft, int ops)
+{
+  static const int sizes[][2] = { { 16, 16 }, { 100, 60 }, { 240, 136 } };
+
+  for (int i = 0; i < ops; i++)
+  {
+    const int *size = sizes[i % 3];
+    tft.copy(2, (i * 7) % (width - size[0]), (i * 5) % (height - size[1]), size[0], size[1], 1,
+             (i * 13) % (width - size[0]), (i * 11) % (height - size[1]));
+  }
+}
+
+static Result run(enum Mode mode, int ops)
+{
+  RA8875 tft(10, -1, (mode == MODE_POLLED) ? -1 : intPin);
+  RA8875Emulator emu;
+  tft.getBus().setDevice(&emu);
+  hostSetDigitalReadHook(RA8875Emulator::hostDigitalRead, &emu);
+  hostSetClockHook(RA8875Emulator::hostMicros, &emu);
+  hostSetDelayHook(RA8875Emulator::hostDelay, &emu);
+
+  // A dead line: the chip drives a pin the driver isn't watching
+  emu.setIntPin((mode == MODE_DEAD_LINE) ? intPin + 1 : intPin);
+
+  tft.init(width, height, 16);
+
+  tft.setDrawLayer(2);
+  for (int y = 0; y < height; y += 8)
+    tft.fillRect(0, y, width - 1, y + 7, RGB565(y, 255 - y, (y * 3) & 0xFF));
+  tft.setDrawLayer(1);
+  tft.sync();
+
+  uint32_t bytes = emu.getCounters().bytes, statusReads = emu.getCounters().statusReads;
+  uint64_t start = emu.getTimeNs();
+
+  copies(tft, ops);
+  tft.sync();
+
+  Result result;
+  result.bytes       = emu.getCounters().bytes - bytes;
+  result.statusReads = emu.getCounters().statusReads - statusReads;
+  result.ns          = emu.getTimeNs() - start;
+  result.pixels[0]   = emu.getPixel(1, 10, 10);
+  result.pixels[1]   = emu.getPixel(1, 200, 100);
+  result.pixels[2]   = emu.getPixel(1, 300, 200);
+  result.pixels[3]   = emu.getPixel(1, 470, 260);
+
+  hostSetDelayHook(NULL, NULL);
+  hostSetClockHook(NULL, NULL);
+  hostSetDigitalReadHook(NULL, NULL);
+  tft.getBus().setDevice(NULL);
+
+  return result;
+}
+
+static void report(const char *name, const Result &r, const Result &polled, int ops)
+{
+  printf("%s,%d,%.1f,%.1f,%.1f,%.1f\n", name, ops, (double) r.bytes / ops, (double) r.statusReads / ops,
+         ((double) polled.bytes - r.bytes) / ops, r.ns / 1000.0 / ops);
+}
+
+int main(int argc, char **argv)
+{
+  int ops = (argc > 1) ? atoi(argv[1]) : 300;
+  int failures = 0;
+
+  Result polled = run(MODE_POLLED, ops);
+  Result interrupt = run(MODE_INTERRUPT, ops);
+
+  // Each dead-line wait sits out the full timeout, so only a few
+  int deadOps = 3;
+  Result dead = run(MODE_DEAD_LINE, deadOps);
+  Result deadPolled = run(MODE_POLLED, deadOps);
+
+  printf("mode,ops,bytes_per_op,status_reads_per_op,bytes_saved_per_op,us_per_op\n");
+  report("polled", polled, polled, ops);
+  report("interrupt", interrupt, polled, ops);
+  report("deadLine", dead, deadPolled, deadOps);
+
+  if (interrupt.statusReads != 0)
+  {
+    fprintf(stderr, "FAIL: the INT pin wait still read the status register %u times\n", interrupt.statusReads);
+    failures++;
+  }
+
+  for (int i = 0; i < 4; i++)
+  {
+    if (interrupt.pixels[i] != polled.pixels[i])
+    {
+      fprintf(stderr, "FAIL: the INT pin wait drew different pixels\n");
+      failures++;
+      break;
+    }
+  }
+
+  for (int i = 0; i < 4; i++)
+  {
+    if (dead.pixels[i] != deadPolled.pixels[i])
+    {
+      fprintf(stderr, "FAIL: falling back from a dead INT line drew different pixels\n");
+      failures++;
+      break;
+    }
+  }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+// Checks the cost of the streaming pixel writer (beginPixels() / pushPixels() / endPixels())
+//  against the recording bus's byte and CS counters, next to pushPixel() and drawPixel().
+//
+// For each depth it streams runs of two lengths and checks that the longer run costs exactly the
+//  pixel bytes more (1 per pixel at 8bpp, 2 at 16bpp) and no more CS assertions, and that the
+//  pixels reach the emulator's memory where they were sent. It exits non-zero if any check fails.
+//
+//   pixel_writer_check
+//
+// Output is CSV, per pixel of the longer run:
+//
+//   depth,method,bytes_per_pixel,selects_per_pixel
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "NiftyRA8875.h"
+#include "RA8875Emulator.h"
+
+static const int shortRun = 100;
+static const int longRun  = 1000;
+
+static int failures = 0;
+
+static void check(bool ok, int depth, const char *what)
+{
+  if (!ok)
+  {
+    fprintf(stderr, "FAIL %dbpp: %s\n", depth, what);
+    failures++;
+  }
+}
+
+struct Cost
+{
+  uint32_t bytes;
+  uint32_t selects;
+};
+
+// Pixel values as the chip stores them at the depth
+static uint16_t pattern(int i, int depth)
+{
+  uint16_t color = i * 37 + 5;
+  return (depth == 8) ? (color & 0xFF) : color;
+}
+
+static Cost streamed(RA8875 &tft, int depth, int y, int count)
+{
+  uint16_t pixels[longRun];
+  for (int i = 0; i < count; i++)
+    pixels[i] = pattern(i, depth);
+
+  tft.getBus().resetCounts();
+  tft.beginPixels(0, y);
+  tft.pushPixels(pixels, count);
+  tft.endPixels();
+
+  Cost cost = { tft.getBus().getBytes(), tft.getBus().getSelects() };
+  return cost;
+}
+
+static Cost pushed(RA8875 &tft, int depth, int y, int count)
+{
+  tft.getBus().resetCounts();
+  tft.setDrawPosition(0, y);
+  for (int i = 0; i < count; i++)
+    tft.pushPixel(pattern(i, depth));
+
+  Cost cost = { tft.getBus().getBytes(), tft.getBus().getSelects() };
+  return cost;
+}
+
+static Cost plotted(RA8875 &tft, int depth, int y, int count)
+{
+  tft.getBus().resetCounts();
+  for (int i = 0; i < count; i++)
+    tft.drawPixel(i % 480, y + i / 480, pattern(i, depth));
+
+  Cost cost = { tft.getBus().getBytes(), tft.getBus().getSelects() };
+  return cost;
+}
+
+static void report(int depth, const char *method, Cost cost, int count)
+{
+  printf("%d,%s,%.2f,%.3f\n", depth, method, (double) cost.bytes / count, (double) cost.selects / count);
+}
+
+static void run(int depth)
+{
+  RA8875 tft(10);
+  RA8875Emulator emu;
+  tft.getBus().setDevice(&emu);
+  hostSetDigitalReadHook(RA8875Emulator::hostDigitalRead, &emu);
+  hostSetClockHook(RA8875Emulator::hostMicros, &emu);
+  hostSetDelayHook(RA8875Emulator::hostDelay, &emu);
+
+  tft.init(480, 272, depth);
+
+  Cost a = streamed(tft, depth, 0, shortRun);
+  Cost b = streamed(tft, depth, 10, longRun);
+
+  check(b.bytes - a.bytes == (uint32_t) (longRun - shortRun) * (depth / 8), depth,
+        "streamed bytes per pixel");
+  check(b.selects == a.selects, depth, "streamed CS assertions grow with the run");
+
+  bool placed = true;
+  for (int i = 0; i < longRun; i++)
+    placed = placed && (emu.getPixel(1, i % 480, 10 + i / 480) == pattern(i, depth));
+  check(placed, depth, "streamed pixels not where they were sent");
+
+  report(depth, "pushPixels", b, longRun);
+  report(depth, "pushPixel", pushed(tft, depth, 20, longRun), longRun);
+  report(depth, "drawPixel", plotted(tft, depth, 30, longRun), longRun);
+
+  hostSetDelayHook(NULL, NULL);
+  hostSetClockHook(NULL, NULL);
+  hostSetDigitalReadHook(NULL, NULL);
+  tft.getBus().setDevice(NULL);
+}
+
+int main(void)
+{
+  printf("depth,method,bytes_per_pixel,selects_per_pixel\n");
+  run(16);
+  run(8);
+
+  return failures ? 1 : 0;
+}
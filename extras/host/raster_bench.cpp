@@ -0,0 +1,208 @@
+// Measures the span rasteriser against plotting the same shapes a pixel at a time, against the
+//  emulator.
+//
+// Each workload draws over a cleared screen with drawThickLine(), drawLineAA(), drawArc() or
+//  fillComplexPolygon(). Every pixel it changed is then drawn with drawPixel() on a second
+//  emulator, which is what a sketch rasterising these shapes itself would send. With a path, the
+//  layer each workload drew is also saved as <path>-<workload>.ppm.
+// It also checks thick lines whose end points are thousands of pixels off the screen, and exits
+//  non-zero if they don't cross it where they should.
+//
+//   raster_bench [path]
+//
+// Output is CSV:
+//
+//   workload,pixels,span_bytes,span_us,pixel_bytes,pixel_us
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "NiftyRA8875.h"
+#include "RA8875Emulator.h"
+
+static const int width  = 480;
+static const int height = 272;
+
+static const uint16_t background = RGB565(0, 0, 64);
+static const uint16_t ink        = RGB565(255, 200, 0);
+
+// A fan of lines 1 to 8 pixels wide, in all directions
+static void thickLines(RA8875 &tft)
+{
+  for (int i = 0; i < 24; i++)
+  {
+    float a = i * 0.2618f;
+    int c = (int) (100 * cosf(a)), s = (int) (100 * sinf(a));
+
+    tft.drawThickLine(240 + c * 3 / 10, 136 + s * 3 / 10, 240 + c * 12 / 10, 136 + s * 12 / 10, 1 + i % 8, ink);
+  }
+}
+
+// Anti-aliased lines at a range of slopes, like a chart or a gauge's ticks
+static void aaLines(RA8875 &tft)
+{
+  for (int i = 0; i < 32; i++)
+  {
+    tft.drawLineAA(20, 20 + i * 7, 460, 250 - i * 5, ink, background);
+    tft.drawLineAA(20 + i * 14, 10, 240 + i * 3, 260, ink, background);
+  }
+}
+
+// Gauge-style arcs: thin rings, thick bands and pie slices
+static void arcs(RA8875 &tft)
+{
+  for (int g = 0; g < 3; g++)
+  {
+    int cx = 80 + g * 160, cy = 136;
+
+    tft.drawArc(cx, cy, 70, 2, 135, 405, ink);
+    tft.drawArc(cx, cy, 60, 12, 135, 135 + 90 * (g + 1), RGB565(0, 200, 255));
+    tft.drawArc(cx, cy, 30, 31, 300 - g * 40, 330, RGB565(255, 0, 0));
+  }
+}
+
+// A self-intersecting star, whose centre the even-odd rule leaves empty, with a pentagon inside
+//  that centre and an overlapping bow-tie
+static void polygons(RA8875 &tft)
+{
+  static const RA8875_Point points[] =
+  {
+    { 240, 16 }, { 311, 235 }, { 125, 100 }, { 355, 100 }, { 169, 235 },
+    { 240, 110 }, { 262, 126 }, { 254, 152 }, { 226, 152 }, { 218, 126 },
+    { 20, 40 }, { 200, 250 }, { 200, 40 }, { 20, 250 }
+  };
+  static const uint16_t counts[] = { 5, 5, 4 };
+
+  tft.fillComplexPolygon(points, counts, 3, ink);
+}
+
+static const struct
+{
+  const char *name;
+  void (*draw)(RA8875 &);
+}
+s_workloads[] =
+{
+  { "thickLines", thickLines },
+  { "aaLines", aaLines },
+  { "arcs", arcs },
+  { "polygons", polygons }
+};
+
+struct Device
+{
+  RA8875 tft;
+  RA8875Emulator emu;
+
+  Device() : tft(10)
+  {
+    tft.getBus().setDevice(&emu);
+    hostSetDigitalReadHook(RA8875Emulator::hostDigitalRead, &emu);
+    hostSetClockHook(RA8875Emulator::hostMicros, &emu);
+    hostSetDelayHook(RA8875Emulator::hostDelay, &emu);
+    tft.init(width, height, 16);
+    tft.fillRect(0, 0, width - 1, height - 1, background);
+    tft.sync();
+  }
+
+  ~Device()
+  {
+    hostSetDelayHook(NULL, NULL);
+    hostSetClockHook(NULL, NULL);
+    hostSetDigitalReadHook(NULL, NULL);
+    tft.getBus().setDevice(NULL);
+  }
+};
+
+// Checks pixels on and beside thick lines running between points far off either side of the
+//  screen, beyond where sixteenths of a pixel fit in 16 bits
+static int checkLongLines(void)
+{
+  Device dev;
+  dev.tft.drawThickLine(-4000, 136, 4000, 136, 9, ink);
+  dev.tft.drawThickLine(-2760, -2864, 3240, 3136, 5, ink);
+  dev.tft.sync();
+
+  static const struct
+  {
+    int x;
+    int y;
+    bool inked;
+  }
+  probes[] =
+  {
+    { 0, 136, true }, { 240, 132, true }, { 479, 140, true }, { 240, 130, false }, { 479, 142, false },
+    { 140, 36, true }, { 340, 236, true }, { 150, 36, false }, { 340, 226, false }
+  };
+
+  int failures = 0;
+  for (size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); i++)
+  {
+    if ((dev.emu.getPixel(1, probes[i].x, probes[i].y) == ink) != probes[i].inked)
+    {
+      fprintf(stderr, "FAIL: long thick line %s at %d, %d\n", probes[i].inked ? "missing" : "drawn",
+              probes[i].x, probes[i].y);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+int main(int argc, char **argv)
+{
+  const char *path = (argc > 1) ? argv[1] : NULL;
+
+  printf("workload,pixels,span_bytes,span_us,pixel_bytes,pixel_us\n");
+
+  for (size_t w = 0; w < sizeof(s_workloads) / sizeof(s_workloads[0]); w++)
+  {
+    Device spans;
+    uint32_t spanBytes = spans.emu.getCounters().bytes;
+    uint64_t start = spans.emu.getTimeNs();
+    s_workloads[w].draw(spans.tft);
+    spans.tft.sync();
+    uint64_t spanNs = spans.emu.getTimeNs() - start;
+    spanBytes = spans.emu.getCounters().bytes - spanBytes;
+
+    if (path)
+    {
+      char name[256];
+      snprintf(name, sizeof(name), "%s-%s.ppm", path, s_workloads[w].name);
+      spans.emu.writeLayerPPM(1, name);
+    }
+
+    // The same pixels, one at a time
+    int pixels = 0;
+    uint32_t pixelBytes;
+    uint64_t pixelNs;
+    {
+      Device plotted;
+      pixelBytes = plotted.emu.getCounters().bytes;
+      start = plotted.emu.getTimeNs();
+
+      for (int y = 0; y < height; y++)
+      {
+        for (int x = 0; x < width; x++)
+        {
+          uint16_t pixel = spans.emu.getPixel(1, x, y);
+
+          if (pixel != background)
+          {
+            plotted.tft.drawPixel(x, y, pixel);
+            pixels++;
+          }
+        }
+      }
+
+      plotted.tft.sync();
+      pixelNs = plotted.emu.getTimeNs() - start;
+      pixelBytes = plotted.emu.getCounters().bytes - pixelBytes;
+    }
+
+    printf("%s,%d,%u,%.1f,%u,%.1f\n", s_workloads[w].name, pixels, spanBytes, spanNs / 1000.0, pixelBytes,
+           pixelNs / 1000.0);
+  }
+
+  return checkLongLines() ? 1 : 0;
+}
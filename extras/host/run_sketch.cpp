@@ -0,0 +1,51 @@
+// Runs an example sketch against the emulator and dumps the result.
+//
+// The sketch is pulled in with RA8875_SKETCH, and must declare its display as a global named
+//  tft. The sketch's clock follows the emulator's model of elapsed chip and bus time, so the
+//  timings it reports are what the modelled hardware would take (MCU time is not included).
+// After setup() returns, both layers and the composed display are written as PPM files
+//  and the emulator's counters are printed.
+//
+//   run_sketch [output prefix] [loop count]
+
+#include "RA8875Emulator.h"
+
+#ifndef RA8875_SKETCH
+# error "Define RA8875_SKETCH as the quoted path of the .ino to run"
+#endif
+
+#include RA8875_SKETCH
+
+static RA8875Emulator emulator;
+
+int main(int argc, char **argv)
+{
+  const char *prefix = (argc > 1) ? argv[1] : "screen";
+  int loops = (argc > 2) ? atoi(argv[2]) : 0;
+
+  tft.getBus().setDevice(&emulator);
+  hostSetDigitalReadHook(RA8875Emulator::hostDigitalRead, &emulator);
+  hostSetClockHook(RA8875Emulator::hostMicros, &emulator);
+  hostSetDelayHook(RA8875Emulator::hostDelay, &emulator);
+
+  setup();
+  for (int i = 0; i < loops; i++)
+    loop();
+
+  char path[256];
+  for (int layer = 1; layer <= emulator.getLayerCount(); layer++)
+  {
+    snprintf(path, sizeof(path), "%s-layer%d.ppm", prefix, layer);
+    emulator.writeLayerPPM(layer, path);
+  }
+  snprintf(path, sizeof(path), "%s-display.ppm", prefix);
+  emulator.writeDisplayPPM(path);
+
+  const RA8875Emulator::Counters &c = emulator.getCounters();
+  fprintf(stderr, "bytes=%u selects=%u cmd=%u dataWrite=%u dataRead=%u status=%u busyPolls=%u pixelsWritten=%u pixelsDrawn=%u busyUs=%llu chipTimeUs=%llu clockViolations=%u textOverruns=%u engineOverruns=%u\n",
+    c.bytes, c.selects, c.cmdWrites, c.dataWrites, c.dataReads, c.statusReads, c.busyPolls,
+    c.pixelsWritten, c.pixelsDrawn, (unsigned long long) (c.busyNs / 1000), (unsigned long long) (emulator.getTimeNs() / 1000),
+    c.clockViolations, c.textOverruns, c.engineOverruns);
+
+  return 0;
+}
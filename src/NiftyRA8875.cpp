@@ -1,65 +1,775 @@
 #pragma GCC diagnostic warning "-Wall"
 #include "NiftyRA8875.h"
 
-void RA8875::writeCmd(uint8_t x)
+// Register addresses for each slot of the shadow cache, in RA8875_Shadow_Reg order.
+const uint8_t RA8875::s_shadowRegs[RA8875_SHADOW_COUNT] PROGMEM =
 {
-  digitalWrite(m_csPin, LOW);
-  SPI.transfer(RA8875_CMD_WRITE);
-  SPI.transfer(x);
-  digitalWrite(m_csPin, HIGH);
+  RA8875_REG_PWRR,  RA8875_REG_DPCR,  RA8875_REG_FNCR0, RA8875_REG_FNCR1, RA8875_REG_FWTSR, RA8875_REG_SFRS,
+  RA8875_REG_HSAW0, RA8875_REG_HSAW1, RA8875_REG_VSAW0, RA8875_REG_VSAW1,
+  RA8875_REG_HEAW0, RA8875_REG_HEAW1, RA8875_REG_VEAW0, RA8875_REG_VEAW1,
+  RA8875_REG_HSSW0, RA8875_REG_HSSW1, RA8875_REG_VSSW0, RA8875_REG_VSSW1,
+  RA8875_REG_HESW0, RA8875_REG_HESW1, RA8875_REG_VESW0, RA8875_REG_VESW1,
+  RA8875_REG_HOFS0, RA8875_REG_HOFS1, RA8875_REG_VOFS0, RA8875_REG_VOFS1,
+  RA8875_REG_MWCR0, RA8875_REG_MWCR1, RA8875_REG_LTPR0, RA8875_REG_LTPR1,
+  RA8875_REG_BGCR0, RA8875_REG_BGCR1, RA8875_REG_BGCR2,
+  RA8875_REG_FGCR0, RA8875_REG_FGCR1, RA8875_REG_FGCR2,
+  RA8875_REG_BECR1,
+  RA8875_REG_HSBE0, RA8875_REG_HSBE1, RA8875_REG_VSBE0, RA8875_REG_VSBE1,
+  RA8875_REG_HDBE0, RA8875_REG_HDBE1, RA8875_REG_VDBE0, RA8875_REG_VDBE1,
+  RA8875_REG_BEWR0, RA8875_REG_BEWR1, RA8875_REG_BEHR0, RA8875_REG_BEHR1,
+  RA8875_REG_DLHSR0, RA8875_REG_DLHSR1, RA8875_REG_DLVSR0, RA8875_REG_DLVSR1,
+  RA8875_REG_DLHER0, RA8875_REG_DLHER1, RA8875_REG_DLVER0, RA8875_REG_DLVER1,
+  RA8875_REG_DCHR0, RA8875_REG_DCHR1, RA8875_REG_DCVR0, RA8875_REG_DCVR1, RA8875_REG_DCRR,
+  RA8875_REG_DTPH0, RA8875_REG_DTPH1, RA8875_REG_DTPV0, RA8875_REG_DTPV1,
+  RA8875_REG_ELLA0, RA8875_REG_ELLA1, RA8875_REG_ELLB0, RA8875_REG_ELLB1,
+  RA8875_REG_DEHR0, RA8875_REG_DEHR1, RA8875_REG_DEVR0, RA8875_REG_DEVR1
+};
+
+// Built-in panels, looked up by size in init(). Porches and sync widths are typical values for
+//  each size; check the panel's datasheet and pass a RA8875_Panel of your own if it differs.
+const RA8875_Panel RA8875::s_panels[] PROGMEM =
+{
+  //  w    h  crystal               SYS_CLK   PCSR  hNonDisp hSyncStart hSyncWidth vNonDisp vSyncStart vSyncWidth
+  { 320, 240, RA8875_CRYSTAL_FREQ, 55000000, 0x83,  40,      16,        24,        16,      4,         2 },  // PCLK SYS_CLK / 8
+  { 480, 272, RA8875_CRYSTAL_FREQ, 55000000, 0x82,  16,       8,        48,         3,      8,        10 },  // PCLK SYS_CLK / 4
+  { 640, 480, RA8875_CRYSTAL_FREQ, 60000000, 0x81,  48,      16,        96,        33,     10,         2 },  // PCLK SYS_CLK / 2
+  { 800, 480, RA8875_CRYSTAL_FREQ, 60000000, 0x81,  32,      32,        96,        33,     23,         2 }   // PCLK SYS_CLK / 2
+};
+
+// Writes a register through the shadow cache. The write is skipped if the register already
+//  holds the value. Must be called inside an SPI transaction.
+void RA8875::writeShadowReg(enum RA8875_Shadow_Reg index, uint8_t x)
+{
+  // A display list can't assume anything about registers it hasn't written itself
+  RA8875_Recorder *rec = m_recorder;
+  bool known = !rec || (rec->known[index / 8] & (1 << (index % 8)));
+
+  if (known && (m_shadow[index] == x))
+    return;
+
+  m_shadow[index] = x;
+
+  if (rec)
+  {
+    rec->known[index / 8] |= 1 << (index % 8);
+    rec->shadow = index;
+  }
+
+  writeReg(pgm_read_byte(&s_shadowRegs[index]), x);
 }
 
-void RA8875::writeData(uint8_t x)
+// Writes a 16-bit value to a pair of shadowed registers, low byte first.
+void RA8875::writeShadowReg16(enum RA8875_Shadow_Reg index, uint16_t x)
 {
-  digitalWrite(m_csPin, LOW);
-  SPI.transfer(RA8875_DATA_WRITE);
-  SPI.transfer(x);
-  digitalWrite(m_csPin, HIGH);
+  writeShadowReg(index, x & 0xFF);
+  writeShadowReg((enum RA8875_Shadow_Reg) (index + 1), x >> 8);
 }
 
-uint8_t RA8875::readData(void)
+// Sets the foreground colour registers from an RGB565 colour.
+void RA8875::setForegroundColor(uint16_t color)
 {
-  digitalWrite(m_csPin, LOW);
-  SPI.transfer(RA8875_DATA_READ);
-  uint8_t x = SPI.transfer(0);
-  digitalWrite(m_csPin, HIGH);
-  return x;
+  writeShadowReg(RA8875_SHADOW_FGCR0, color >> 11);            // R
+  writeShadowReg(RA8875_SHADOW_FGCR1, (color & 0x07E0) >> 5);  // G
+  writeShadowReg(RA8875_SHADOW_FGCR2, color & 0x1F);           // B
 }
 
-// Reads the special status register.
-// This register uses a special cycle type instead of having an address like other registers.
-uint8_t RA8875::readStatus(void)
+// Sets the foreground colour registers from a pixel value in the current depth's format: RGB565
+//  at 16bpp, RGB332 at 8bpp. Used for BTE colour keys, which are compared with raw pixels.
+void RA8875::setForegroundPixel(uint16_t pixel)
 {
-  digitalWrite(m_csPin, LOW);
-  SPI.transfer(RA8875_STATUS_READ);
-  uint8_t x = SPI.transfer(0);
-  digitalWrite(m_csPin, HIGH);
-  return x;
+  uint8_t r, g, b;
+  splitPixel(pixel, &r, &g, &b);
+
+  writeShadowReg(RA8875_SHADOW_FGCR0, r);
+  writeShadowReg(RA8875_SHADOW_FGCR1, g);
+  writeShadowReg(RA8875_SHADOW_FGCR2, b);
+}
+
+// Sets the background colour registers from a pixel value, for colour expansion. ROM text is
+//  drawn on the same colour, so setTextMode() puts it back.
+void RA8875::setBackgroundPixel(uint16_t pixel)
+{
+  uint8_t r, g, b;
+  splitPixel(pixel, &r, &g, &b);
+
+  writeShadowReg(RA8875_SHADOW_BGCR0, r);
+  writeShadowReg(RA8875_SHADOW_BGCR1, g);
+  writeShadowReg(RA8875_SHADOW_BGCR2, b);
+}
+
+// Splits a pixel value into the components the colour registers take at the current depth.
+void RA8875::splitPixel(uint16_t pixel, uint8_t *r, uint8_t *g, uint8_t *b)
+{
+  if (m_depth == 16)
+  {
+    *r = pixel >> 11;
+    *g = (pixel >> 5) & 0x3F;
+    *b = pixel & 0x1F;
+  }
+  else
+  {
+    *r = (pixel >> 5) & 0x07;
+    *g = (pixel >> 2) & 0x07;
+    *b = pixel & 0x03;
+  }
+}
+
+// Reloads the shadow cache from the chip.
+// Call this if the chip has been reset or its registers changed behind our back.
+void RA8875::resyncRegisters(void)
+{
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
+
+  beginTransaction();
+
+  for (int i = 0; i < RA8875_SHADOW_COUNT; i++)
+    m_shadow[i] = readReg(pgm_read_byte(&s_shadowRegs[i]));
+
+  endTransaction();
+}
+
+// Polls until the given engine operation has completed.
+void RA8875::waitEngine(enum RA8875_Engine_Wait wait)
+{
+  // The wait goes into a display list as one op, with none of the polling or acknowledging
+  RA8875_Recorder *recorder = m_recorder;
+  if (recorder && (wait != RA8875_WAIT_NONE))
+    recordWait(RA8875_DL_WAIT, wait);
+  m_recorder = NULL;
+
+  RA8875_STATS_WAIT_BEGIN();
+
+#if RA8875_PRINT_TIMING
+  uint32_t startTime = micros();
+  int iter = 0;
+#endif
+
+  switch (wait)
+  {
+    case RA8875_WAIT_DRAW:
+      while (readReg(RA8875_REG_DCR) & 0x80)
+        ;
+      break;
+    case RA8875_WAIT_CIRCLE:
+      while (readReg(RA8875_REG_DCR) & 0x40)
+        ;
+      break;
+    case RA8875_WAIT_ELLIPSE:
+      while (readReg(RA8875_REG_ELLCR) & 0x80)
+        ;
+      break;
+    case RA8875_WAIT_BTE:
+      // With the INT pin hooked up, wait on the pin instead of polling over SPI
+      if ((m_intPin >= 0) && waitInterrupt(RA8875_INT_BTE))
+        break;
+
+      // Wait for status register bit 6 to be clear
+#if RA8875_PRINT_TIMING
+      while (readStatus() & 0x40)
+        iter++;
+#else
+      while (readStatus() & 0x40)
+        ;
+#endif
+
+      // The interrupt may have come in while polling, and mustn't be taken for the next BTE's
+      if (m_intPin >= 0)
+        writeReg(RA8875_REG_INTC2, RA8875_INT_BTE);
+      break;
+    default:
+      break;
+  }
+
+#if RA8875_PRINT_TIMING
+  if (wait == RA8875_WAIT_BTE)
+  {
+    uint32_t endTime = micros();
+    Serial.print("BTE done in "); Serial.print(endTime - startTime); Serial.print(" us "); Serial.print(iter); Serial.println(" iter");
+  }
+#endif
+
+  RA8875_STATS_WAIT_END();
+
+  m_recorder = recorder;
+}
+
+// Waits for the INT pin to be asserted, then acknowledges the given interrupt source.
+// The SPI bus is released while waiting so other devices can use it. Returns false if the
+//  interrupt didn't arrive in time, in which case the caller falls back to polling.
+bool RA8875::waitInterrupt(uint8_t source)
+{
+  m_bus.endTransaction();
+
+  uint32_t startTime = millis();
+  bool fired;
+  while (!(fired = (digitalRead(m_intPin) == LOW)) && ((millis() - startTime) < RA8875_INT_TIMEOUT))
+    ;
+
+  beginBusTransaction();
+
+  if (fired)
+    writeReg(RA8875_REG_INTC2, source);  // Write 1 to clear
+
+  return fired;
+}
+
+// Called right after an engine operation has been started.
+// When pipelining, the wait is deferred to the next register access, so whatever the MCU does
+//  before then overlaps the operation.
+void RA8875::finishEngine(enum RA8875_Engine_Wait wait)
+{
+  if (m_pipelined)
+    m_pendingWait = wait;
+  else
+    waitEngine(wait);
+}
+
+// Waits for any engine operation left running by a previous call.
+void RA8875::syncEngine(void)
+{
+  // Cleared first, since waiting reads registers
+  enum RA8875_Engine_Wait wait = m_pendingWait;
+  m_pendingWait = RA8875_WAIT_NONE;
+
+  waitEngine(wait);
+}
+
+// Enables or disables pipelined drawing.
+// When enabled, shape and BTE calls return as soon as the operation has been started, and the
+//  wait for completion happens in the next call that talks to the chip, before its first register
+//  access.
+void RA8875::setPipelined(bool enabled)
+{
+  if (!enabled)
+    sync();
+
+  m_pipelined = enabled;
+}
+
+// Waits for any pipelined drawing operation to complete.
+void RA8875::sync(void)
+{
+  RA8875_STATS_OP(RA8875_OP_SYNC);
+
+  if ((m_pendingWait == RA8875_WAIT_NONE) && !m_textPending)
+    return;
+
+  beginBusTransaction();
+  if (m_pendingWait != RA8875_WAIT_NONE)
+    syncEngine();
+  waitText();
+  m_bus.endTransaction();
+}
+
+// Starts recording a display list into buffer. Calls until endRecording() still draw as usual,
+//  and what they send is added to the list: register writes with the values they had, text, pixel
+//  data, and waits for the engines. Anything read back from the chip, like the text cursor after
+//  a proportional font, is built into the values that follow. recorder and buffer must stay
+//  allocated until endRecording().
+void RA8875::beginRecording(RA8875_Recorder *recorder, uint8_t *buffer, size_t size)
+{
+  RA8875_STATS_OP(RA8875_OP_LIST);
+
+  // Leave text mode and finish anything pipelined, so neither ends up in the list
+  beginTransaction();
+  if (m_pendingWait != RA8875_WAIT_NONE)
+    syncEngine();
+  endTransaction();
+
+  memset(recorder, 0, sizeof(*recorder));
+  recorder->buffer = buffer;
+  recorder->size   = size;
+  recorder->cmd    = -1;
+  recorder->shadow = -1;
+
+  m_recorder = recorder;
+
+  recordByte(RA8875_DL_VERSION);
+  recordByte(RA8875_SHADOW_COUNT);
+  recordByte(m_depth);
+
+  // Nothing the chip holds now can be relied on at replay
+  m_cursorValid = false;
+  m_cmdReg      = -1;
+}
+
+// Finishes the display list. Returns its length in bytes, or 0 if it didn't fit in the buffer.
+size_t RA8875::endRecording(void)
+{
+  RA8875_STATS_OP(RA8875_OP_LIST);
+
+  RA8875_Recorder *rec = m_recorder;
+  if (rec == NULL)
+    return 0;
+
+  // A pipelined operation's wait belongs in the list
+  if (m_pendingWait != RA8875_WAIT_NONE)
+  {
+    beginBusTransaction();
+    syncEngine();
+    m_bus.endTransaction();
+  }
+
+  rec->waitText = false;
+  if (m_cursorValid)
+    recordCursor(RA8875_DL_CURSOR_AT, m_cursorX, m_cursorY);
+  else
+    recordPending();
+  recordByte(RA8875_DL_END);
+
+  m_recorder = NULL;
+
+  return rec->overflow ? 0 : rec->length;
+}
+
+static inline uint8_t listByte(const uint8_t *p, bool progmem)
+{
+  return progmem ? pgm_read_byte(p) : *p;
+}
+
+// Sends a display list made by beginRecording(), or offline by a host program doing the same.
+//  With progmem, the list is read from flash. Returns false if the list was made for another
+//  colour depth or library version.
+// The text cursor is followed through the list's own moves, and a move from wherever the cursor
+//  was when recording began only sends the bytes that differ from where it is now, as a call
+//  would. Damage tracking can't follow a list, so a compositor treats the whole draw layer as
+//  damaged.
+bool RA8875::playDisplayList(const uint8_t *list, bool progmem)
+{
+  RA8875_STATS_OP(RA8875_OP_LIST);
+
+  if ((listByte(list, progmem) != RA8875_DL_VERSION) || (listByte(list + 1, progmem) != RA8875_SHADOW_COUNT) ||
+      (listByte(list + 2, progmem) != m_depth))
+    return false;
+
+  const uint8_t *p = list + RA8875_DL_HEADER;
+  bool valid = true;
+
+  beginTransaction();
+
+  for (uint8_t op; valid && ((op = listByte(p++, progmem)) != RA8875_DL_END); )
+  {
+    if (op & RA8875_DL_SHADOW)
+    {
+      uint8_t first = listByte(p++, progmem);
+
+      for (uint8_t i = 0; i < (op & RA8875_DL_RUN_MAX); i++)
+        writeShadowReg((enum RA8875_Shadow_Reg) (first + i), listByte(p++, progmem));
+      continue;
+    }
+
+    if (op & RA8875_DL_REG)
+    {
+      uint8_t first = listByte(p++, progmem);
+
+      for (uint8_t i = 0; i < (op & RA8875_DL_RUN_MAX); i++)
+      {
+        uint8_t reg = first + i;
+
+        // A move the list knew the start of leaves nothing known here
+        if ((reg >= RA8875_REG_FCURX0) && (reg <= RA8875_REG_FCURY1))
+          m_cursorValid = false;
+
+        writeReg(reg, listByte(p++, progmem));
+      }
+      continue;
+    }
+
+    switch (op)
+    {
+
+      case RA8875_DL_CMD:
+        writeCmd(listByte(p++, progmem));
+        break;
+
+      case RA8875_DL_DATA:
+      case RA8875_DL_TEXT:
+      {
+        uint8_t count = listByte(p++, progmem);
+
+        m_cursorValid = false;
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+          if (op == RA8875_DL_TEXT)
+          {
+            waitText();
+            if (m_recorder)
+              m_recorder->text = true;
+          }
+
+          writeData(listByte(p++, progmem));
+
+          if (op == RA8875_DL_TEXT)
+          {
+            m_textPending = true;
+          }
+        }
+        break;
+      }
+
+      case RA8875_DL_PIXELS:
+      {
+        size_t length = listByte(p, progmem) | (listByte(p + 1, progmem) << 8);
+        p += 2;
+
+        m_bus.select();
+        m_bus.transfer(RA8875_DATA_WRITE);
+        RA8875_STATS_ADD(dataCycles, 1);
+        RA8875_STATS_ADD(csToggles, 1);
+        RA8875_STATS_ADD(bytes, 1);
+
+        if (progmem)
+        {
+          uint8_t buf[RA8875_XFER_BUFFER_SIZE];
+          while (length)
+          {
+            size_t n = min(length, sizeof(buf));
+            memcpy_P(buf, p, n);
+            pushPixelBytes(buf, n);
+            p += n;
+            length -= n;
+          }
+        }
+        else
+        {
+          pushPixelBytes(p, length);
+          p += length;
+        }
+
+        m_bus.deselect();
+        break;
+      }
+
+      case RA8875_DL_WAIT:
+        waitEngine((enum RA8875_Engine_Wait) listByte(p++, progmem));
+        break;
+
+      case RA8875_DL_WAIT_BUSY:
+        waitBusy();
+        break;
+
+      case RA8875_DL_WAIT_TEXT:
+        // Characters sent as plain data don't leave a wait pending, so poll either way
+        waitBusy();
+        m_textPending = false;
+        break;
+
+      case RA8875_DL_WAIT_CLEAR:
+        waitClear();
+        break;
+
+      case RA8875_DL_CURSOR:
+      case RA8875_DL_CURSOR_AT:
+      {
+        int x = listByte(p, progmem) | (listByte(p + 1, progmem) << 8);
+        int y = listByte(p + 2, progmem) | (listByte(p + 3, progmem) << 8);
+        p += 4;
+
+        if (op == RA8875_DL_CURSOR)
+          moveTextCursor(x, y);
+        else
+        {
+          m_cursorX = x;
+          m_cursorY = y;
+          m_cursorValid = true;
+        }
+        break;
+      }
+
+      default:
+        valid = false;
+        break;
+    }
+  }
+
+  endTransaction();
+
+  if (!valid)
+    m_cursorValid = false;
+  updateTextMetrics();
+  markDamage(getDrawLayer(), 0, 0, m_width - 1, m_height - 1);
+
+  return valid;
+}
+
+void RA8875::recordByte(uint8_t x)
+{
+  RA8875_Recorder *rec = m_recorder;
+
+  if (rec->length < rec->size)
+    rec->buffer[rec->length++] = x;
+  else
+    rec->overflow = true;
+}
+
+// Adds a value to the open run of the given op if it carries on from it, or starts a new run.
+//  Register runs need consecutive registers, and count in their op byte.
+void RA8875::recordRun(uint8_t op, int first, uint8_t x)
+{
+  RA8875_Recorder *rec = m_recorder;
+  bool indexed = (op == RA8875_DL_REG) || (op == RA8875_DL_SHADOW);
+  uint8_t *run = rec->buffer + rec->run;
+
+  if (rec->run && !rec->overflow)
+  {
+    if (indexed && ((run[0] & ~RA8875_DL_RUN_MAX) == op))
+    {
+      uint8_t count = run[0] & RA8875_DL_RUN_MAX;
+
+      if ((count < RA8875_DL_RUN_MAX) && (run[1] + count == first))
+      {
+        run[0]++;
+        recordByte(x);
+        return;
+      }
+    }
+    else if (!indexed && (run[0] == op) && (run[1] < 255))
+    {
+      run[1]++;
+      recordByte(x);
+      return;
+    }
+  }
+
+  rec->run = rec->length;
+  if (indexed)
+  {
+    recordByte(op | 1);
+    recordByte(first);
+  }
+  else
+  {
+    recordByte(op);
+    recordByte(1);
+  }
+  recordByte(x);
+}
+
+// A command cycle is held back until it's known whether data follows it.
+void RA8875::recordCmd(uint8_t reg)
+{
+  recordPending();
+  m_recorder->cmd = reg;
+}
+
+void RA8875::recordData(uint8_t x)
+{
+  RA8875_Recorder *rec = m_recorder;
+
+  if (rec->text)
+  {
+    // Replay waits before each character anyway
+    rec->text = false;
+    rec->waitText = false;
+    recordPending();
+    recordRun(RA8875_DL_TEXT, -1, x);
+  }
+  else if (rec->cmd >= 0)
+  {
+    if (rec->shadow >= 0)
+      recordRun(RA8875_DL_SHADOW, rec->shadow, x);
+    else
+      recordRun(RA8875_DL_REG, rec->cmd, x);
+
+    rec->cmd = -1;
+    rec->shadow = -1;
+  }
+  else
+  {
+    recordPending();
+    recordRun(RA8875_DL_DATA, -1, x);
+  }
+}
+
+void RA8875::recordPixels(const uint8_t *bytes, size_t count)
+{
+  RA8875_Recorder *rec = m_recorder;
+
+  recordPending();
+
+  while (count && !rec->overflow)
+  {
+    uint8_t *run = rec->buffer + rec->run;
+    size_t length = rec->run ? (run[1] | (run[2] << 8)) : 0;
+
+    if (!rec->run || (run[0] != RA8875_DL_PIXELS) || (length == 0xFFFF))
+    {
+      rec->run = rec->length;
+      recordByte(RA8875_DL_PIXELS);
+      recordByte(0);
+      recordByte(0);
+      if (rec->overflow)
+        return;
+
+      run = rec->buffer + rec->run;
+      length = 0;
+    }
+
+    size_t n = min(count, 0xFFFF - length);
+    if (rec->length + n > rec->size)
+    {
+      rec->overflow = true;
+      return;
+    }
+
+    memcpy(rec->buffer + rec->length, bytes, n);
+    rec->length += n;
+
+    length += n;
+    run[1] = length & 0xFF;
+    run[2] = length >> 8;
+
+    bytes += n;
+    count -= n;
+  }
+}
+
+void RA8875::recordWait(uint8_t op, int arg)
+{
+  recordPending();
+
+  recordByte(op);
+  if (arg >= 0)
+    recordByte(arg);
+
+  m_recorder->run = 0;
+}
+
+void RA8875::recordCursor(uint8_t op, int x, int y)
+{
+  recordPending();
+
+  recordByte(op);
+  recordByte(x & 0xFF);
+  recordByte(x >> 8);
+  recordByte(y & 0xFF);
+  recordByte(y >> 8);
+
+  m_recorder->run = 0;
+}
+
+// Emits what's been held back: a character wait that no character followed, and a command cycle.
+void RA8875::recordPending(void)
+{
+  RA8875_Recorder *rec = m_recorder;
+
+  if (rec->waitText)
+  {
+    rec->waitText = false;
+    recordByte(RA8875_DL_WAIT_TEXT);
+    rec->run = 0;
+  }
+
+  if (rec->cmd >= 0)
+  {
+    uint8_t reg = rec->cmd;
+    rec->cmd = -1;
+    recordByte(RA8875_DL_CMD);
+    recordByte(reg);
+    rec->run = 0;
+  }
+}
+
+// Switches the bus between the write and read clocks, within the current transaction.
+void RA8875::setBusClock(bool read)
+{
+  RA8875_STATS_ADD(transactions, 1);
+  m_bus.endTransaction();
+  m_bus.beginTransaction(read ? m_readSettings : m_writeSettings);
+  m_readActive = read;
 }
 
-void RA8875::writeReg(uint8_t reg, uint8_t x)
+// Works out the SPI clocks from SYS_CLK and any limits given to setSPIClock(). Until the PLL is
+//  running, both are RA8875_SPI_SPEED.
+void RA8875::updateClocks(void)
 {
-  writeCmd(reg);
-  writeData(x);
+  if (m_pllReady)
+  {
+    m_writeClock = m_sysClock / 3;
+    m_readClock  = m_sysClock / 6;
+  }
+  else
+  {
+    m_writeClock = RA8875_SPI_SPEED;
+    m_readClock  = RA8875_SPI_SPEED;
+  }
+
+  if ((m_writeClockLimit > 0) && (m_writeClockLimit < m_writeClock))
+    m_writeClock = m_writeClockLimit;
+  if ((m_readClockLimit > 0) && (m_readClockLimit < m_readClock))
+    m_readClock = m_readClockLimit;
+
+  m_writeSettings = SPISettings(m_writeClock, MSBFIRST, SPI_MODE3);
+  m_readSettings  = SPISettings(m_readClock, MSBFIRST, SPI_MODE3);
+  m_splitClocks   = (m_writeClock != m_readClock);
+
+  RA8875_TRACE("SPI clocks: write %lu Hz, read %lu Hz", (unsigned long) m_writeClock, (unsigned long) m_readClock);
 }
 
-uint8_t RA8875::readReg(uint8_t reg) 
+// Caps the SPI clocks, e.g. for long wires or boards with poor signal integrity. Zero means the
+//  fastest the chip allows: SYS_CLK / 3 for writes and SYS_CLK / 6 for reads. Neither clock is
+//  ever raised above the chip's limit. Takes effect at the next transaction.
+void RA8875::setSPIClock(uint32_t writeHz, uint32_t readHz)
 {
-  writeCmd(reg);
-  return readData();
+  m_writeClockLimit = writeHz;
+  m_readClockLimit  = readHz;
+
+  updateClocks();
 }
 
-RA8875::RA8875(int csPin, int resetPin)
+// Only defined here, with the library's settings. See RA8875_LAYOUT.
+const uint8_t RA8875_LAYOUT = 0;
+
+RA8875::RA8875(const uint8_t *layout, int csPin, int resetPin, int intPin)
 {
+  (void) layout;
+
   m_csPin    = csPin;
   m_resetPin = resetPin;
-  m_intPin   = -1;
+  m_intPin   = intPin;
 
   m_width  = 0;
   m_height = 0;
   m_depth  = 0;
 
+  m_patternSize = RA8875_PATTERN_8X8;
+  m_font        = NULL;
+  m_glyphCache  = NULL;
+  m_compositor  = NULL;
+  m_console     = NULL;
+  m_recorder    = NULL;
+
+  m_frontLayer = 0;
+  m_vsyncMode  = RA8875_VSYNC_NONE;
+  m_vsyncPin   = -1;
+  m_frameStart = 0;
+
   m_tracePrint = NULL;
+
+  m_sysClock        = RA8875_CRYSTAL_FREQ;
+  m_pllReady        = false;
+  m_writeClockLimit = 0;
+  m_readClockLimit  = 0;
+  m_readActive      = false;
+  updateClocks();
+
+  m_pipelined   = false;
+  m_pendingWait = RA8875_WAIT_NONE;
+
+  m_cursorValid    = false;
+  m_cmdReg         = -1;
+  m_textCellWidth  = RA8875_ROM_TEXT_WIDTH;
+  m_textCellHeight = RA8875_ROM_TEXT_HEIGHT;
+  m_textFixed      = true;
+  m_textPending    = false;
+
+#if RA8875_ENABLE_STATS
+  m_statOp = RA8875_OP_OTHER;
+  resetStats();
+#endif
+
+  memset(m_shadow, 0, sizeof(m_shadow));
 }
 
 // Pulse the reset pin low
@@ -78,7 +788,7 @@ void RA8875::softReset(void)
 {
   RA8875_TRACE("softReset");
 
-  SPI.beginTransaction(m_spiSettings);
+  beginTransaction();
 
   delay(50);
   uint8_t pwrr = readReg(RA8875_REG_PWRR);
@@ -93,32 +803,48 @@ void RA8875::softReset(void)
   writeReg(RA8875_REG_PWRR, pwrr);
   delay(50);
 
-  SPI.endTransaction();
+  endTransaction();
 
 }
 
 // Set up PLL
-// 320x240: 20MHz crystal * (10 + 1) / (2 ^ 2) = 55MHz system clock (SYS_CLK)
-// 480x272: 20MHz crystal * (10 + 1) / (2 ^ 2) = 55MHz system clock (SYS_CLK)
-// 640x480: 20MHz crystal * (11 + 1) / (2 ^ 2) = 60MHz system clock (SYS_CLK)
-// 800x480: 20MHz crystal * (11 + 1) / (2 ^ 2) = 60MHz system clock (SYS_CLK)
+// SYS_CLK = crystal * (PLLC1 + 1) / (2 ^ PLLC2). We pick the highest SYS_CLK that doesn't go over
+//  the panel's wanted clock or the chip's limit, keeping the VCO in range. With a 20MHz crystal,
+//  55MHz is 20MHz * (10 + 1) / (2 ^ 2), and 60MHz is 20MHz * (11 + 1) / (2 ^ 2).
 bool RA8875::initPLL(void)
 {
   RA8875_TRACE("initPLL");
 
-  int pllc1;
-  int pllc2 = 0x02;  // Divide by (2 ^ 2) = 4
+  uint32_t target = min(m_panel.sysClock, (uint32_t) RA8875_SYS_CLK_MAX);
+  uint32_t best = 0;
+  uint8_t pllc1 = 0, pllc2 = 0;
 
-  if ((m_height == 240) || (m_height == 272))
-    pllc1 = 0x0A;  // PLL input parameter
-  else if (m_height == 480)
-    pllc1 = 0x0B;  // PLL input parameter
-  else
-    return false;  // Don't know how to configure PLL for this size
+  for (uint8_t k = 0; k <= 7; k++)
+  {
+    for (uint8_t n = 0; n <= 31; n++)
+    {
+      uint32_t vco = m_panel.crystal * (n + 1);
+      if ((vco < RA8875_PLL_VCO_MIN) || (vco > RA8875_PLL_VCO_MAX))
+        continue;
+
+      uint32_t sysClock = vco >> k;
+      if ((sysClock <= target) && (sysClock > best))
+      {
+        best  = sysClock;
+        pllc1 = n;
+        pllc2 = k;
+      }
+    }
+  }
+
+  if (best == 0)
+    return false;  // Can't get there from this crystal
 
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_TRACE("PLLC1 0x%02X, PLLC2 0x%02X, SYS_CLK %lu Hz", pllc1, pllc2, (unsigned long) best);
 
-  writeReg(RA8875_REG_PLLC1, pllc1);
+  beginTransaction();
+
+  writeReg(RA8875_REG_PLLC1, pllc1);  // PLL input parameter
 
   delay(2);
 
@@ -126,7 +852,10 @@ bool RA8875::initPLL(void)
 
   delay(2);
 
-  SPI.endTransaction();
+  endTransaction();
+
+  m_sysClock = best;
+  m_pllReady = true;
 
   return true;
 }
@@ -136,49 +865,26 @@ bool RA8875::initDisplay(void)
 {
   RA8875_TRACE("initDisplay");
 
-  uint8_t pcsr, hndftr, hndr, hstr, hpwr, vpwr;
-  uint16_t vndr, vstr;
-
-  if ((m_width == 480) && (m_height == 272))
-  {
-    pcsr   = 0x82;  // PDAT fetched on falling edge, PCLK is SYS_CLK / 4
-
-    hndftr = 0x00;  // DE polarity high, 0 pixels of tuning
-    hndr   = 0x01;  // (0x01 + 1) * 8 = 16px
-    hstr   = 0x00;  // (0x00 + 1) * 8 = 8px
-    hpwr   = 0x05;  // HSYNC active low, pulse width (0x05 + 1) * 8 = 48px
-
-    vndr   = 0x02;  // Vertical non-display period. 0x02 = 3 lines
-    vstr   = 0x07;  // Vertical start position
-    vpwr   = 0x09;  // VSYNC pulse width active low, width (0x09 + 1) = 10 lines
-  }
-  else if ((m_width == 800) && (m_height == 480))
-  {
-    pcsr   = 0x81;  // PDAT fetched on falling edge, PCLK is SYS_CLK / 2
-
-    hndftr = 0x00;  // DE polarity high, 0 pixels of tuning
-    hndr   = 0x03;  // (0x03 + 1) * 8 = 32px
-    hstr   = 0x03;  // (0x03 + 1) * 8 = 32px
-    hpwr   = 0x0B;  // HSYNC active low, pulse width (0x0B + 1) * 8 = 96px
-
-    vndr   = 0x20;  // Vertical non-display period. 0x20 = 33 lines
-    vstr   = 0x16;  // Vertical start position
-    vpwr   = 0x01;  // VSYNC pulse width active low, width (0x01 + 1) = 2 lines
-  }
-  else
-    return false;
+  uint8_t pcsr   = m_panel.pcsr;
+  uint8_t hndftr = 0x00;                         // DE polarity high, no fine tuning
+  uint8_t hndr   = m_panel.hNonDisplay / 8 - 1;  // (HNDR + 1) * 8 px
+  uint8_t hstr   = m_panel.hSyncStart / 8 - 1;   // (HSTR + 1) * 8 px
+  uint8_t hpwr   = m_panel.hSyncWidth / 8 - 1;   // HSYNC active low, (HPWR + 1) * 8 px
+  uint16_t vndr  = m_panel.vNonDisplay - 1;      // VNDR + 1 lines
+  uint16_t vstr  = m_panel.vSyncStart - 1;       // VSTR + 1 lines
+  uint8_t vpwr   = m_panel.vSyncWidth - 1;       // VSYNC active low, VPWR + 1 lines
 
-  SPI.beginTransaction(m_spiSettings);
+  beginTransaction();
 
   // Set colour depth
   writeReg(RA8875_REG_SYSR, (m_depth == 16) ? 0x08 : 0x00);
-  writeReg(RA8875_REG_PCSR, pcsr);  // 0x80 = PDAT fetched at PCLK falling edge, 0x02 = PCLK period is 4 times system clock period
+  writeReg(RA8875_REG_PCSR, pcsr);  // e.g. 0x80 = PDAT fetched at PCLK falling edge, 0x02 = PCLK period is 4 times system clock period
 
   delay(5);
 
   // --- Horizontal regs ---
   // Horizontal width: (HDWR + 1) * 8
-  writeReg(RA8875_REG_HDWR, (m_width / 8) - 1);  // Horizontal width is (HDWR + 1) * 8 = 480px. Max width is 0x63 = 800px.
+  writeReg(RA8875_REG_HDWR, (m_width / 8) - 1);  // Horizontal width is (HDWR + 1) * 8 px. Max width is 0x63 = 800px.
   // Horizontal non-display period. Total non-display period in pixels is (HNDR + 1) * 8 + (HNDFTR / 2 + 1) + 2
   writeReg(RA8875_REG_HNDFTR, hndftr);  // Horiz non-display fine tuning
   writeReg(RA8875_REG_HNDR, hndr);  // Horiz non-display period is (HNDR + 1) * 8
@@ -196,9 +902,9 @@ bool RA8875::initDisplay(void)
   // VSYNC. Start position in pixel lines is: ((VSTR1 << 8) | VSTR0) + 1
   writeReg(RA8875_REG_VSTR0, vstr & 0xFF);
   writeReg(RA8875_REG_VSTR1, vstr >> 8);
-  writeReg(RA8875_REG_VPWR, vpwr);  // VSYNC pulse width active low, width (0x09 + 1) = 10 lines
+  writeReg(RA8875_REG_VPWR, vpwr);  // VSYNC pulse width active low, width (VPWR + 1) lines
 
-  SPI.endTransaction();
+  endTransaction();
 
   delay(5);
 
@@ -207,26 +913,56 @@ bool RA8875::initDisplay(void)
 
 bool RA8875::init(int width, int height, int depth)
 {
+  // Look up the panel
+  for (size_t i = 0; i < sizeof(s_panels) / sizeof(s_panels[0]); i++)
+  {
+    RA8875_Panel panel;
+    memcpy_P(&panel, &s_panels[i], sizeof(panel));
+
+    if ((panel.width == width) && (panel.height == height))
+      return init(panel, depth);
+  }
+
+  return false;
+}
+
+// Initialises the chip for any panel, given its description.
+bool RA8875::init(const RA8875_Panel &panel, int depth)
+{
+  RA8875_STATS_OP(RA8875_OP_INIT);
+
   RA8875_TRACE("init() started");
 
-  // Check resolution
-  if (!((width == 480) && (height == 272)) &&
-      !((width == 800) && (height == 480)))
+  // Check resolution. Width is set in units of 8 pixels.
+  if ((panel.width < 8) || (panel.width > 800) || (panel.width % 8) ||
+      (panel.height < 1) || (panel.height > 480))
+    return false;
+
+  // Check timings can be represented
+  if ((panel.hNonDisplay < 8) || (panel.hSyncStart < 8) || (panel.hSyncWidth < 8) ||
+      (panel.vNonDisplay < 1) || (panel.vSyncStart < 1) || (panel.vSyncWidth < 1))
     return false;
 
   // Check colour depth
   if ((depth != 8) && (depth != 16))
     return false;
 
-  m_width  = width;
-  m_height = height;
+  m_panel = panel;
+
+  m_width  = panel.width;
+  m_height = panel.height;
   m_depth  = depth;
 
   m_textColor = RGB565(255, 255, 255);
 
-  // Set up CS pin
-  pinMode(m_csPin, OUTPUT);
-  digitalWrite(m_csPin, HIGH);
+  m_cursorValid = false;
+  m_cmdReg      = -1;
+  m_textPending = false;
+  m_console     = NULL;
+  m_recorder    = NULL;
+
+  // Set up CS pin and SPI
+  m_bus.begin(m_csPin);
 
   // If we have an int pin, set it up
   if (m_intPin >= 0)
@@ -241,35 +977,55 @@ bool RA8875::init(int width, int height, int depth)
     hardReset();
   }
 
-  SPI.begin();
-
-  m_spiSettings = SPISettings(RA8875_SPI_SPEED, MSBFIRST, SPI_MODE3);
+  // Start slow, since SYS_CLK is only the crystal until the PLL is set up
+  m_sysClock = m_panel.crystal;
+  m_pllReady = false;
+  updateClocks();
 
   // If no reset pin is hooked up, try software reset command
   if (m_resetPin < 0)
     softReset();
 
+  // Registers are at their reset defaults now
+  resyncRegisters();
+
   if (!initPLL())
     return false;
 
+  // SYS_CLK is up to speed now
+  updateClocks();
+
   if (!initDisplay())
     return false;
 
-  SPI.beginTransaction(m_spiSettings);
+  beginTransaction();
 
   // --- Enable layers ---
-  writeReg(RA8875_REG_DPCR, 0x80);
+  writeShadowReg(RA8875_SHADOW_DPCR, 0x80);
+
+  // --- Interrupts ---
+  // The INT pin is asserted (low) when a BTE operation completes. The draw engine has no
+  //  interrupt source, so lines, rects, triangles and circles are still polled.
+  if (m_intPin >= 0)
+  {
+    writeReg(RA8875_REG_INTC2, RA8875_INT_BTE);  // Clear anything stale
+    writeReg(RA8875_REG_INTC1, RA8875_INT_BTE);
+  }
 
-  SPI.endTransaction();
+  endTransaction();
 
   setActiveWindow(0, m_width - 1, 0, m_height - 1);
 
   selectInternalFont(RA8875_FONT_ENCODING_8859_1);
 
   // Turn display on
-  SPI.beginTransaction(m_spiSettings);
-  writeReg(RA8875_REG_PWRR, 0x80);  // Display on, normal mode, no reset
-  SPI.endTransaction();
+  beginTransaction();
+  writeShadowReg(RA8875_SHADOW_PWRR, 0x80);  // Display on, normal mode, no reset
+  endTransaction();
+
+  // Scanning starts from the top of a frame
+  m_frameStart = micros();
+  m_frontLayer = 0;
 
   RA8875_TRACE("init() completed");
   return true;
@@ -277,7 +1033,9 @@ bool RA8875::init(int width, int height, int depth)
 
 void RA8875::initExternalFontRom(int spiIf, enum RA8875_External_Font_Rom chip)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
+
+  beginTransaction();
 
   // TODO: Calculate the clock from the system clock. Could probably go faster.
   //  Need to rewrite initPLL() first.
@@ -291,16 +1049,18 @@ void RA8875::initExternalFontRom(int spiIf, enum RA8875_External_Font_Rom chip)
   writeReg(RA8875_REG_SACS_MODE, 0x00);
 
   // Select font chip
-  uint8_t sfrs = readReg(RA8875_REG_SFRS);
+  uint8_t sfrs = readShadowReg(RA8875_SHADOW_SFRS);
   sfrs = (sfrs & 0x1F) | ((chip & 0x07) << 5);
-  writeReg(RA8875_REG_SFRS, sfrs);
+  writeShadowReg(RA8875_SHADOW_SFRS, sfrs);
 
-  SPI.endTransaction();
+  endTransaction();
 }
 
 void RA8875::setBacklight(bool enabled)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
+
+  beginTransaction();
 
   // Adafruit module uses GPIOX register to enable display
   writeCmd(RA8875_REG_GPIOX);
@@ -312,49 +1072,51 @@ void RA8875::setBacklight(bool enabled)
   writeCmd(RA8875_REG_P1DCR);
   writeData(0xFF);  // Duty cycle (brightness)
   
-  SPI.endTransaction();
+  endTransaction();
 }
 
 void RA8875::setActiveWindow(int xStart, int xEnd, int yStart, int yEnd)
 {
-  SPI.beginTransaction(m_spiSettings);
-
-  // Active window X start
-  writeCmd(RA8875_REG_HSAW0);
-  writeData(xStart & 0xFF);
-  writeCmd(RA8875_REG_HSAW1);
-  writeData(xStart >> 8);
-
-  // Active window X end
-  writeCmd(RA8875_REG_HEAW0);
-  writeData(xEnd & 0xFF);
-  writeCmd(RA8875_REG_HEAW1);
-  writeData(xEnd >> 8);
-
-  // Active window Y start
-  writeCmd(RA8875_REG_VSAW0);
-  writeData(yStart & 0xFF);
-  writeCmd(RA8875_REG_VSAW1);
-  writeData(yStart >> 8);  
-
-  // Active window Y end
-  writeCmd(RA8875_REG_VEAW0);
-  writeData(yEnd & 0xFF);
-  writeCmd(RA8875_REG_VEAW1);
-  writeData(yEnd >> 8);
-  
-  SPI.endTransaction();
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
+
+  beginTransaction();
+
+  writeShadowReg16(RA8875_SHADOW_HSAW0, xStart);  // Active window X start
+  writeShadowReg16(RA8875_SHADOW_HEAW0, xEnd);    // Active window X end
+  writeShadowReg16(RA8875_SHADOW_VSAW0, yStart);  // Active window Y start
+  writeShadowReg16(RA8875_SHADOW_VEAW0, yEnd);    // Active window Y end
+
+  endTransaction();
 }
 
 // Clears the frame buffer memory.
 // This seems to only affect the current layer. You can call setDrawLayer() first to select which layer will be cleared.
 void RA8875::clearMemory(void)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_CLEAR);
+
+  beginTransaction();
 
   writeReg(RA8875_REG_MCLR, 0x80);  // Start memory clear
 
-  // Wait for completion
+  // That takes any cached glyphs on this layer with it
+  if (m_glyphCache && (m_glyphCache->layer == getDrawLayer()))
+    m_glyphCache->filled = 0;
+
+  markDamage(getDrawLayer(), 0, 0, m_width - 1, m_height - 1);
+
+  waitClear();
+
+  endTransaction();
+}
+
+// Polls until a memory clear has completed.
+void RA8875::waitClear(void)
+{
+  if (m_recorder)
+    recordWait(RA8875_DL_WAIT_CLEAR, -1);
+
+  RA8875_STATS_WAIT_BEGIN();
   uint32_t starttime = millis();
   uint8_t status;
   do
@@ -362,63 +1124,213 @@ void RA8875::clearMemory(void)
     status = readReg(RA8875_REG_MCLR);
     RA8875_TRACE("MCLR: %02X", status);
   } while ((status & 0x80) && ((millis() - starttime) < 250));
-
-  SPI.endTransaction();
+  RA8875_STATS_WAIT_END();
 }
 
+// Starts or continues a text session: text mode on, with the text colour loaded, on the black
+//  background the chip starts with.
 void RA8875::setTextMode(void)
 {
-  waitBusy();
-
-  // Restore text colour
-  writeReg(RA8875_REG_FGCR0, m_textColor >> 11);            // R
-  writeReg(RA8875_REG_FGCR1, (m_textColor & 0x07E0) >> 5);  // G
-  writeReg(RA8875_REG_FGCR2, m_textColor & 0x1F);           // B
+  // Colour changes must wait for the last character, or they'd apply to it
+  if (m_recorder ||
+      (readShadowReg(RA8875_SHADOW_FGCR0) != (m_textColor >> 11)) ||
+      (readShadowReg(RA8875_SHADOW_FGCR1) != ((m_textColor & 0x07E0) >> 5)) ||
+      (readShadowReg(RA8875_SHADOW_FGCR2) != (m_textColor & 0x1F)) ||
+      readShadowReg(RA8875_SHADOW_BGCR0) || readShadowReg(RA8875_SHADOW_BGCR1) || readShadowReg(RA8875_SHADOW_BGCR2))
+  {
+    waitText();
+    setForegroundColor(m_textColor);
+    setBackgroundPixel(0);
+  }
 
-  uint8_t mwcr0 = readReg(RA8875_REG_MWCR0);
-  writeReg(RA8875_REG_MWCR0, mwcr0 | 0x80);  // Enable text mode
+  if (!(readShadowReg(RA8875_SHADOW_MWCR0) & 0x80))
+  {
+    waitBusy();
+    writeShadowReg(RA8875_SHADOW_MWCR0, readShadowReg(RA8875_SHADOW_MWCR0) | 0x80);  // Enable text mode
+  }
 }
 
+// Ends a text session. Called by beginTransaction() for anything that isn't text.
 void RA8875::setGraphicsMode(void)
 {
-  waitBusy();
+  waitText();
 
   // Set graphics mode
-  uint8_t mwcr0 = readReg(RA8875_REG_MWCR0);
-  writeReg(RA8875_REG_MWCR0, mwcr0 & ~0x80);  // Enable graphics mode
+  writeShadowReg(RA8875_SHADOW_MWCR0, readShadowReg(RA8875_SHADOW_MWCR0) & ~0x80);  // Enable graphics mode
+}
+
+// Works out the character cell for the selected font and scale.
+void RA8875::updateTextMetrics(void)
+{
+  int width = RA8875_ROM_TEXT_WIDTH, height = RA8875_ROM_TEXT_HEIGHT;
+  m_textFixed = true;
+
+  // External ROM fonts are 16, 24 or 32 pixels high, half as wide. Arial and Times are
+  //  proportional, so the cursor can't be followed through them.
+  if (readShadowReg(RA8875_SHADOW_FNCR0) & 0x20)
+  {
+    height = 16 + 8 * ((readShadowReg(RA8875_SHADOW_FWTSR) >> 6) & 0x03);
+    width = height / 2;
+
+    uint8_t family = readShadowReg(RA8875_SHADOW_SFRS) & 0x03;
+    m_textFixed = (family == RA8875_FONT_FAMILY_FIXED) || (family == RA8875_FONT_FAMILY_FIXED_BOLD);
+  }
+
+  m_textCellWidth  = width * getTextSizeX();
+  m_textCellHeight = height * getTextSizeY();
+}
+
+// Waits until the last character written has been drawn. The datasheet gives no drawing time for
+//  a character, nor any other sign that the chip can take the next one, so this polls the busy
+//  flag whenever a character has been written since the last wait.
+void RA8875::waitText(void)
+{
+  if (!m_textPending)
+    return;
+
+  // Recorded as a single op, which replay times the same way
+  RA8875_Recorder *rec = m_recorder;
+  if (rec)
+    rec->waitText = true;
+  m_recorder = NULL;
+
+  waitBusy();
+
+  m_textPending = false;
+  m_recorder = rec;
+}
+
+// Writes one character at the text cursor. Must be in a text session.
+void RA8875::putText(uint8_t c)
+{
+  // The chip wraps at the active window's right edge before drawing a character that won't fit
+  if (m_cursorValid && (m_cursorX + m_textCellWidth - 1 > readShadowReg16(RA8875_SHADOW_HEAW0)))
+  {
+    m_cursorX = readShadowReg16(RA8875_SHADOW_HSAW0);
+    m_cursorY += m_textCellHeight;
+  }
+
+  if (m_cmdReg != RA8875_REG_MRWC)
+    writeCmd(RA8875_REG_MRWC);
+
+  waitText();
+  if (m_recorder)
+    m_recorder->text = true;
+  writeData(c);
+
+  m_textPending = true;
+
+  if (m_cursorValid)
+  {
+    markDamage(getDrawLayer(), m_cursorX, m_cursorY, m_cursorX + m_textCellWidth - 1, m_cursorY + m_textCellHeight - 1);
+
+    m_cursorX += m_textCellWidth;
+    m_cursorValid = m_textFixed;
+  }
+  else
+    markWindowDamage(-1);
+}
+
+// Moves the text cursor to the start of the next line, within the active window.
+void RA8875::newLine(void)
+{
+  if (!m_cursorValid)
+    readTextCursor();
+
+  moveTextCursor(readShadowReg16(RA8875_SHADOW_HSAW0), m_cursorY + m_textCellHeight);
+}
+
+// Sets the cursor registers, skipping any byte the chip already holds.
+void RA8875::moveTextCursor(int x, int y)
+{
+  // The last character must be drawn before the cursor moves under it
+  waitText();
+
+  bool known = m_cursorValid;
+
+  // A display list can't know where the cursor will be when it's played, so it gets the whole
+  //  position, and replay works out which bytes to send then
+  RA8875_Recorder *rec = m_recorder;
+  if (rec && !known)
+  {
+    if (m_pendingWait != RA8875_WAIT_NONE)
+      syncEngine();
+    recordCursor(RA8875_DL_CURSOR, x, y);
+    m_recorder = NULL;
+  }
+
+  if (!known || ((x ^ m_cursorX) & 0xFF))
+    writeReg(RA8875_REG_FCURX0, x & 0xFF);
+  if (!known || ((x ^ m_cursorX) >> 8))
+    writeReg(RA8875_REG_FCURX1, x >> 8);
+  if (!known || ((y ^ m_cursorY) & 0xFF))
+    writeReg(RA8875_REG_FCURY0, y & 0xFF);
+  if (!known || ((y ^ m_cursorY) >> 8))
+    writeReg(RA8875_REG_FCURY1, y >> 8);
+
+  m_cursorX = x;
+  m_cursorY = y;
+  m_cursorValid = true;
+
+  m_recorder = rec;
+}
+
+// Reads the cursor back from the chip, after a proportional font or double-byte text.
+void RA8875::readTextCursor(void)
+{
+  waitText();
+
+  m_cursorX = (readReg(RA8875_REG_FCURX1) << 8) | readReg(RA8875_REG_FCURX0);
+  m_cursorY = (readReg(RA8875_REG_FCURY1) << 8) | readReg(RA8875_REG_FCURY0);
+  m_cursorValid = true;
 }
 
 void RA8875::setCursor(int x, int y)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_TEXT);
 
-  // Cursor X position
-  writeReg(RA8875_REG_FCURX0, x & 0xFF);
-  writeReg(RA8875_REG_FCURX1, x >> 8);
+  beginTextTransaction();
 
-  // Cursor Y position
-  writeReg(RA8875_REG_FCURY0, y & 0xFF);
-  writeReg(RA8875_REG_FCURY1, y >> 8);
+  moveTextCursor(x, y);
   
-  SPI.endTransaction();
+  endTransaction();
 }
 
 int RA8875::getCursorX(void)
 {
-  return (readReg(RA8875_REG_FCURX1) << 8) | readReg(RA8875_REG_FCURX0);
+  RA8875_STATS_OP(RA8875_OP_TEXT);
+
+  if (!m_cursorValid)
+  {
+    beginTextTransaction();
+    readTextCursor();
+    endTransaction();
+  }
+
+  return m_cursorX;
 }
 
 int RA8875::getCursorY(void)
 {
-  return (readReg(RA8875_REG_FCURY1) << 8) | readReg(RA8875_REG_FCURY0);
+  RA8875_STATS_OP(RA8875_OP_TEXT);
+
+  if (!m_cursorValid)
+  {
+    beginTextTransaction();
+    readTextCursor();
+    endTransaction();
+  }
+
+  return m_cursorY;
 }
 
 void RA8875::setCursorVisibility(bool visible, bool blink)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
+
+  beginTransaction();
 
-  writeCmd(RA8875_REG_MWCR0);
-  uint8_t mwcr0 = readData();
+  uint8_t mwcr0 = readShadowReg(RA8875_SHADOW_MWCR0);
 
   if (visible)
     mwcr0 |= 0x40;
@@ -430,56 +1342,65 @@ void RA8875::setCursorVisibility(bool visible, bool blink)
   else
     mwcr0 &= ~0x20;
   
-  writeData(mwcr0);
+  writeShadowReg(RA8875_SHADOW_MWCR0, mwcr0);
   
-  SPI.endTransaction();
+  endTransaction();
 }
 
 void RA8875::selectInternalFont(enum RA8875_Font_Encoding enc)
 {
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
+
   // Invalid encodings become Latin 1
   if (!(enc & 0x10) || (enc & 0xEC))
     enc = RA8875_FONT_ENCODING_8859_1;
 
-  SPI.beginTransaction(m_spiSettings);
+  beginTransaction();
 
   // Select ROM font, internal ROM, charset
   uint8_t fncr0 = 0x00 | (enc & 0x03);
-  writeReg(RA8875_REG_FNCR0, fncr0);
+  writeShadowReg(RA8875_SHADOW_FNCR0, fncr0);
 
   // Datasheet says this register must be zero.
   // Is that true? Just clear the low two bits for now.
-  uint8_t sfrs = readReg(RA8875_REG_SFRS);
-  writeReg(RA8875_REG_SFRS, sfrs & 0xFC);
+  writeShadowReg(RA8875_SHADOW_SFRS, readShadowReg(RA8875_SHADOW_SFRS) & 0xFC);
+
+  updateTextMetrics();
 
-  SPI.endTransaction();
+  endTransaction();
 }
 
 void RA8875::selectExternalFont(enum RA8875_External_Font_Family family, enum RA8875_Font_Size size, enum RA8875_Font_Encoding enc, RA8875_Font_Flags flags)
 {
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
+
   // Invalid encodings become ASCII
   if (enc & 0xF8)
     enc = RA8875_FONT_ENCODING_ASCII;
 
-  SPI.beginTransaction(m_spiSettings);
+  beginTransaction();
 
   // Select ROM font, external ROM,
-  writeReg(RA8875_REG_FNCR0, 0x20);
+  writeShadowReg(RA8875_SHADOW_FNCR0, 0x20);
 
   // Select font size
-  writeReg(RA8875_REG_FWTSR, (size & 0x03) << 6);
+  writeShadowReg(RA8875_SHADOW_FWTSR, (size & 0x03) << 6);
 
-  uint8_t sfrs = readReg(RA8875_REG_SFRS);
+  uint8_t sfrs = readShadowReg(RA8875_SHADOW_SFRS);
   sfrs = (sfrs & 0xE0) | (enc << 2) | (family & 0x03);
-  writeReg(RA8875_REG_SFRS, sfrs);
+  writeShadowReg(RA8875_SHADOW_SFRS, sfrs);
   //Serial.print("sfrs: "); Serial.println(sfrs, HEX);
 
-  SPI.endTransaction();
+  updateTextMetrics();
+
+  endTransaction();
 }
 
 void RA8875::setTextSize(int xScale, int yScale)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
+
+  beginTransaction();
 
 // This register does not seem to apply to the built-in ROM font
 //  uint8_t fwtsr = readReg(RA8875_REG_FWTSR);
@@ -496,70 +1417,72 @@ void RA8875::setTextSize(int xScale, int yScale)
   xScale = constrain(xScale, 1, 4);
   yScale = constrain(yScale, 1, 4);
 
-  uint8_t fncr1 = readReg(RA8875_REG_FNCR1);
+  uint8_t fncr1 = readShadowReg(RA8875_SHADOW_FNCR1);
 
   fncr1 = (fncr1 & 0xF0) | ((xScale - 1) << 2) | (yScale - 1);
 
-  writeData(fncr1);
+  writeShadowReg(RA8875_SHADOW_FNCR1, fncr1);
+
+  updateTextMetrics();
 
-  SPI.endTransaction();
+  endTransaction();
 }
 
 int RA8875::getTextSizeX(void)
 {
-  // TODO: Cache?
-  SPI.beginTransaction(m_spiSettings);
-
-  uint8_t fncr1 = readReg(RA8875_REG_FNCR1);
-
-  SPI.endTransaction();
-
-  return ((fncr1 >> 2) & 0x03) + 1;
+  return ((readShadowReg(RA8875_SHADOW_FNCR1) >> 2) & 0x03) + 1;
 }
 
 int RA8875::getTextSizeY(void)
 {
-  // TODO: Cache?
-  SPI.beginTransaction(m_spiSettings);
-
-  uint8_t fncr1 = readReg(RA8875_REG_FNCR1);
-
-  SPI.endTransaction();
-
-  return (fncr1 & 0x03) + 1;
+  return (readShadowReg(RA8875_SHADOW_FNCR1) & 0x03) + 1;
 }
 
 // Write a single byte (called from class Print).
 size_t RA8875::write(uint8_t c)
 {
+  RA8875_STATS_OP(RA8875_OP_TEXT);
+
   if (c == '\r')
     return 1;  // Ignored
-  else if (c == '\n')
-    setCursor(0, getCursorY() + (RA8875_ROM_TEXT_HEIGHT * getTextSizeY()));
-  else
-  {
-    SPI.beginTransaction(m_spiSettings);
-
-    setTextMode();
 
-    writeReg(RA8875_REG_MRWC, c);
+  if (m_console)
+  {
+    consoleWrite(c);
+    return 1;
+  }
 
-    setGraphicsMode();
+  beginTextTransaction();
 
-    SPI.endTransaction();
+  if (c == '\n')
+    newLine();
+  else
+  {
+    setTextMode();
+    putText(c);
   }
 
+  endTransaction();
+
   return 1;
 }
 
 // Write a string to the display (called from class Print).
 size_t RA8875::write(const char *s)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_TEXT);
 
-  setTextMode();
+  if (m_console)
+  {
+    size_t count = 0;
+    for (; s[count]; count++)
+      consoleWrite(s[count]);
+    return count;
+  }
 
-  writeCmd(RA8875_REG_MRWC);
+  beginTextTransaction();
+
+  setTextMode();
 
   size_t count = 0;
 
@@ -570,17 +1493,12 @@ size_t RA8875::write(const char *s)
     if (c == '\r')
       ;  // Ignored
     else if (c == '\n')
-      setCursor(0, getCursorY() + (RA8875_ROM_TEXT_HEIGHT * getTextSizeY()));
+      newLine();
     else
-    {
-      waitBusy();
-      writeData(c);
-    }
+      putText(c);
   }
 
-  setGraphicsMode();
-
-  SPI.endTransaction();
+  endTransaction();
 
   return count;
 }
@@ -588,11 +1506,18 @@ size_t RA8875::write(const char *s)
 // Write a number of bytes to the display (called from class Print).
 size_t RA8875::write(const uint8_t *bytes, size_t size)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_TEXT);
 
-  setTextMode();
+  if (m_console)
+  {
+    for (size_t i = 0; i < size; i++)
+      consoleWrite(bytes[i]);
+    return size;
+  }
 
-  writeCmd(RA8875_REG_MRWC);
+  beginTextTransaction();
+
+  setTextMode();
 
   for (unsigned int i = 0; i < size; i++)
   {
@@ -601,457 +1526,2533 @@ size_t RA8875::write(const uint8_t *bytes, size_t size)
     if (c == '\r')
       ;  // Ignored
     else if (c == '\n')
-      setCursor(0, getCursorY() + (RA8875_ROM_TEXT_HEIGHT * getTextSizeY()));
+      newLine();
     else
-    {
-      waitBusy();
-      writeData(c);
-    }
+      putText(c);
   }
 
-  setGraphicsMode();
-
-  SPI.endTransaction();
+  endTransaction();
 
   return size;
 }
 
 void RA8875::putChars(const char *buffer, size_t size)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_TEXT);
+
+  beginTextTransaction();
 
   setTextMode();
 
   // Write characters
-  writeCmd(RA8875_REG_MRWC);
   for (unsigned int i = 0; i < size; i++)
-  {
-    waitBusy();
-    writeData(buffer[i]);
-  }
+    putText(buffer[i]);
 
-  setGraphicsMode();
-
-  SPI.endTransaction();
+  endTransaction();
 }
 
 void RA8875::putChars16(const uint16_t *buffer, unsigned int count)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_TEXT);
+
+  beginTextTransaction();
 
   setTextMode();
+  markWindowDamage(-1);
+
+  // Full-width characters don't follow the cell size, so the cursor is read back next time it's needed
+  m_cursorValid = false;
 
   // Write characters
-  writeCmd(RA8875_REG_MRWC);
+  if (m_cmdReg != RA8875_REG_MRWC)
+    writeCmd(RA8875_REG_MRWC);
   for (unsigned int i = 0; i < count; i++)
   {
-    waitBusy();
+    waitText();
     writeData(buffer[i] >> 8);
-
-    waitBusy();
     writeData(buffer[i] & 0xFF);
-  }
 
-  setGraphicsMode();
+    m_textPending = true;
+  }
 
-  SPI.endTransaction();
+  endTransaction();
 }
 
 void RA8875::setScrollWindow(int xStart, int xEnd, int yStart, int yEnd)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
 
-  // X start
-  writeReg(RA8875_REG_HSSW0, xStart & 0xFF);
-  writeReg(RA8875_REG_HSSW1, xStart >> 8);
+  beginTransaction();
 
-  // X end
-  writeReg(RA8875_REG_HESW0, xEnd & 0xFF);
-  writeReg(RA8875_REG_HESW1, xEnd >> 8);
-  
-  // Y start
-  writeReg(RA8875_REG_VSSW0, yStart & 0xFF);
-  writeReg(RA8875_REG_VSSW1, yStart >> 8);
+  writeShadowReg16(RA8875_SHADOW_HSSW0, xStart);  // X start
+  writeShadowReg16(RA8875_SHADOW_HESW0, xEnd);    // X end
+  writeShadowReg16(RA8875_SHADOW_VSSW0, yStart);  // Y start
+  writeShadowReg16(RA8875_SHADOW_VESW0, yEnd);    // Y end
 
-  // Y end
-  writeReg(RA8875_REG_VESW0, yEnd & 0xFF);
-  writeReg(RA8875_REG_VESW1, yEnd >> 8);
-  
-  SPI.endTransaction();
+  endTransaction();
 }
 
 void RA8875::setScrollOffset(int x, int y)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
 
-  // X offset
-  writeReg(RA8875_REG_HOFS0, x & 0xFF);
-  writeReg(RA8875_REG_HOFS1, x >> 8);
+  beginTransaction();
 
-  // Y offset
-  writeReg(RA8875_REG_VOFS0, y & 0xFF);
-  writeReg(RA8875_REG_VOFS1, y >> 8);
+  writeShadowReg16(RA8875_SHADOW_HOFS0, x);  // X offset
+  writeShadowReg16(RA8875_SHADOW_VOFS0, y);  // Y offset
 
-  SPI.endTransaction();
+  endTransaction();
 }
 
-void RA8875::setLayerMode(enum RA8875_Layer_Mode mode)
+// Sends Print output to a text console in the given window, which becomes the scroll window. Rows
+//  are as high as the current font: the proportional font if one is set with setFont(), otherwise
+//  the ROM font at its current size, which must be a fixed width one. Set the font, text size and
+//  colour first. The window should lie within the active window, and be on the layer shown; it's
+//  cleared to the background colour. Returns false if not even one row fits. console must stay
+//  allocated until endConsole().
+bool RA8875::setConsole(RA8875_Console *console, int x1, int y1, int x2, int y2, uint16_t background)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_TEXT);
 
-  uint8_t ltpr0 = readReg(RA8875_REG_LTPR0);
+  int rowHeight = m_textCellHeight, ascent = 0;
 
-  //Serial.print("mode: "); Serial.println(mode);
-  ltpr0 = (ltpr0 & 0xF8) | mode;
-  writeReg(RA8875_REG_LTPR0, ltpr0);
-  //Serial.print("LTPR0: "); Serial.println(ltpr0, HEX);
+  // The baseline goes as low as the tallest glyph needs
+  if (m_font)
+  {
+    RA8875_Font font;
+    memcpy_P(&font, m_font, sizeof(font));
 
-  writeReg(RA8875_REG_LTPR1, 0x00);  // Enable display of both layers
-  
-  SPI.endTransaction();
-}
+    rowHeight = font.yAdvance;
+    for (int c = font.first; c <= font.last; c++)
+      ascent = max(ascent, -(int8_t) pgm_read_byte(&font.glyph[c - font.first].yOffset));
+  }
 
-// Sets drawing layer. Valid layers are 1 and 2.
-void RA8875::setDrawLayer(int layer)
-{
-  SPI.beginTransaction(m_spiSettings);
+  int rows = (y2 - y1 + 1) / rowHeight;
+  if ((rows < 1) || (x2 < x1))
+    return false;
 
-  layer = constrain(layer, 1, 2);
+  console->x1         = x1;
+  console->y1         = y1;
+  console->x2         = x2;
+  console->y2         = y1 + rows * rowHeight - 1;
+  console->rowHeight  = rowHeight;
+  console->ascent     = ascent;
+  console->rows       = rows;
+  console->background = background;
+  console->wordWrap   = false;
+  console->history    = NULL;
+  console->scrolls    = 0;
 
-  uint8_t mwcr1 = readReg(RA8875_REG_MWCR1);
+  m_console = console;
 
-  writeReg(RA8875_REG_MWCR1, (mwcr1 & 0xFE) | (layer - 1));
-  
-  SPI.endTransaction();
+  setScrollWindow(x1, x2, y1, console->y2);
+  clearConsole();
+
+  return true;
 }
 
-void RA8875::drawPixel(int x, int y, uint16_t color)
+// Stops sending Print output to the console. The window and scroll offset are left as they are.
+void RA8875::endConsole(void)
 {
-  SPI.beginTransaction(m_spiSettings);
+  m_console = NULL;
+}
 
-  // Set memory write cursor
-  writeReg(RA8875_REG_CURH0, x & 0xFF);
-  writeReg(RA8875_REG_CURH1, x >> 8);
-  writeReg(RA8875_REG_CURV0, y & 0xFF);
-  writeReg(RA8875_REG_CURV1, y >> 8);  
-  
-  writeCmd(RA8875_REG_MRWC);
+// With word wrap on, a word that won't fit on the row moves down to the next one, and spaces at
+//  the end of a row are dropped.
+void RA8875::setConsoleWordWrap(bool enabled)
+{
+  if (m_console)
+    m_console->wordWrap = enabled;
+}
 
-  if (m_depth == 8)
-    writeData(color);
-  else
+// Keeps the last rows written to the console, up to columns characters each, so they can be shown
+//  again with scrollConsoleBack(). buffer must hold rows * columns characters and stay allocated
+//  while the console is in use. Rows already on screen aren't kept.
+void RA8875::setConsoleScrollback(char *buffer, int rows, int columns)
+{
+  RA8875_Console *con = m_console;
+  if (con == NULL)
+    return;
+
+  if ((buffer == NULL) || (rows < 1) || (columns < 1))
   {
-    writeData(color >> 8);
-    writeData(color & 0xFF);
+    con->history = NULL;
+    return;
   }
 
-//  digitalWrite(m_csPin, LOW);
-//  SPI.transfer(RA8875_DATA_WRITE);
-//  SPI.transfer(color);
-//  digitalWrite(m_csPin, HIGH);
-  
-  SPI.endTransaction();
+  con->history        = buffer;
+  con->historyRows    = rows;
+  con->historyColumns = columns;
+  con->historyLast    = 0;
+  con->historyCount   = 1;
+  con->historyColumn  = 0;
+  con->viewBack       = 0;
+
+  memset(buffer, 0, (size_t) rows * columns);
 }
 
-void RA8875::setDrawPosition(int x, int y)
+// Clears the console window and its scrollback, and starts again at the top.
+void RA8875::clearConsole(void)
 {
-  SPI.beginTransaction(m_spiSettings);
-  
-  writeReg(RA8875_REG_CURH0, x & 0xFF);
-  writeReg(RA8875_REG_CURH1, x >> 8);
-  writeReg(RA8875_REG_CURV0, y & 0xFF);
-  writeReg(RA8875_REG_CURV1, y >> 8);  
+  RA8875_STATS_OP(RA8875_OP_TEXT);
+
+  RA8875_Console *con = m_console;
+  if (con == NULL)
+    return;
 
-  SPI.endTransaction();
+  fillRect(con->x1, con->y1, con->x2, con->y2, con->background);
+  setScrollOffset(0, 0);
+
+  con->top        = 0;
+  con->row        = 0;
+  con->penX       = con->x1;
+  con->wordX      = con->x1;
+  con->wordLength = 0;
+
+  if (con->history)
+    setConsoleScrollback(con->history, con->historyRows, con->historyColumns);
 }
 
-void RA8875::pushPixel(uint16_t color)
+// Shows the console as it was the given number of rows ago, redrawn from the scrollback. 0 goes
+//  back to the latest rows, as does writing anything. Returns how far back it went, which is
+//  limited by the rows kept.
+int RA8875::scrollConsoleBack(int rows)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_TEXT);
 
-  writeCmd(RA8875_REG_MRWC);
+  RA8875_Console *con = m_console;
+  if ((con == NULL) || (con->history == NULL))
+    return 0;
 
-  if (m_depth == 8)
-    writeData(color);
-  else
+  rows = constrain(rows, 0, max(con->historyCount - con->rows, 0));
+
+  con->viewBack = rows;
+  renderConsole();
+
+  return rows;
+}
+
+// Redraws the console window from the scrollback, viewBack rows back from the latest.
+void RA8875::renderConsole(void)
+{
+  RA8875_Console *con = m_console;
+
+  fillRect(con->x1, con->y1, con->x2, con->y2, con->background);
+  setScrollOffset(0, 0);
+
+  int visible = min(con->rows, con->historyCount - con->viewBack);
+  int first = con->historyLast - con->viewBack - (visible - 1) + con->historyRows;
+
+  con->top = 0;
+  for (con->row = 0; con->row < visible; con->row++)
   {
-    writeData(color >> 8);
-    writeData(color & 0xFF);
+    const char *text = con->history + (size_t) ((first + con->row) % con->historyRows) * con->historyColumns;
+
+    con->penX = con->x1;
+    for (int i = 0; (i < con->historyColumns) && text[i]; i++)
+      consoleDraw(text[i], false);
   }
 
-  SPI.endTransaction();
+  // Carry on at the end of the last row
+  con->row--;
+  con->wordX = con->penX;
+  con->wordLength = 0;
 }
 
-void RA8875::copyToScreen(int srcX, int srcY, int width, int height, int dstX, int dstY, bool transparent, uint8_t bgColor)
+int RA8875::consoleAdvance(uint8_t c)
 {
-  SPI.beginTransaction(m_spiSettings);
+  if (m_font == NULL)
+    return m_textCellWidth;
 
-  // Source in layer 2
-  writeReg(RA8875_REG_HSBE0, srcX & 0xFF);
-  writeReg(RA8875_REG_HSBE1, srcX >> 8);
-  writeReg(RA8875_REG_VSBE0, srcY & 0xFF);
-  writeReg(RA8875_REG_VSBE1, (srcY >> 8) | 0x80);
-
-  // Destination in layer 1
-  writeReg(RA8875_REG_HDBE0, dstX & 0xFF);
-  writeReg(RA8875_REG_HDBE1, dstX >> 8);
-  writeReg(RA8875_REG_VDBE0, dstY & 0xFF);
-  writeReg(RA8875_REG_VDBE1, dstY >> 8);
+  RA8875_Font font;
+  memcpy_P(&font, m_font, sizeof(font));
 
-  // Width
-  writeReg(RA8875_REG_BEWR0, width & 0xFF);
-  writeReg(RA8875_REG_BEWR1, width >> 8);
+  if ((c < font.first) || (c > font.last))
+    return 0;
 
-  // Height
-  writeReg(RA8875_REG_BEHR0, height & 0xFF);
-  writeReg(RA8875_REG_BEHR1, height >> 8);
+  return pgm_read_byte(&font.glyph[c - font.first].xAdvance);
+}
 
-  // Transparency colour
-  if (transparent)
-  {
-    writeReg(RA8875_REG_FGCR0, bgColor >> 5);           // R
-    writeReg(RA8875_REG_FGCR1, (bgColor & 0x1C) >> 2);  // G
-    writeReg(RA8875_REG_FGCR2, bgColor & 0x3);          // B
-  }
+// Draws a character at the pen position on the current row, and moves the pen on. Recorded
+//  characters are added to the scrollback.
+void RA8875::consoleDraw(uint8_t c, bool record)
+{
+  RA8875_Console *con = m_console;
+  int y = consoleRowY(con->row);
 
-  // BTE operation
-  if (transparent)
-  {
-    // NOTE: According to data sheet section 7-6, ROP only works with specific operations, and Transparent Move
-    //  is not one of them. But in testing, it seems to apply the ROP anyway.
-    writeReg(RA8875_REG_BECR1, 0xC5);  // Operation = Transparent Move BTE in Positive Direction, ROP = source
-  }
+  if (m_font)
+    drawFontChar(con->penX, y + con->ascent, c, m_textColor);
   else
   {
-    writeReg(RA8875_REG_BECR1, 0xC2);  // Operation = Move in positive direction with ROP, ROP = source
+    beginTextTransaction();
+    setTextMode();
+    if (!m_cursorValid || (m_cursorX != con->penX) || (m_cursorY != y))
+      moveTextCursor(con->penX, y);
+    putText(c);
+    endTransaction();
   }
 
-  // Start operation
-  writeReg(RA8875_REG_BECR0, 0x80);  // Start operation, source is block, destination is block
-
-  // Wait for status register bit 6 to be clear
-#if RA8875_PRINT_TIMING
-  uint32_t startTime = micros();
-  int iter = 0;
-  while (readStatus() & 0x40)
-    iter++;
-  uint32_t endTime = micros();
-  Serial.print("copyToScreen() BTE done in "); Serial.print(endTime - startTime); Serial.print(" us "); Serial.print(iter); Serial.println(" iter");
-#else
-  while (readStatus() & 0x40)
-    ;
-#endif
+  con->penX += consoleAdvance(c);
 
-  SPI.endTransaction();
+  if (record && con->history && (con->historyColumn < con->historyColumns))
+    con->history[(size_t) con->historyLast * con->historyColumns + con->historyColumn++] = c;
 }
 
-void RA8875::copyFromScreen(int srcX, int srcY, int width, int height, int dstX, int dstY)
+// Starts a new row, scrolling the window up if the last one was in use.
+void RA8875::consoleNewLine(void)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_Console *con = m_console;
 
-  // Source in layer 1
-  writeReg(RA8875_REG_HSBE0, srcX & 0xFF);
-  writeReg(RA8875_REG_HSBE1, srcX >> 8);
-  writeReg(RA8875_REG_VSBE0, srcY & 0xFF);
-  writeReg(RA8875_REG_VSBE1, srcY >> 8);
-
-  // Destination in layer 2
-  writeReg(RA8875_REG_HDBE0, dstX & 0xFF);
-  writeReg(RA8875_REG_HDBE1, dstX >> 8);
-  writeReg(RA8875_REG_VDBE0, dstY & 0xFF);
-  writeReg(RA8875_REG_VDBE1, (dstY >> 8) | 0x80);
+  con->penX = con->x1;
+  con->wordX = con->x1;
+  con->wordLength = 0;
 
-  // Width
-  writeReg(RA8875_REG_BEWR0, width & 0xFF);
-  writeReg(RA8875_REG_BEWR1, width >> 8);
+  if (con->history)
+  {
+    con->historyLast = (con->historyLast + 1) % con->historyRows;
+    con->historyCount = min(con->historyCount + 1, (int) con->historyRows);
+    con->historyColumn = 0;
+    memset(con->history + (size_t) con->historyLast * con->historyColumns, 0, con->historyColumns);
+  }
 
-  // Height
-  writeReg(RA8875_REG_BEHR0, height & 0xFF);
-  writeReg(RA8875_REG_BEHR1, height >> 8);
+  if (con->row < con->rows - 1)
+  {
+    con->row++;
+    return;
+  }
 
-  writeReg(RA8875_REG_BECR1, 0xC2);  // Operation = Move in positive direction with ROP, ROP = source
+  // The top row's memory becomes the new bottom row: clear it, then move the offset to show it
+  int y = consoleRowY(0);
+  fillRect(con->x1, y, con->x2, y + con->rowHeight - 1, con->background);
 
-  // Start operation
-  writeReg(RA8875_REG_BECR0, 0x80);  // Start operation, source is block, destination is block
+  con->top = (con->top + 1) % con->rows;
 
-  // Wait for status register bit 6 to be clear
-#if RA8875_PRINT_TIMING
-  uint32_t startTime = micros();
-  int iter = 0;
-  while (readStatus() & 0x40)
-    iter++;
-  uint32_t endTime = micros();
-  Serial.print("copyFromScreen() BTE done in "); Serial.print(endTime - startTime); Serial.print(" us "); Serial.print(iter); Serial.println(" iter");
-#else
-  while (readStatus() & 0x40)
-    ;
-#endif
+  beginTransaction();
+  writeShadowReg16(RA8875_SHADOW_VOFS0, con->top * con->rowHeight);
+  endTransaction();
 
-  SPI.endTransaction();  
+  con->scrolls++;
 }
 
-void RA8875::copy(int srcLayer, int srcX, int srcY, int width, int height, int dstLayer, int dstX, int dstY, bool transparent, uint8_t bgColor)
+// Writes one character of Print output to the console.
+void RA8875::consoleWrite(uint8_t c)
 {
-  // Don't bother attempting zero-area copies
-  if ((width == 0) || (height == 0))
+  RA8875_Console *con = m_console;
+
+  if (con->viewBack)
+  {
+    con->viewBack = 0;
+    renderConsole();
+  }
+
+  if (c == '\r')
     return;
-  
-  SPI.beginTransaction(m_spiSettings);
 
-  // Source
-  writeReg(RA8875_REG_HSBE0, srcX & 0xFF);
-  writeReg(RA8875_REG_HSBE1, srcX >> 8);
-  writeReg(RA8875_REG_VSBE0, srcY & 0xFF);
-  writeReg(RA8875_REG_VSBE1, (srcY >> 8) | ((srcLayer == 2) ? 0x80 : 0x00));
+  if (c == '\n')
+  {
+    consoleNewLine();
+    return;
+  }
 
-  // Destination
-  writeReg(RA8875_REG_HDBE0, dstX & 0xFF);
-  writeReg(RA8875_REG_HDBE1, dstX >> 8);
-  writeReg(RA8875_REG_VDBE0, dstY & 0xFF);
-  writeReg(RA8875_REG_VDBE1, (dstY >> 8) | ((dstLayer == 2) ? 0x80 : 0x00));
+  int advance = consoleAdvance(c);
+
+  if (c == ' ')
+  {
+    con->wordLength = 0;
+    if (con->penX + advance > con->x2 + 1)
+    {
+      consoleNewLine();
+      if (con->wordWrap)
+        return;
+    }
+    con->wordX = con->penX + advance;
+  }
+  else if (con->penX + advance > con->x2 + 1)
+  {
+    // Take the word so far down with this character, unless it started the row or is too long
+    uint8_t length = con->wordLength;
+    bool move = con->wordWrap && (con->wordX > con->x1) && (length > 0) && (length <= RA8875_CONSOLE_WORD);
+
+    if (move)
+    {
+      int y = consoleRowY(con->row);
+      fillRect(con->wordX, y, con->penX - 1, y + con->rowHeight - 1, con->background);
+      if (con->history)
+      {
+        int column = max(con->historyColumn - length, 0);
+        memset(con->history + (size_t) con->historyLast * con->historyColumns + column, 0, con->historyColumn - column);
+        con->historyColumn = column;
+      }
+    }
+
+    consoleNewLine();
+
+    if (move)
+    {
+      for (uint8_t i = 0; i < length; i++)
+        consoleDraw(con->word[i], true);
+      con->wordLength = length;
+    }
+  }
+
+  // Past RA8875_CONSOLE_WORD, the length only records that the word is too long to move
+  if (c != ' ')
+  {
+    if (con->wordLength < RA8875_CONSOLE_WORD)
+      con->word[con->wordLength] = c;
+    if (con->wordLength <= RA8875_CONSOLE_WORD)
+      con->wordLength++;
+  }
+
+  consoleDraw(c, true);
+}
+
+void RA8875::setLayerMode(enum RA8875_Layer_Mode mode)
+{
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
+
+  beginTransaction();
+
+  uint8_t ltpr0 = readShadowReg(RA8875_SHADOW_LTPR0);
+
+  //Serial.print("mode: "); Serial.println(mode);
+  ltpr0 = (ltpr0 & 0xF8) | mode;
+  writeShadowReg(RA8875_SHADOW_LTPR0, ltpr0);
+  //Serial.print("LTPR0: "); Serial.println(ltpr0, HEX);
+
+  writeShadowReg(RA8875_SHADOW_LTPR1, 0x00);  // Enable display of both layers
+  
+  endTransaction();
+}
+
+// Sets drawing layer. Valid layers are 1 and 2.
+void RA8875::setDrawLayer(int layer)
+{
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
+
+  beginTransaction();
+
+  layer = constrain(layer, 1, 2);
+
+  uint8_t mwcr1 = readShadowReg(RA8875_SHADOW_MWCR1);
+
+  writeShadowReg(RA8875_SHADOW_MWCR1, (mwcr1 & 0xFE) | (layer - 1));
+  
+  endTransaction();
+}
+
+// Starts tracking damage to layer 2, for present() to copy to layer 1. setupCost is what one copy
+//  costs beyond its pixels, in pixels; rects are merged whenever copying them as one is no dearer.
+//  compositor must stay allocated while in use; NULL turns tracking off. Returns false if there's
+//  no second layer (800x480 at 16bpp). A glyph cache in layer 2 is turned off, as the back buffer
+//  takes all of it.
+bool RA8875::setCompositor(RA8875_Compositor *compositor, uint32_t setupCost)
+{
+  if ((compositor == NULL) || (getLayerCount() < 2))
+  {
+    m_compositor = NULL;
+    return compositor == NULL;
+  }
+
+  compositor->setupCost    = setupCost;
+  compositor->count        = 0;
+  compositor->copies       = 0;
+  compositor->copiedPixels = 0;
+
+  m_compositor = compositor;
+
+  if (m_glyphCache && isBufferLayer(m_glyphCache->layer))
+    m_glyphCache = NULL;
+
+  return true;
+}
+
+static inline int32_t rectArea(const RA8875_Rect &r)
+{
+  return (int32_t) (r.x2 - r.x1 + 1) * (r.y2 - r.y1 + 1);
+}
+
+static inline RA8875_Rect rectUnion(const RA8875_Rect &a, const RA8875_Rect &b)
+{
+  RA8875_Rect r = { min(a.x1, b.x1), min(a.y1, b.y1), max(a.x2, b.x2), max(a.y2, b.y2) };
+  return r;
+}
+
+// What copying two rects as one costs over copying them separately. Zero or less means merge.
+static inline int32_t mergeCost(const RA8875_Rect &a, const RA8875_Rect &b, uint32_t setupCost)
+{
+  return rectArea(rectUnion(a, b)) - rectArea(a) - rectArea(b) - (int32_t) setupCost;
+}
+
+// Records a rectangle of layer 2 as changed, for the next present(). Drawing calls do this
+//  themselves; call it after drawing that bypasses the library's tracking.
+void RA8875::addDamage(int x1, int y1, int x2, int y2)
+{
+  RA8875_Compositor *comp = m_compositor;
+  if (comp == NULL)
+    return;
+
+  // Clip
+  x1 = max(x1, 0);
+  y1 = max(y1, 0);
+  x2 = min(x2, m_width - 1);
+  y2 = min(y2, m_height - 1);
+  if ((x1 > x2) || (y1 > y2))
+    return;
+
+  RA8875_Rect r = { (int16_t) x1, (int16_t) y1, (int16_t) x2, (int16_t) y2 };
+
+  // Fold in every rect that's no dearer to copy together with this one. Each merge grows the rect,
+  //  which can make more merges pay, so go round until none do.
+  bool merged;
+  do
+  {
+    merged = false;
+    for (int i = 0; i < comp->count; i++)
+    {
+      if (mergeCost(r, comp->rects[i], comp->setupCost) <= 0)
+      {
+        r = rectUnion(r, comp->rects[i]);
+        comp->rects[i] = comp->rects[--comp->count];
+        merged = true;
+        break;
+      }
+    }
+  } while (merged);
+
+  // Out of room: merge whichever pair, counting the new rect, costs least extra
+  if (comp->count == RA8875_COMPOSITOR_RECTS)
+  {
+    int bestI = 0, bestJ = comp->count;
+    int32_t bestCost = INT32_MAX;
+
+    for (int i = 0; i < comp->count; i++)
+    {
+      for (int j = i + 1; j <= comp->count; j++)
+      {
+        int32_t cost = mergeCost(comp->rects[i], (j == comp->count) ? r : comp->rects[j], comp->setupCost);
+        if (cost < bestCost)
+        {
+          bestCost = cost;
+          bestI = i;
+          bestJ = j;
+        }
+      }
+    }
+
+    if (bestJ == comp->count)
+    {
+      r = rectUnion(r, comp->rects[bestI]);
+      comp->rects[bestI] = comp->rects[--comp->count];
+    }
+    else
+    {
+      comp->rects[bestI] = rectUnion(comp->rects[bestI], comp->rects[bestJ]);
+      comp->rects[bestJ] = comp->rects[--comp->count];
+    }
+  }
+
+  comp->rects[comp->count++] = r;
+}
+
+// Records the active window as damaged from row y down, or all of it for -1. For drawing whose
+//  extent isn't known up front: text and pixel streams.
+void RA8875::markWindowDamage(int y)
+{
+  if (m_compositor && (getDrawLayer() == 2))
+  {
+    addDamage(readShadowReg16(RA8875_SHADOW_HSAW0), max(y, (int) readShadowReg16(RA8875_SHADOW_VSAW0)),
+              readShadowReg16(RA8875_SHADOW_HEAW0), readShadowReg16(RA8875_SHADOW_VEAW0));
+  }
+}
+
+// Copies everything drawn on layer 2 since the last present() to layer 1.
+void RA8875::present(void)
+{
+  RA8875_STATS_OP(RA8875_OP_COPY);
+
+  RA8875_Compositor *comp = m_compositor;
+  if (comp == NULL)
+    return;
+
+  comp->copies       = comp->count;
+  comp->copiedPixels = 0;
+
+  for (int i = 0; i < comp->count; i++)
+  {
+    const RA8875_Rect &r = comp->rects[i];
+
+    copy(2, r.x1, r.y1, r.x2 - r.x1 + 1, r.y2 - r.y1 + 1, 1, r.x1, r.y1);
+    comp->copiedPixels += rectArea(r);
+  }
+
+  comp->count = 0;
+}
+
+// Sets how swapBuffers() waits for the vertical non-display period. For RA8875_VSYNC_PIN, pin is
+//  an input wired to the panel's VSYNC line, which init() sets up as active low.
+void RA8875::setVsync(enum RA8875_Vsync_Mode mode, int pin)
+{
+  if ((mode == RA8875_VSYNC_PIN) && (pin < 0))
+    mode = RA8875_VSYNC_NONE;
+
+  m_vsyncMode = mode;
+  m_vsyncPin  = pin;
+
+  if (mode == RA8875_VSYNC_PIN)
+    pinMode(pin, INPUT);
+}
+
+// Starts drawing a frame into whichever layer isn't being shown. The first call shows layer 1 and
+//  draws into layer 2. Returns false, changing nothing, if there's no second layer (800x480 at
+//  16bpp).
+// Each layer keeps what was last drawn into it, two frames back, so redraw everything that changed
+//  since then. The first call also turns off any glyph cache, which would show on alternate frames.
+bool RA8875::beginFrame(void)
+{
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
+
+  if (getLayerCount() < 2)
+    return false;
+
+  if (m_frontLayer == 0)
+  {
+    m_frontLayer = 1;
+    setLayerMode(RA8875_LAYER_1);
+
+    // Both layers are shown in turn, so there's nowhere left for a glyph cache
+    m_glyphCache = NULL;
+  }
+
+  setDrawLayer(3 - m_frontLayer);
+
+  return true;
+}
+
+// Shows the layer drawn since beginFrame(), and goes on to draw into the other one. Waits for the
+//  vertical non-display period first, as set with setVsync(), so the flip doesn't tear. Returns
+//  false if beginFrame() hasn't succeeded.
+bool RA8875::swapBuffers(void)
+{
+  RA8875_STATS_OP(RA8875_OP_CONFIG);
+
+  if (m_frontLayer == 0)
+    return false;
+
+  // Let the last drawing land before showing it
+  sync();
+
+  waitVsync();
+
+  m_frontLayer = 3 - m_frontLayer;
+  setLayerMode((m_frontLayer == 1) ? RA8875_LAYER_1 : RA8875_LAYER_2);
+  setDrawLayer(3 - m_frontLayer);
+
+  return true;
+}
+
+// Time to scan one line, including horizontal non-display, in nanoseconds.
+uint32_t RA8875::getLineNanos(void)
+{
+  uint32_t pixelClock = m_sysClock >> (m_panel.pcsr & 0x03);
+  uint32_t lineWidth  = m_panel.width + m_panel.hNonDisplay + m_panel.hSyncStart + m_panel.hSyncWidth;
+
+  return (uint64_t) lineWidth * 1000000000 / pixelClock;
+}
+
+// Returns the panel's refresh period, from its timings, in microseconds.
+uint32_t RA8875::getFramePeriod(void)
+{
+  uint32_t lines = m_panel.height + m_panel.vNonDisplay + m_panel.vSyncStart + m_panel.vSyncWidth;
+
+  return (uint64_t) lines * getLineNanos() / 1000;
+}
+
+// Waits until the panel is in its vertical non-display period, as set with setVsync().
+void RA8875::waitVsync(void)
+{
+  uint32_t lineNanos = getLineNanos();
+  uint32_t framePeriod = getFramePeriod();
+
+  // VSYNC goes active after the visible lines and the front porch
+  uint32_t syncOffset = (uint64_t) (m_panel.height + m_panel.vSyncStart) * lineNanos / 1000;
+
+  if (m_vsyncMode == RA8875_VSYNC_PIN)
+  {
+    // Already in the pulse is good enough: the back porch is still to come. Otherwise wait for
+    //  it, but no longer than two frames in case the pin isn't connected.
+    uint32_t start = micros();
+    while ((digitalRead(m_vsyncPin) != LOW) && ((micros() - start) < 2 * framePeriod))
+      ;
+
+    // Keep the timed estimate in step
+    if (digitalRead(m_vsyncPin) == LOW)
+      m_frameStart = micros() - syncOffset;
+  }
+  else if (m_vsyncMode == RA8875_VSYNC_TIMED)
+  {
+    // Visible lines come first in each frame, then the non-display period
+    uint32_t visible = (uint64_t) m_panel.height * lineNanos / 1000;
+    uint32_t position = (micros() - m_frameStart) % framePeriod;
+
+    if (position < visible)
+    {
+      // Wait in pieces, as delayMicroseconds() is only accurate for short delays on some boards
+      uint32_t wait = visible - position;
+      while (wait > 0)
+      {
+        uint32_t n = min(wait, (uint32_t) 10000);
+        delayMicroseconds(n);
+        wait -= n;
+      }
+    }
+  }
+}
+
+void RA8875::drawPixel(int x, int y, uint16_t color)
+{
+  RA8875_STATS_OP(RA8875_OP_DRAW_PIXEL);
+
+  markDamage(getDrawLayer(), x, y, x, y);
+
+  beginTransaction();
+
+  // Set memory write cursor
+  writeReg(RA8875_REG_CURH0, x & 0xFF);
+  writeReg(RA8875_REG_CURH1, x >> 8);
+  writeReg(RA8875_REG_CURV0, y & 0xFF);
+  writeReg(RA8875_REG_CURV1, y >> 8);  
+  
+  writeCmd(RA8875_REG_MRWC);
+
+  writePixelData(color);
+
+  endTransaction();
+}
+
+void RA8875::setDrawPosition(int x, int y)
+{
+  RA8875_STATS_OP(RA8875_OP_PIXELS);
+
+  markWindowDamage(y);
+
+  beginTransaction();
+  
+  writeReg(RA8875_REG_CURH0, x & 0xFF);
+  writeReg(RA8875_REG_CURH1, x >> 8);
+  writeReg(RA8875_REG_CURV0, y & 0xFF);
+  writeReg(RA8875_REG_CURV1, y >> 8);  
+
+  endTransaction();
+}
+
+void RA8875::pushPixel(uint16_t color)
+{
+  RA8875_STATS_OP(RA8875_OP_PIXELS);
+
+  beginTransaction();
+
+  writeCmd(RA8875_REG_MRWC);
+
+  writePixelData(color);
+
+  endTransaction();
+}
+
+// Starts a run of pixels at the given position.
+// The memory write cursor is set and MRWC issued once, then CS is held low in data write mode
+//  until endPixels() is called. Only pushPixels() may be called in between.
+void RA8875::beginPixels(int x, int y)
+{
+  RA8875_STATS_OP(RA8875_OP_PIXELS);
+
+  markWindowDamage(y);
+
+  beginTransaction();
+
+  startMemoryWrite(x, y);
+}
+
+// Sets the memory write cursor, issues MRWC and opens a data write cycle. Pixel bytes can follow
+//  until CS is released. Must be called inside an SPI transaction.
+void RA8875::startMemoryWrite(int x, int y)
+{
+  writeReg(RA8875_REG_CURH0, x & 0xFF);
+  writeReg(RA8875_REG_CURH1, x >> 8);
+  writeReg(RA8875_REG_CURV0, y & 0xFF);
+  writeReg(RA8875_REG_CURV1, y >> 8);
+
+  beginPixelData();
+}
+
+// Issues MRWC and opens a data write cycle, leaving CS low for pixel bytes.
+void RA8875::beginPixelData(void)
+{
+  writeCmd(RA8875_REG_MRWC);
+
+  m_bus.select();
+  m_bus.transfer(RA8875_DATA_WRITE);
+  RA8875_STATS_ADD(dataCycles, 1);
+  RA8875_STATS_ADD(csToggles, 1);
+  RA8875_STATS_ADD(bytes, 1);
+}
+
+// Sends pixels within a run started by beginPixels().
+void RA8875::pushPixels(const uint16_t *pixels, size_t count)
+{
+  RA8875_STATS_OP(RA8875_OP_PIXELS);
+
+#if RA8875_BULK_SPI
+  // Pack pixels into a buffer and hand whole buffers to the SPI library
+  uint8_t buf[RA8875_XFER_BUFFER_SIZE];
+
+  while (count)
+  {
+    size_t n = 0;
+
+    if (m_depth == 8)
+    {
+      while (count && (n < sizeof(buf)))
+      {
+        buf[n++] = *pixels++;
+        count--;
+      }
+    }
+    else
+    {
+      while (count && (n < sizeof(buf)))
+      {
+        buf[n++] = *pixels >> 8;
+        buf[n++] = *pixels++ & 0xFF;
+        count--;
+      }
+    }
+
+    if (m_recorder)
+      recordPixels(buf, n);
+    m_bus.transfer(buf, n);
+    RA8875_STATS_ADD(bytes, n);
+  }
+#else
+  RA8875_STATS_ADD(bytes, count * (m_depth / 8));
+
+  if (m_depth == 8)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      if (m_recorder)
+      {
+        uint8_t byte = pixels[i];
+        recordPixels(&byte, 1);
+      }
+      m_bus.transfer(pixels[i]);
+    }
+  }
+  else
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      if (m_recorder)
+      {
+        uint8_t bytes[2] = { (uint8_t) (pixels[i] >> 8), (uint8_t) pixels[i] };
+        recordPixels(bytes, 2);
+      }
+      m_bus.transfer(pixels[i] >> 8);
+      m_bus.transfer(pixels[i] & 0xFF);
+    }
+  }
+#endif
+}
+
+// Sends pixel data that is already in the chip's byte order, such as the output of the
+//  RA8875_rgb888To565() family, within a run started by beginPixels(). count is in bytes.
+void RA8875::pushPixelBytes(const uint8_t *bytes, size_t count)
+{
+  RA8875_STATS_OP(RA8875_OP_PIXELS);
+
+  RA8875_STATS_ADD(bytes, count);
+
+  if (m_recorder)
+    recordPixels(bytes, count);
+
+#if RA8875_BULK_SPI
+  // The SPI library overwrites the buffer with received bytes, so send a copy
+  uint8_t buf[RA8875_XFER_BUFFER_SIZE];
+
+  while (count)
+  {
+    size_t n = min(count, sizeof(buf));
+    memcpy(buf, bytes, n);
+    m_bus.transfer(buf, n);
+    bytes += n;
+    count -= n;
+  }
+#else
+  for (size_t i = 0; i < count; i++)
+    m_bus.transfer(bytes[i]);
+#endif
+}
+
+// Finishes a run of pixels started by beginPixels().
+void RA8875::endPixels(void)
+{
+  RA8875_STATS_OP(RA8875_OP_PIXELS);
+
+  m_bus.deselect();
+
+  endTransaction();
+}
+
+// Draws an image. src points at the image's top-left pixel, and each row starts stride bytes after
+//  the previous one. Parts outside the screen are clipped. Indexed formats look their colours up
+//  in palette, which holds RGB565 values. With RA8875_BITMAP_PROGMEM, src and palette are read
+//  from flash.
+// The active window is narrowed to the target rectangle so that the write cursor wraps at the end
+//  of each row by itself, and the whole image goes out in one MRWC burst. The active window is
+//  put back afterwards.
+void RA8875::drawBitmap(int x, int y, int width, int height, const void *src, size_t stride, enum RA8875_Bitmap_Format format, const uint16_t *palette, RA8875_Bitmap_Flags flags)
+{
+  RA8875_STATS_OP(RA8875_OP_BITMAP);
+
+  const uint8_t *row = (const uint8_t *) src;
+  int first = 0;  // First source pixel of each row
+
+  // Clip
+  if (x < 0)
+  {
+    first = -x;
+    width += x;
+    x = 0;
+  }
+  if (y < 0)
+  {
+    row += (size_t) -y * stride;
+    height += y;
+    y = 0;
+  }
+  if (x + width > m_width)
+    width = m_width - x;
+  if (y + height > m_height)
+    height = m_height - y;
+  if ((width <= 0) || (height <= 0))
+    return;
+
+  bool flash = flags & RA8875_BITMAP_PROGMEM;
+
+  markDamage(getDrawLayer(), x, y, x + width - 1, y + height - 1);
+
+  beginTransaction();
+
+  // Active window registers are consecutive in the shadow cache
+  uint8_t window[8];
+  memcpy(window, &m_shadow[RA8875_SHADOW_HSAW0], sizeof(window));
+
+  writeShadowReg16(RA8875_SHADOW_HSAW0, x);
+  writeShadowReg16(RA8875_SHADOW_HEAW0, x + width - 1);
+  writeShadowReg16(RA8875_SHADOW_VSAW0, y);
+  writeShadowReg16(RA8875_SHADOW_VEAW0, y + height - 1);
+
+  startMemoryWrite(x, y);
+
+  uint16_t buf[RA8875_XFER_BUFFER_SIZE / 2];
+
+  for (int j = 0; j < height; j++)
+  {
+    for (int i = 0; i < width; i += RA8875_XFER_BUFFER_SIZE / 2)
+    {
+      int n = min(width - i, RA8875_XFER_BUFFER_SIZE / 2);
+
+      convertBitmap(buf, row, first + i, n, format, palette, flash);
+      pushPixels(buf, n);
+    }
+
+    row += stride;
+  }
+
+  m_bus.deselect();
+
+  for (int i = 0; i < 8; i++)
+    writeShadowReg((enum RA8875_Shadow_Reg) (RA8875_SHADOW_HSAW0 + i), window[i]);
+
+  endTransaction();
+}
+
+// Expands an RGB332 colour to RGB565, replicating bits so that white stays white.
+static inline uint16_t rgb332To565(uint8_t c)
+{
+  uint8_t r = c & 0xE0;
+  uint8_t g = (c << 3) & 0xE0;
+  uint8_t b = (c << 6) & 0xC0;
+  return RGB565(r | (r >> 3) | (r >> 6), g | (g >> 3) | (g >> 6), b | (b >> 2) | (b >> 4) | (b >> 6));
+}
+
+// Converts count pixels of a bitmap row, starting at pixel first, to values for pushPixels().
+void RA8875::convertBitmap(uint16_t *dst, const uint8_t *row, int first, int count, enum RA8875_Bitmap_Format format, const uint16_t *palette, bool flash)
+{
+#define RA8875_SRC_BYTE(p) (flash ? pgm_read_byte(p) : *(p))
+#define RA8875_SRC_WORD(p) (flash ? pgm_read_word(p) : *(p))
+
+  bool rgb332 = (m_depth == 8);
+
+  switch (format)
+  {
+    case RA8875_BITMAP_RGB565:
+    {
+      const uint16_t *p = (const uint16_t *) row + first;
+      for (int i = 0; i < count; i++)
+      {
+        uint16_t c = RA8875_SRC_WORD(p + i);
+        dst[i] = rgb332 ? RGB565TO332(c) : c;
+      }
+      break;
+    }
+
+    case RA8875_BITMAP_RGB332:
+    {
+      const uint8_t *p = row + first;
+      for (int i = 0; i < count; i++)
+      {
+        uint8_t c = RA8875_SRC_BYTE(p + i);
+        dst[i] = rgb332 ? c : rgb332To565(c);
+      }
+      break;
+    }
+
+    case RA8875_BITMAP_RGB888:
+    {
+      const uint8_t *p = row + first * 3;
+      for (int i = 0; i < count; i++, p += 3)
+      {
+        uint8_t r = RA8875_SRC_BYTE(p), g = RA8875_SRC_BYTE(p + 1), b = RA8875_SRC_BYTE(p + 2);
+        dst[i] = rgb332 ? RGB332(r, g, b) : RGB565(r, g, b);
+      }
+      break;
+    }
+
+    default:
+    {
+      // Indexed: 1, 2, 4 or 8 bits per pixel
+      int bits = 1 << (format - RA8875_BITMAP_INDEX1);
+      uint8_t mask = (1 << bits) - 1;
+
+      for (int i = 0; i < count; i++)
+      {
+        unsigned int bit = (unsigned int) (first + i) * bits;
+        uint8_t index = (RA8875_SRC_BYTE(row + bit / 8) >> (8 - bits - (bit % 8))) & mask;
+        uint16_t c = RA8875_SRC_WORD(palette + index);
+        dst[i] = rgb332 ? RGB565TO332(c) : c;
+      }
+      break;
+    }
+  }
+
+#undef RA8875_SRC_BYTE
+#undef RA8875_SRC_WORD
+}
+
+void RA8875::copyToScreen(int srcX, int srcY, int width, int height, int dstX, int dstY, bool transparent, uint8_t bgColor)
+{
+  RA8875_STATS_OP(RA8875_OP_COPY);
+
+  beginTransaction();
+
+  // Source in layer 2
+  writeShadowReg16(RA8875_SHADOW_HSBE0, srcX);
+  writeShadowReg16(RA8875_SHADOW_VSBE0, srcY | 0x8000);
+
+  // Destination in layer 1
+  writeShadowReg16(RA8875_SHADOW_HDBE0, dstX);
+  writeShadowReg16(RA8875_SHADOW_VDBE0, dstY);
+
+  // Width
+  writeShadowReg16(RA8875_SHADOW_BEWR0, width);
+
+  // Height
+  writeShadowReg16(RA8875_SHADOW_BEHR0, height);
+
+  // Transparency colour
+  if (transparent)
+  {
+    writeShadowReg(RA8875_SHADOW_FGCR0, bgColor >> 5);           // R
+    writeShadowReg(RA8875_SHADOW_FGCR1, (bgColor & 0x1C) >> 2);  // G
+    writeShadowReg(RA8875_SHADOW_FGCR2, bgColor & 0x3);          // B
+  }
+
+  // BTE operation
+  if (transparent)
+  {
+    // NOTE: According to data sheet section 7-6, ROP only works with specific operations, and Transparent Move
+    //  is not one of them. But in testing, it seems to apply the ROP anyway.
+    writeShadowReg(RA8875_SHADOW_BECR1, 0xC5);  // Operation = Transparent Move BTE in Positive Direction, ROP = source
+  }
+  else
+  {
+    writeShadowReg(RA8875_SHADOW_BECR1, 0xC2);  // Operation = Move in positive direction with ROP, ROP = source
+  }
+
+  // Start operation
+  writeReg(RA8875_REG_BECR0, 0x80);  // Start operation, source is block, destination is block
+
+  // Wait for completion, or leave it running if pipelined
+  finishEngine(RA8875_WAIT_BTE);
+
+  endTransaction();
+}
+
+void RA8875::copyFromScreen(int srcX, int srcY, int width, int height, int dstX, int dstY)
+{
+  RA8875_STATS_OP(RA8875_OP_COPY);
+
+  markDamage(2, dstX, dstY, dstX + width - 1, dstY + height - 1);
+
+  beginTransaction();
+
+  // Source in layer 1
+  writeShadowReg16(RA8875_SHADOW_HSBE0, srcX);
+  writeShadowReg16(RA8875_SHADOW_VSBE0, srcY);
+
+  // Destination in layer 2
+  writeShadowReg16(RA8875_SHADOW_HDBE0, dstX);
+  writeShadowReg16(RA8875_SHADOW_VDBE0, dstY | 0x8000);
 
   // Width
-  writeReg(RA8875_REG_BEWR0, width & 0xFF);
-  writeReg(RA8875_REG_BEWR1, width >> 8);
+  writeShadowReg16(RA8875_SHADOW_BEWR0, width);
+
+  // Height
+  writeShadowReg16(RA8875_SHADOW_BEHR0, height);
+
+  writeShadowReg(RA8875_SHADOW_BECR1, 0xC2);  // Operation = Move in positive direction with ROP, ROP = source
+
+  // Start operation
+  writeReg(RA8875_REG_BECR0, 0x80);  // Start operation, source is block, destination is block
+
+  // Wait for completion, or leave it running if pipelined
+  finishEngine(RA8875_WAIT_BTE);
+
+  endTransaction();  
+}
+
+void RA8875::copy(int srcLayer, int srcX, int srcY, int width, int height, int dstLayer, int dstX, int dstY, bool transparent, uint8_t bgColor)
+{
+  RA8875_STATS_OP(RA8875_OP_COPY);
+
+  // Don't bother attempting zero-area copies
+  if ((width == 0) || (height == 0))
+    return;
+
+  markDamage(dstLayer, dstX, dstY, dstX + width - 1, dstY + height - 1);
+  
+  beginTransaction();
+
+  // Source
+  writeShadowReg16(RA8875_SHADOW_HSBE0, srcX);
+  writeShadowReg16(RA8875_SHADOW_VSBE0, srcY | ((srcLayer == 2) ? 0x8000 : 0x0000));
+
+  // Destination
+  writeShadowReg16(RA8875_SHADOW_HDBE0, dstX);
+  writeShadowReg16(RA8875_SHADOW_VDBE0, dstY | ((dstLayer == 2) ? 0x8000 : 0x0000));
+
+  // Width
+  writeShadowReg16(RA8875_SHADOW_BEWR0, width);
+
+  // Height
+  writeShadowReg16(RA8875_SHADOW_BEHR0, height);
+
+  // Transparency colour
+  if (transparent)
+  {
+    writeShadowReg(RA8875_SHADOW_FGCR0, bgColor >> 5);           // R
+    writeShadowReg(RA8875_SHADOW_FGCR1, (bgColor & 0x1C) >> 2);  // G
+    writeShadowReg(RA8875_SHADOW_FGCR2, bgColor & 0x3);          // B
+  }
+
+  // BTE operation
+  if (transparent)
+  {
+    // NOTE: According to data sheet section 7-6, ROP only works with specific operations, and Transparent Move
+    //  is not one of them. But in testing, it seems to apply the ROP anyway.
+    writeShadowReg(RA8875_SHADOW_BECR1, 0xC5);  // Operation = Transparent Move BTE in Positive Direction, ROP = source
+  }
+  else
+  {
+    writeShadowReg(RA8875_SHADOW_BECR1, 0xC2);  // Operation = Move in positive direction with ROP, ROP = source
+  }
+
+  // Start operation
+  writeReg(RA8875_REG_BECR0, 0x80);  // Start operation, source is block, destination is block
+
+  // Wait for completion, or leave it running if pipelined
+  finishEngine(RA8875_WAIT_BTE);
+
+  endTransaction();  
+}
+
+// Uploads a block of pixels through the BTE, combining each one with what is already on the
+//  given layer using a raster operation.
+void RA8875::bteWrite(int x, int y, int width, int height, int layer, enum RA8875_ROP rop, const uint16_t *pixels)
+{
+  RA8875_STATS_OP(RA8875_OP_BTE_WRITE);
+
+  bteWritePixels(x, y, width, height, layer, (rop << 4) | 0x00, pixels);  // Write BTE with ROP
+}
+
+// Uploads a block of pixels through the BTE, skipping any that match the colour key. The key is
+//  a pixel value in the same format as the pixels.
+void RA8875::bteWriteTransparent(int x, int y, int width, int height, int layer, uint16_t key, const uint16_t *pixels)
+{
+  RA8875_STATS_OP(RA8875_OP_BTE_WRITE);
+
+  // Key goes in the foreground colour. The data sheet doesn't say whether the ROP applies here,
+  //  so ask for a plain copy.
+  beginTransaction();
+  setForegroundPixel(key);
+  endTransaction();
+
+  bteWritePixels(x, y, width, height, layer, (RA8875_ROP_S << 4) | 0x04, pixels);  // Transparent write BTE
+}
+
+// Sets up a BTE operation that takes its source from the MCU, then streams the pixels into it.
+// Unlike pixel streaming, no cursor or active window is involved: the engine places each pixel
+//  in the destination block itself.
+void RA8875::bteWritePixels(int x, int y, int width, int height, int layer, uint8_t becr1, const uint16_t *pixels)
+{
+  if ((width <= 0) || (height <= 0))
+    return;
+
+  markDamage(layer, x, y, x + width - 1, y + height - 1);
+
+  beginTransaction();
+
+  // Destination
+  writeShadowReg16(RA8875_SHADOW_HDBE0, x);
+  writeShadowReg16(RA8875_SHADOW_VDBE0, y | ((layer == 2) ? 0x8000 : 0x0000));
+
+  // Size
+  writeShadowReg16(RA8875_SHADOW_BEWR0, width);
+  writeShadowReg16(RA8875_SHADOW_BEHR0, height);
+
+  writeShadowReg(RA8875_SHADOW_BECR1, becr1);
+  writeReg(RA8875_REG_BECR0, 0x80);  // Start operation, destination is block
+
+  // The engine now takes its source from memory writes
+  beginPixelData();
+  pushPixels(pixels, (size_t) width * height);
+  m_bus.deselect();
+
+  // Wait for the last pixels to land, or leave it running if pipelined
+  finishEngine(RA8875_WAIT_BTE);
+
+  endTransaction();
+}
+
+// Loads a pattern into the chip's pattern RAM, for use by fillRectPattern(). Pixels are in the
+//  same format as for pushPixels(): 64 of them for 8x8, or 256 for 16x16. Patterns 0-15 are
+//  available at 8x8, or 0-3 at 16x16. The size is shared by all patterns, so uploading a pattern
+//  of the other size makes the existing ones unusable.
+void RA8875::uploadPattern(int patternNo, enum RA8875_Pattern_Size size, const uint16_t *pixels)
+{
+  RA8875_STATS_OP(RA8875_OP_PATTERN);
+
+  m_patternSize = size;
+
+  beginTransaction();
+
+  // Send memory writes to the pattern RAM
+  uint8_t mwcr1 = readShadowReg(RA8875_SHADOW_MWCR1);
+  writeShadowReg(RA8875_SHADOW_MWCR1, mwcr1 | 0x0C);
+
+  writeReg(RA8875_REG_PTNO, size | (patternNo & 0x0F));
+
+  beginPixelData();
+  pushPixels(pixels, (size == RA8875_PATTERN_16X16) ? 256 : 64);
+  m_bus.deselect();
+
+  writeShadowReg(RA8875_SHADOW_MWCR1, mwcr1);
+
+  endTransaction();
+}
+
+// Tiles a pattern over a rectangle on the current draw layer, combining it with what's already
+//  there using a raster operation.
+void RA8875::fillRectPattern(int x, int y, int width, int height, int patternNo, enum RA8875_ROP rop)
+{
+  RA8875_STATS_OP(RA8875_OP_PATTERN);
+
+  fillPattern(x, y, width, height, patternNo, (rop << 4) | 0x06);  // Pattern fill with ROP
+}
+
+// Tiles a pattern over a rectangle on the current draw layer, leaving pixels where the pattern
+//  matches the colour key untouched.
+void RA8875::fillRectPatternTransparent(int x, int y, int width, int height, int patternNo, uint16_t key)
+{
+  RA8875_STATS_OP(RA8875_OP_PATTERN);
+
+  uint8_t r, g, b;
+  splitPixel(key, &r, &g, &b);
+
+  beginTransaction();
+  writeReg(RA8875_REG_BGTR0, r);
+  writeReg(RA8875_REG_BGTR1, g);
+  writeReg(RA8875_REG_BGTR2, b);
+  endTransaction();
+
+  fillPattern(x, y, width, height, patternNo, (RA8875_ROP_S << 4) | 0x07);  // Pattern fill with transparency
+}
+
+void RA8875::fillPattern(int x, int y, int width, int height, int patternNo, uint8_t becr1)
+{
+  if ((width <= 0) || (height <= 0))
+    return;
+
+  beginTransaction();
+
+  int layer = getDrawLayer();
+  markDamage(layer, x, y, x + width - 1, y + height - 1);
+
+  // Source is the pattern, starting at its top left
+  writeShadowReg16(RA8875_SHADOW_HSBE0, 0);
+  writeShadowReg16(RA8875_SHADOW_VSBE0, 0);
+  writeReg(RA8875_REG_PTNO, m_patternSize | (patternNo & 0x0F));
+
+  // Destination
+  writeShadowReg16(RA8875_SHADOW_HDBE0, x);
+  writeShadowReg16(RA8875_SHADOW_VDBE0, y | ((layer == 2) ? 0x8000 : 0x0000));
+
+  // Size
+  writeShadowReg16(RA8875_SHADOW_BEWR0, width);
+  writeShadowReg16(RA8875_SHADOW_BEHR0, height);
+
+  writeShadowReg(RA8875_SHADOW_BECR1, becr1);
+  writeReg(RA8875_REG_BECR0, 0x80);  // Start operation, source is block, destination is block
+
+  // Wait for completion, or leave it running if pipelined
+  finishEngine(RA8875_WAIT_BTE);
+
+  endTransaction();
+}
+
+// Draws a 1bpp image: set bits in fg and clear bits in bg, or left as they are if transparent.
+//  Each row starts on a new byte, most significant bit first, and colours are pixel values as for
+//  pushPixels(). With RA8875_BITMAP_PROGMEM, bits are read from flash.
+// The BTE's colour expansion does the work, so only one bit per pixel crosses the bus.
+void RA8875::drawMono(int x, int y, int width, int height, const uint8_t *bits, uint16_t fg, uint16_t bg, bool transparent, RA8875_Bitmap_Flags flags)
+{
+  RA8875_STATS_OP(RA8875_OP_MONO);
+
+  beginTransaction();
+
+  setForegroundPixel(fg);
+
+  if (!transparent)
+    setBackgroundPixel(bg);
+
+  endTransaction();
+
+  int layer = getDrawLayer();
+  drawMonoBits(x, y, width, height, layer, bits, (size_t) ((width + 7) / 8) * 8, transparent, flags & RA8875_BITMAP_PROGMEM);
+}
+
+// Sends a 1bpp image to a layer through a colour expansion BTE, using the colours
+//  already in FGCR and BGCR. Row j starts at bit j * rowBits of bits, so rows can be packed
+//  without padding, as in font glyphs. Parts outside the screen are clipped.
+void RA8875::drawMonoBits(int x, int y, int width, int height, int layer, const uint8_t *bits, size_t rowBits, bool transparent, bool flash)
+{
+#define RA8875_SRC_BYTE(p) (flash ? pgm_read_byte(p) : *(p))
+
+  size_t first = 0;  // First source bit of each row
+
+  // Clip
+  if (x < 0)
+  {
+    first = -x;
+    width += x;
+    x = 0;
+  }
+  if (y < 0)
+  {
+    first += (size_t) -y * rowBits;
+    height += y;
+    y = 0;
+  }
+  if (x + width > m_width)
+    width = m_width - x;
+  if (y + height > m_height)
+    height = m_height - y;
+  if ((width <= 0) || (height <= 0))
+    return;
+
+  markDamage(layer, x, y, x + width - 1, y + height - 1);
+
+  beginTransaction();
+
+  // Destination
+  writeShadowReg16(RA8875_SHADOW_HDBE0, x);
+  writeShadowReg16(RA8875_SHADOW_VDBE0, y | ((layer == 2) ? 0x8000 : 0x0000));
+
+  // Size
+  writeShadowReg16(RA8875_SHADOW_BEWR0, width);
+  writeShadowReg16(RA8875_SHADOW_BEHR0, height);
+
+  // The ROP field holds the bit each byte starts from: bit 7, as the bus is 8 bits wide
+  writeShadowReg(RA8875_SHADOW_BECR1, 0x70 | (transparent ? 0x09 : 0x08));  // Colour expansion, with or without transparency
+  writeReg(RA8875_REG_BECR0, 0x80);  // Start operation, destination is block
+
+  beginPixelData();
+
+  // Each row starts on a new byte, and the bits left over at the end of a row are ignored
+  uint8_t buf[RA8875_XFER_BUFFER_SIZE];
+  int rowBytes = (width + 7) / 8;
+
+  for (int j = 0; j < height; j++)
+  {
+    size_t bit = first + (size_t) j * rowBits;
+
+    for (int i = 0; i < rowBytes; i += sizeof(buf))
+    {
+      int n = min(rowBytes - i, (int) sizeof(buf));
+
+      for (int k = 0; k < n; k++, bit += 8)
+      {
+        const uint8_t *p = bits + bit / 8;
+        int shift = bit % 8;
+
+        // Only read the next byte when some of its bits are needed, to stay inside the image
+        uint8_t b = RA8875_SRC_BYTE(p) << shift;
+        if (shift && (shift + min(width - (i + k) * 8, 8) > 8))
+          b |= RA8875_SRC_BYTE(p + 1) >> (8 - shift);
+        buf[k] = b;
+      }
+
+      pushPixelBytes(buf, n);
+    }
+  }
+
+  m_bus.deselect();
+
+  // Wait for the last pixels to land, or leave it running if pipelined
+  finishEngine(RA8875_WAIT_BTE);
+
+  endTransaction();
+
+#undef RA8875_SRC_BYTE
+}
+
+// Draws a character in the current font, with its origin at x on the baseline at y, and returns
+//  how far to move along for the next one. Characters outside the font are skipped.
+int RA8875::drawFontChar(int x, int y, uint8_t c, uint16_t color)
+{
+  RA8875_STATS_OP(RA8875_OP_MONO);
+
+  if (m_font == NULL)
+    return 0;
+
+  RA8875_Font font;
+  memcpy_P(&font, m_font, sizeof(font));
+
+  if ((c < font.first) || (c > font.last))
+    return 0;
+
+  RA8875_Glyph glyph;
+  memcpy_P(&glyph, &font.glyph[c - font.first], sizeof(glyph));
+
+  if ((glyph.width > 0) && (glyph.height > 0))
+  {
+    const uint8_t *bitmap = font.bitmap + glyph.bitmapOffset;
+    int layer = getDrawLayer();
+
+    x += glyph.xOffset;
+    y += glyph.yOffset;
+
+    // Cached glyphs are copied into place, unless they need clipping. A display list can't rely
+    //  on what the cache holds, so it gets the glyph itself.
+    int slot = -1;
+    if (!m_recorder && (x >= 0) && (y >= 0) && (x + glyph.width <= m_width) && (y + glyph.height <= m_height))
+      slot = findGlyphSlot(c, color, glyph, bitmap);
+
+    if (slot >= 0)
+    {
+      RA8875_Glyph_Cache *cache = m_glyphCache;
+      copy(cache->layer, cache->x + (slot % cache->columns) * cache->cellWidth, cache->y + (slot / cache->columns) * cache->cellHeight,
+           glyph.width, glyph.height, layer, x, y, true, color ? 0 : 1);
+    }
+    else
+    {
+      beginTransaction();
+      setForegroundPixel(color);
+      endTransaction();
+
+      drawMonoBits(x, y, glyph.width, glyph.height, layer, bitmap, glyph.width, true, true);
+    }
+  }
+
+  return glyph.xAdvance;
+}
+
+// Draws a string in the current font, starting with the origin at x on the baseline at y. A
+//  newline goes back to x on the next line. Returns the x position after the last character.
+int RA8875::drawFontString(int x, int y, const char *str, uint16_t color)
+{
+  RA8875_STATS_OP(RA8875_OP_MONO);
+
+  if (m_font == NULL)
+    return x;
+
+  int startX = x;
+  uint8_t yAdvance = pgm_read_byte(&m_font->yAdvance);
+
+  for (; *str; str++)
+  {
+    if (*str == '\n')
+    {
+      x = startX;
+      y += yAdvance;
+    }
+    else
+      x += drawFontChar(x, y, *str, color);
+  }
+
+  return x;
+}
+
+// Uses an area of display memory to cache glyphs drawn by drawFontChar(): a band at the bottom of
+//  layer 2, RA8875_GLYPH_CACHE_ROWS cells high for the current font. Anything else drawn there will
+//  be overwritten, so layer 2 can't also be shown in full. Returns false when there's no second
+//  layer (800x480 at 16bpp) or no font, in which case pass an area explicitly, and while layer 2
+//  is a compositor back buffer or double buffered. cache must stay allocated while in use; NULL
+//  turns caching off.
+bool RA8875::setGlyphCache(RA8875_Glyph_Cache *cache)
+{
+  if ((cache == NULL) || (m_font == NULL) || (getLayerCount() < 2) || isBufferLayer(2))
+  {
+    m_glyphCache = NULL;
+    return cache == NULL;
+  }
+
+  // Size the cells for the current font, then fit the rows to them
+  m_glyphCache = cache;
+  cache->width  = m_width;
+  cache->height = m_height;
+  resetGlyphCache();
+
+  int height = min(RA8875_GLYPH_CACHE_ROWS * cache->cellHeight, m_height);
+  return setGlyphCache(cache, 2, 0, m_height - height, m_width, height);
+}
+
+// Uses the given area of display memory to cache glyphs drawn by drawFontChar(). The area is
+//  divided into cells the size of the largest glyph in the font, and is resized for each new font.
+//  Returns false if the area is off the layer, or the layer is a compositor back buffer or double
+//  buffered, as every pixel of those may be drawn over or shown.
+bool RA8875::setGlyphCache(RA8875_Glyph_Cache *cache, int layer, int x, int y, int width, int height)
+{
+  if ((cache == NULL) || (layer < 1) || (layer > getLayerCount()) || isBufferLayer(layer) ||
+      (x < 0) || (y < 0) || (width <= 0) || (height <= 0) || (x + width > m_width) || (y + height > m_height))
+  {
+    m_glyphCache = NULL;
+    return cache == NULL;
+  }
+
+  cache->layer  = layer;
+  cache->x      = x;
+  cache->y      = y;
+  cache->width  = width;
+  cache->height = height;
+  cache->hits   = 0;
+  cache->misses = 0;
+
+  m_glyphCache = cache;
+  resetGlyphCache();
+
+  return true;
+}
+
+// Empties the glyph cache and sizes its cells for the current font.
+void RA8875::resetGlyphCache(void)
+{
+  RA8875_Glyph_Cache *cache = m_glyphCache;
+
+  cache->font       = m_font;
+  cache->cellWidth  = 0;
+  cache->cellHeight = 0;
+  cache->columns    = 0;
+  cache->slotCount  = 0;
+  cache->filled     = 0;
+  cache->clock      = 0;
+
+  if (m_font == NULL)
+    return;
+
+  RA8875_Font font;
+  memcpy_P(&font, m_font, sizeof(font));
+
+  for (unsigned int c = font.first; c <= font.last; c++)
+  {
+    cache->cellWidth  = max(cache->cellWidth, pgm_read_byte(&font.glyph[c - font.first].width));
+    cache->cellHeight = max(cache->cellHeight, pgm_read_byte(&font.glyph[c - font.first].height));
+  }
+
+  if ((cache->cellWidth == 0) || (cache->cellHeight == 0))
+    return;
+
+  int columns = cache->width / cache->cellWidth;
+  int rows = cache->height / cache->cellHeight;
+
+  cache->columns   = min(columns, 255);
+  cache->slotCount = min(cache->columns * rows, RA8875_GLYPH_CACHE_SLOTS);
+}
+
+// Returns the glyph cache slot holding a glyph in a colour, first drawing it into the least
+//  recently used slot if it isn't there. Returns -1 if there's no cache for the current font.
+int RA8875::findGlyphSlot(uint8_t c, uint16_t color, const RA8875_Glyph &glyph, const uint8_t *bitmap)
+{
+  RA8875_Glyph_Cache *cache = m_glyphCache;
+  if (cache == NULL)
+    return -1;
+
+  if (cache->font != m_font)
+    resetGlyphCache();
+
+  if (cache->slotCount == 0)
+    return -1;
+
+  uint16_t now = ++cache->clock;
+
+  for (int i = 0; i < cache->filled; i++)
+  {
+    if ((cache->slots[i].code == c) && (cache->slots[i].color == color))
+    {
+      cache->slots[i].lastUsed = now;
+      cache->hits++;
+      return i;
+    }
+  }
+
+  cache->misses++;
+
+  // Take a free slot, or the one unused for longest. Ages are differences, so the clock can wrap.
+  int slot = 0;
+  if (cache->filled < cache->slotCount)
+    slot = cache->filled++;
+  else
+  {
+    uint16_t oldest = 0;
+    for (int i = 0; i < cache->filled; i++)
+    {
+      uint16_t age = now - cache->slots[i].lastUsed;
+      if (age > oldest)
+      {
+        oldest = age;
+        slot = i;
+      }
+    }
+  }
+
+  cache->slots[slot].code     = c;
+  cache->slots[slot].color    = color;
+  cache->slots[slot].lastUsed = now;
+
+  // Draw the glyph on a background that can't match it, which copies will treat as transparent.
+  //  Key 0 or 1 is the same pixel value at either depth, as copy() takes it.
+  beginTransaction();
+  setForegroundPixel(color);
+  setBackgroundPixel(color ? 0 : 1);
+  endTransaction();
+
+  drawMonoBits(cache->x + (slot % cache->columns) * cache->cellWidth, cache->y + (slot / cache->columns) * cache->cellHeight,
+               glyph.width, glyph.height, cache->layer, bitmap, glyph.width, false, true);
+
+  return slot;
+}
+
+// Returns the width of the widest line of a string in the current font, by character advances.
+int RA8875::getFontStringWidth(const char *str)
+{
+  if (m_font == NULL)
+    return 0;
+
+  RA8875_Font font;
+  memcpy_P(&font, m_font, sizeof(font));
+
+  int width = 0, lineWidth = 0;
+
+  for (; *str; str++)
+  {
+    uint8_t c = *str;
+
+    if (c == '\n')
+      lineWidth = 0;
+    else if ((c >= font.first) && (c <= font.last))
+      lineWidth += pgm_read_byte(&font.glyph[c - font.first].xAdvance);
+
+    width = max(width, lineWidth);
+  }
+
+  return width;
+}
+
+// Draws a 2-point shape (line, outline rect, filled rect)
+void RA8875::drawTwoPointShape(int x1, int y1, int x2, int y2, uint16_t color, uint8_t cmd)
+{
+  RA8875_STATS_OP((cmd & 0x10) ? ((cmd & 0x20) ? RA8875_OP_FILL_RECT : RA8875_OP_RECT) : RA8875_OP_LINE);
+
+  markDamage(getDrawLayer(), min(x1, x2), min(y1, y2), max(x1, x2), max(y1, y2));
+
+  beginTransaction();
+
+  // Start point and destination. Coordinates go through the shadow cache, so a shape sharing a
+  //  row, column or corner with the one before only sends the bytes that differ.
+  setDrawPoint(RA8875_SHADOW_DLHSR0, x1, y1);
+  setDrawPoint(RA8875_SHADOW_DLHER0, x2, y2);
+
+  // Color
+  setForegroundColor(color);
+
+  // Begin drawing
+  writeReg(RA8875_REG_DCR, 0x80 | cmd);
+
+  // Wait for completion, or leave it running if pipelined
+  finishEngine(RA8875_WAIT_DRAW);
+
+  endTransaction();  
+}
+
+// Draw 3-point shape (triangle or filled triangle)
+void RA8875::drawThreePointShape(int x1, int y1, int x2, int y2, int x3, int y3, uint16_t color, uint8_t cmd)
+{
+  RA8875_STATS_OP((cmd & 0x20) ? RA8875_OP_FILL_TRIANGLE : RA8875_OP_TRIANGLE);
+
+  markDamage(getDrawLayer(), min(x1, min(x2, x3)), min(y1, min(y2, y3)), max(x1, max(x2, x3)), max(y1, max(y2, y3)));
+
+  beginTransaction();
+
+  // Points
+  setDrawPoint(RA8875_SHADOW_DLHSR0, x1, y1);
+  setDrawPoint(RA8875_SHADOW_DLHER0, x2, y2);
+  setDrawPoint(RA8875_SHADOW_DTPH0, x3, y3);
+
+  // Color
+  setForegroundColor(color);
+
+  // Begin drawing
+  writeReg(RA8875_REG_DCR, 0x80 | cmd);
+
+  // Wait for completion, or leave it running if pipelined
+  finishEngine(RA8875_WAIT_DRAW);
+
+  endTransaction();
+}
+
+// Draw circle shape (circle or filled circle)
+void RA8875::drawCircleShape(int x, int y, int radius, uint16_t color, uint8_t cmd)
+{
+  RA8875_STATS_OP((cmd & 0x20) ? RA8875_OP_FILL_CIRCLE : RA8875_OP_CIRCLE);
+
+  // DCRR only holds 8 bits, but the ellipse engine takes radii up to 10 bits
+  if (radius > 255)
+  {
+    drawEllipseShape(x, y, radius, radius, color, (cmd & 0x20) ? 0x40 : 0x00);
+    return;
+  }
+
+  markDamage(getDrawLayer(), x - radius, y - radius, x + radius, y + radius);
+
+  beginTransaction();
+
+  // Centre point
+  setDrawPoint(RA8875_SHADOW_DCHR0, x, y);
+
+  // Radius
+  writeShadowReg(RA8875_SHADOW_DCRR, radius);
+
+  // Color
+  setForegroundColor(color);
+
+  // Begin drawing
+  writeReg(RA8875_REG_DCR, 0x40 | cmd);
+
+  // Wait for completion, or leave it running if pipelined
+  finishEngine(RA8875_WAIT_CIRCLE);
+
+  endTransaction();
+}
+
+// Draw ellipse shape (ellipse or quarter-ellipse curve, outlined or filled). For a curve, the low
+//  bits of cmd are the RA8875_Curve_Part. Nothing is drawn for a radius over 1023.
+void RA8875::drawEllipseShape(int x, int y, int xRadius, int yRadius, uint16_t color, uint8_t cmd)
+{
+  RA8875_STATS_OP((cmd & 0x40) ? RA8875_OP_FILL_ELLIPSE : RA8875_OP_ELLIPSE);
+
+  // ELLA and ELLB are 10 bits wide, and a larger radius would be drawn as its low bits
+  if ((xRadius > 1023) || (yRadius > 1023))
+    return;
+
+  if (cmd & 0x10)
+  {
+    // Just the quarter being drawn
+    int part = cmd & 0x03;
+    bool left = (part == RA8875_CURVE_LOWER_LEFT) || (part == RA8875_CURVE_UPPER_LEFT);
+    bool upper = (part == RA8875_CURVE_UPPER_LEFT) || (part == RA8875_CURVE_UPPER_RIGHT);
+
+    markDamage(getDrawLayer(), left ? x - xRadius : x, upper ? y - yRadius : y, left ? x : x + xRadius, upper ? y : y + yRadius);
+  }
+  else
+    markDamage(getDrawLayer(), x - xRadius, y - yRadius, x + xRadius, y + yRadius);
+
+  beginTransaction();
+
+  // Centre point and radii
+  setDrawPoint(RA8875_SHADOW_DEHR0, x, y);
+  writeShadowReg16(RA8875_SHADOW_ELLA0, xRadius);
+  writeShadowReg16(RA8875_SHADOW_ELLB0, yRadius);
+
+  // Color
+  setForegroundColor(color);
+
+  // Begin drawing
+  writeReg(RA8875_REG_ELLCR, 0x80 | cmd);
+
+  // Wait for completion, or leave it running if pipelined
+  finishEngine(RA8875_WAIT_ELLIPSE);
+
+  endTransaction();
+}
+
+// Draw rounded rect shape (outlined or filled). Radii are clamped so the corners fit; with no
+//  room for a corner, it's a plain rect.
+void RA8875::drawRoundRectShape(int x1, int y1, int x2, int y2, int xRadius, int yRadius, uint16_t color, uint8_t cmd)
+{
+  int left = min(x1, x2), right = max(x1, x2), top = min(y1, y2), bottom = max(y1, y2);
+  x1 = left;
+  x2 = right;
+  y1 = top;
+  y2 = bottom;
+
+  xRadius = min(xRadius, (x2 - x1 - 1) / 2);
+  yRadius = min(yRadius, (y2 - y1 - 1) / 2);
+
+  if ((xRadius <= 0) || (yRadius <= 0))
+  {
+    drawTwoPointShape(x1, y1, x2, y2, color, (cmd & 0x40) ? 0x30 : 0x10);
+    return;
+  }
+
+  RA8875_STATS_OP((cmd & 0x40) ? RA8875_OP_FILL_ROUND_RECT : RA8875_OP_ROUND_RECT);
+
+  markDamage(getDrawLayer(), x1, y1, x2, y2);
 
-  // Height
-  writeReg(RA8875_REG_BEHR0, height & 0xFF);
-  writeReg(RA8875_REG_BEHR1, height >> 8);
+  beginTransaction();
 
-  // Transparency colour
-  if (transparent)
+  // Corners and corner radii
+  setDrawPoint(RA8875_SHADOW_DLHSR0, x1, y1);
+  setDrawPoint(RA8875_SHADOW_DLHER0, x2, y2);
+  writeShadowReg16(RA8875_SHADOW_ELLA0, xRadius);
+  writeShadowReg16(RA8875_SHADOW_ELLB0, yRadius);
+
+  // Color
+  setForegroundColor(color);
+
+  // Begin drawing
+  writeReg(RA8875_REG_ELLCR, 0x80 | cmd);
+
+  // Wait for completion, or leave it running if pipelined
+  finishEngine(RA8875_WAIT_ELLIPSE);
+
+  endTransaction();
+}
+
+// Draws count / 2 lines, from points[0] to points[1], points[2] to points[3] and so on.
+void RA8875::drawLines(const RA8875_Point *points, size_t count, uint16_t color)
+{
+  RA8875_STATS_OP(RA8875_OP_LINE);
+
+  count &= ~1;
+  if (count == 0)
+    return;
+
+  beginTransaction();
+
+  setForegroundColor(color);
+
+  for (size_t i = 0; i < count; i += 2)
   {
-    writeReg(RA8875_REG_FGCR0, bgColor >> 5);           // R
-    writeReg(RA8875_REG_FGCR1, (bgColor & 0x1C) >> 2);  // G
-    writeReg(RA8875_REG_FGCR2, bgColor & 0x3);          // B
+    const RA8875_Point &a = points[i], &b = points[i + 1];
+
+    markDamage(getDrawLayer(), min(a.x, b.x), min(a.y, b.y), max(a.x, b.x), max(a.y, b.y));
+
+    if (i > 0)
+      waitEngine(RA8875_WAIT_DRAW);
+
+    setDrawPoint(RA8875_SHADOW_DLHSR0, a.x, a.y);
+    setDrawPoint(RA8875_SHADOW_DLHER0, b.x, b.y);
+    writeReg(RA8875_REG_DCR, 0x80);
   }
 
-  // BTE operation
-  if (transparent)
+  finishEngine(RA8875_WAIT_DRAW);
+
+  endTransaction();
+}
+
+// Draws lines joining count points in order.
+// Segments alternate in direction, so each one only sends its new point: the other is still in
+//  the registers from the segment before. Where a line's pixels depend on its direction, a
+//  segment may differ by a pixel from the same drawLine().
+void RA8875::drawPolyline(const RA8875_Point *points, size_t count, uint16_t color)
+{
+  RA8875_STATS_OP(RA8875_OP_LINE);
+
+  if (count < 2)
+    return;
+
+  int x1 = points[0].x, y1 = points[0].y, x2 = x1, y2 = y1;
+  for (size_t i = 1; i < count; i++)
   {
-    // NOTE: According to data sheet section 7-6, ROP only works with specific operations, and Transparent Move
-    //  is not one of them. But in testing, it seems to apply the ROP anyway.
-    writeReg(RA8875_REG_BECR1, 0xC5);  // Operation = Transparent Move BTE in Positive Direction, ROP = source
+    x1 = min(x1, (int) points[i].x);
+    y1 = min(y1, (int) points[i].y);
+    x2 = max(x2, (int) points[i].x);
+    y2 = max(y2, (int) points[i].y);
+  }
+  markDamage(getDrawLayer(), x1, y1, x2, y2);
+
+  beginTransaction();
+
+  setForegroundColor(color);
+  setDrawPoint(RA8875_SHADOW_DLHSR0, points[0].x, points[0].y);
+
+  for (size_t i = 1; i < count; i++)
+  {
+    if (i > 1)
+      waitEngine(RA8875_WAIT_DRAW);
+
+    // Odd segments end at the new point, even ones start from it
+    setDrawPoint((i & 1) ? RA8875_SHADOW_DLHER0 : RA8875_SHADOW_DLHSR0, points[i].x, points[i].y);
+    writeReg(RA8875_REG_DCR, 0x80);
+  }
+
+  finishEngine(RA8875_WAIT_DRAW);
+
+  endTransaction();
+}
+
+// Fills a polygon as a fan of filled triangles from its first point. The polygon must be convex,
+//  or at least have every edge in sight of the first point.
+// As with drawPolyline(), the triangles alternate which register pair gets the new point, so each
+//  one after the first only sends one point.
+void RA8875::fillPolygon(const RA8875_Point *points, size_t count, uint16_t color)
+{
+  RA8875_STATS_OP(RA8875_OP_FILL_TRIANGLE);
+
+  if (count < 3)
+    return;
+
+  int x1 = points[0].x, y1 = points[0].y, x2 = x1, y2 = y1;
+  for (size_t i = 1; i < count; i++)
+  {
+    x1 = min(x1, (int) points[i].x);
+    y1 = min(y1, (int) points[i].y);
+    x2 = max(x2, (int) points[i].x);
+    y2 = max(y2, (int) points[i].y);
+  }
+  markDamage(getDrawLayer(), x1, y1, x2, y2);
+
+  beginTransaction();
+
+  setForegroundColor(color);
+  setDrawPoint(RA8875_SHADOW_DLHSR0, points[0].x, points[0].y);
+  setDrawPoint(RA8875_SHADOW_DLHER0, points[1].x, points[1].y);
+
+  for (size_t i = 2; i < count; i++)
+  {
+    if (i > 2)
+      waitEngine(RA8875_WAIT_DRAW);
+
+    setDrawPoint((i & 1) ? RA8875_SHADOW_DLHER0 : RA8875_SHADOW_DTPH0, points[i].x, points[i].y);
+    writeReg(RA8875_REG_DCR, 0xA1);
+  }
+
+  finishEngine(RA8875_WAIT_DRAW);
+
+  endTransaction();
+}
+
+// Fills count rectangles.
+void RA8875::fillRects(const RA8875_Rect *rects, size_t count, uint16_t color)
+{
+  RA8875_STATS_OP(RA8875_OP_FILL_RECT);
+
+  if (count == 0)
+    return;
+
+  beginTransaction();
+
+  setForegroundColor(color);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    const RA8875_Rect &r = rects[i];
+
+    markDamage(getDrawLayer(), min(r.x1, r.x2), min(r.y1, r.y2), max(r.x1, r.x2), max(r.y1, r.y2));
+
+    if (i > 0)
+      waitEngine(RA8875_WAIT_DRAW);
+
+    setDrawPoint(RA8875_SHADOW_DLHSR0, r.x1, r.y1);
+    setDrawPoint(RA8875_SHADOW_DLHER0, r.x2, r.y2);
+    writeReg(RA8875_REG_DCR, 0xB0);
+  }
+
+  finishEngine(RA8875_WAIT_DRAW);
+
+  endTransaction();
+}
+
+// Opens a transaction for a software-rasterised shape within the given box.
+void RA8875::rasterBegin(int x1, int y1, int x2, int y2)
+{
+  markDamage(getDrawLayer(), x1, y1, x2, y2);
+
+  beginTransaction();
+}
+
+// Draws a solid span of one row, clipped to the screen. Long spans go to the engine, and are
+//  left drawing while the caller works out the next one only if pipelined. Must be between
+//  rasterBegin() and rasterEnd().
+void RA8875::rasterSpan(int x1, int x2, int y, uint16_t color)
+{
+  if ((y < 0) || (y >= m_height))
+    return;
+
+  x1 = max(x1, 0);
+  x2 = min(x2, m_width - 1);
+  if (x1 > x2)
+    return;
+
+  if (x2 - x1 + 1 >= RA8875_SPAN_FILL_MIN)
+  {
+    setDrawPoint(RA8875_SHADOW_DLHSR0, x1, y);
+    setDrawPoint(RA8875_SHADOW_DLHER0, x2, y);
+    setForegroundColor(color);
+    writeReg(RA8875_REG_DCR, 0x80);
+
+    finishEngine(RA8875_WAIT_DRAW);
   }
   else
   {
-    writeReg(RA8875_REG_BECR1, 0xC2);  // Operation = Move in positive direction with ROP, ROP = source
+    uint16_t pixels[RA8875_SPAN_PIXELS];
+
+    for (int x = x1; x <= x2; x += RA8875_SPAN_PIXELS)
+    {
+      int count = min(x2 - x + 1, RA8875_SPAN_PIXELS);
+      for (int i = 0; i < count; i++)
+        pixels[i] = color;
+      rasterPixels(x, y, pixels, count);
+    }
   }
+}
 
-  // Start operation
-  writeReg(RA8875_REG_BECR0, 0x80);  // Start operation, source is block, destination is block
+// Writes a run of RGB565 pixels along one row in a single MRWC burst, clipped to the screen. Must
+//  be between rasterBegin() and rasterEnd().
+void RA8875::rasterPixels(int x, int y, const uint16_t *pixels, int count)
+{
+  if ((y < 0) || (y >= m_height))
+    return;
 
-  // Wait for status register bit 6 to be clear
-#if RA8875_PRINT_TIMING
-  uint32_t startTime = micros();
-  int iter = 0;
-  while (readStatus() & 0x40)
-    iter++;
-  uint32_t endTime = micros();
-  Serial.print("copy() BTE done in "); Serial.print(endTime - startTime); Serial.print(" us "); Serial.print(iter); Serial.println(" iter");
-#else
-  while (readStatus() & 0x40)
-    ;
-#endif
+  if (x < 0)
+  {
+    pixels -= x;
+    count += x;
+    x = 0;
+  }
+  count = min(count, m_width - x);
+  if (count <= 0)
+    return;
+
+  startMemoryWrite(x, y);
+
+  if (m_depth == 8)
+  {
+    uint16_t converted[RA8875_SPAN_PIXELS];
+
+    while (count)
+    {
+      int n = min(count, RA8875_SPAN_PIXELS);
+      for (int i = 0; i < n; i++)
+        converted[i] = RGB565TO332(pixels[i]);
+      pushPixels(converted, n);
+      pixels += n;
+      count -= n;
+    }
+  }
+  else
+    pushPixels(pixels, count);
 
-  SPI.endTransaction();  
+  m_bus.deselect();
 }
 
-// Draws a 2-point shape (line, outline rect, filled rect)
-void RA8875::drawTwoPointShape(int x1, int y1, int x2, int y2, uint16_t color, uint8_t cmd)
+// Finishes a software-rasterised shape.
+void RA8875::rasterEnd(void)
 {
-  SPI.beginTransaction(m_spiSettings);
+  endTransaction();
+}
 
-  // Start point
-  writeReg(RA8875_REG_DLHSR0, x1 & 0xFF);
-  writeReg(RA8875_REG_DLHSR1, x1 >> 8);
-  writeReg(RA8875_REG_DLVSR0, y1 & 0xFF);
-  writeReg(RA8875_REG_DLVSR1, y1 >> 8);
+// Floor and ceiling of a / b, for b > 0
+static int32_t floorDiv(int32_t a, int32_t b)
+{
+  return (a >= 0) ? a / b : -((b - 1 - a) / b);
+}
 
-  // Destination
-  writeReg(RA8875_REG_DLHER0, x2 & 0xFF);
-  writeReg(RA8875_REG_DLHER1, x2 >> 8);
-  writeReg(RA8875_REG_DLVER0, y2 & 0xFF);
-  writeReg(RA8875_REG_DLVER1, y2 >> 8);
+static int32_t ceilDiv(int32_t a, int32_t b)
+{
+  return (a >= 0) ? (a + b - 1) / b : -(-a / b);
+}
 
-  // Color
-  writeReg(RA8875_REG_FGCR0, color >> 11);            // R
-  writeReg(RA8875_REG_FGCR1, (color & 0x07E0) >> 5);  // G
-  writeReg(RA8875_REG_FGCR2, color & 0x1F);           // B
+static uint32_t isqrt(uint32_t x)
+{
+  uint32_t root = 0, bit = 1UL << 30;
 
-  // Begin drawing
-  writeReg(RA8875_REG_DCR, 0x80 | cmd);
+  while (bit > x)
+    bit >>= 2;
 
-  // Wait for completion
-  while (readReg(RA8875_REG_DCR) & 0x80)
-    ;
+  while (bit)
+  {
+    if (x >= root + bit)
+    {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+      root >>= 1;
+
+    bit >>= 2;
+  }
 
-  SPI.endTransaction();  
+  return root;
 }
 
-// Draw 3-point shape (triangle or filled triangle)
-void RA8875::drawThreePointShape(int x1, int y1, int x2, int y2, int x3, int y3, uint16_t color, uint8_t cmd)
+// Where the edge from a to b crosses row y, in the same units
+static int32_t edgeCrossing(int32_t ax, int32_t ay, int32_t bx, int32_t by, int32_t y)
 {
-  SPI.beginTransaction(m_spiSettings);
+  int32_t dy = y - ay, dx = bx - ax;
 
-  // First point
-  writeReg(RA8875_REG_DLHSR0, x1 & 0xFF);
-  writeReg(RA8875_REG_DLHSR1, x1 >> 8);
-  writeReg(RA8875_REG_DLVSR0, y1 & 0xFF);
-  writeReg(RA8875_REG_DLVSR1, y1 >> 8);
+  // Only edges reaching far off the screen need the product in 64 bits
+  if ((abs(dy) < 0x8000) && (abs(dx) < 0x10000))
+    return ax + dy * dx / (by - ay);
 
-  // Second point
-  writeReg(RA8875_REG_DLHER0, x2 & 0xFF);
-  writeReg(RA8875_REG_DLHER1, x2 >> 8);
-  writeReg(RA8875_REG_DLVER0, y2 & 0xFF);
-  writeReg(RA8875_REG_DLVER1, y2 >> 8);
+  return ax + (int64_t) dy * dx / (by - ay);
+}
 
-  // Third point
-  writeReg(RA8875_REG_DTPH0, x3 & 0xFF);
-  writeReg(RA8875_REG_DTPH1, x3 >> 8);
-  writeReg(RA8875_REG_DTPV0, y3 & 0xFF);
-  writeReg(RA8875_REG_DTPV1, y3 >> 8);
+// Fills contours by the even-odd rule, so a contour inside another cuts a hole in it. Point
+//  coordinates are in units of 1 / (1 << shift) pixels, and a pixel is filled if its top-left
+//  corner is inside: a square from (0, 0) to (10, 10) fills pixels 0 to 9. Points are
+//  RA8875_Point, or int32_t pairs where they may not fit in 16 bits.
+template <typename Point>
+void RA8875::rasterPolygon(const Point *points, const uint16_t *counts, int contours, int shift, uint16_t color)
+{
+  int32_t unit = 1L << shift;
+  int32_t xMin = INT32_MAX, yMin = INT32_MAX, xMax = INT32_MIN, yMax = INT32_MIN;
+  const Point *p = points;
 
-  // Color
-  writeReg(RA8875_REG_FGCR0, color >> 11);            // R
-  writeReg(RA8875_REG_FGCR1, (color & 0x07E0) >> 5);  // G
-  writeReg(RA8875_REG_FGCR2, color & 0x1F);           // B
+  for (int c = 0; c < contours; c++)
+  {
+    for (uint16_t i = 0; i < counts[c]; i++, p++)
+    {
+      xMin = min(xMin, (int32_t) p->x);
+      yMin = min(yMin, (int32_t) p->y);
+      xMax = max(xMax, (int32_t) p->x);
+      yMax = max(yMax, (int32_t) p->y);
+    }
+  }
 
-  // Begin drawing
-  writeReg(RA8875_REG_DCR, 0x80 | cmd);
+  if (p == points)
+    return;
 
-  // Wait for completion
-  while (readReg(RA8875_REG_DCR) & 0x80)
-    ;
+  // Rows whose top edge is within the polygon's bounds
+  int top = max(ceilDiv(yMin, unit), (int32_t) 0);
+  int bottom = min(ceilDiv(yMax, unit) - 1, (int32_t) m_height - 1);
+
+  // Columns are clipped to just off either side, so they fit in an int
+  rasterBegin(constrain(ceilDiv(xMin, unit), (int32_t) 0, (int32_t) m_width), top,
+              constrain(ceilDiv(xMax, unit) - 1, (int32_t) -1, (int32_t) m_width - 1), bottom);
+
+  for (int y = top; y <= bottom; y++)
+  {
+    int32_t sampleY = (int32_t) y << shift;
+    int32_t crossings[RA8875_RASTER_CROSSINGS];
+    int n = 0;
+
+    p = points;
+    for (int c = 0; c < contours; c++)
+    {
+      for (uint16_t i = 0; i < counts[c]; i++)
+      {
+        const Point &a = p[i], &b = p[(i + 1 < counts[c]) ? i + 1 : 0];
+
+        // Edges cover the rows from their top end up to, but not including, their bottom end, so a
+        //  point where two edges meet is counted once
+        if (((a.y <= sampleY) != (b.y <= sampleY)) && (n < RA8875_RASTER_CROSSINGS))
+          crossings[n++] = edgeCrossing(a.x, a.y, b.x, b.y, sampleY);
+      }
+      p += counts[c];
+    }
+
+    for (int i = 1; i < n; i++)
+    {
+      int32_t crossing = crossings[i];
+      int j = i;
+
+      for (; (j > 0) && (crossings[j - 1] > crossing); j--)
+        crossings[j] = crossings[j - 1];
+      crossings[j] = crossing;
+    }
 
-  SPI.endTransaction();
+    for (int i = 0; i + 1 < n; i += 2)
+      rasterSpan(constrain(ceilDiv(crossings[i], unit), (int32_t) 0, (int32_t) m_width),
+                 constrain(ceilDiv(crossings[i + 1], unit) - 1, (int32_t) -1, (int32_t) m_width - 1), y, color);
+  }
+
+  rasterEnd();
 }
 
-// Draw circle shape (circle or filled circle)
-void RA8875::drawCircleShape(int x, int y, int radius, uint16_t color, uint8_t cmd)
+// Fills any polygon, including concave and self-intersecting ones, given as contours of
+//  counts[0], counts[1] ... points each, one after the other in points. Filling is by the even-odd
+//  rule, so a contour inside another cuts a hole in it. Edges follow the usual top-left rule:
+//  a square from (0, 0) to (10, 10) fills pixels 0 to 9.
+// Each row can cross at most RA8875_RASTER_CROSSINGS edges.
+void RA8875::fillComplexPolygon(const RA8875_Point *points, const uint16_t *counts, int contours, uint16_t color)
 {
-  SPI.beginTransaction(m_spiSettings);
+  RA8875_STATS_OP(RA8875_OP_RASTER);
 
-  // Centre point
-  writeReg(RA8875_REG_DCHR0, x & 0xFF);
-  writeReg(RA8875_REG_DCHR1, x >> 8);
-  writeReg(RA8875_REG_DCVR0, y & 0xFF);
-  writeReg(RA8875_REG_DCVR1, y >> 8);
+  rasterPolygon(points, counts, contours, 0, color);
+}
 
-  // Radius
-  writeReg(RA8875_REG_DCRR, radius);
+// Draws a line width pixels wide, with square ends that cover both end points. Widths of 1 or
+//  less are drawLine().
+void RA8875::drawThickLine(int x1, int y1, int x2, int y2, int width, uint16_t color)
+{
+  if (width <= 1)
+  {
+    drawLine(x1, y1, x2, y2, color);
+    return;
+  }
 
-  // Color
-  writeReg(RA8875_REG_FGCR0, color >> 11);            // R
-  writeReg(RA8875_REG_FGCR1, (color & 0x07E0) >> 5);  // G
-  writeReg(RA8875_REG_FGCR2, color & 0x1F);           // B
+  RA8875_STATS_OP(RA8875_OP_RASTER);
 
-  // Begin drawing
-  writeReg(RA8875_REG_DCR, 0x40 | cmd);
+  int32_t dx = x2 - x1, dy = y2 - y1;
 
-  // Wait for completion
-  while (readReg(RA8875_REG_DCR) & 0x40)
-    ;
+  if ((dx == 0) && (dy == 0))
+  {
+    fillRect(x1 - (width - 1) / 2, y1 - (width - 1) / 2, x1 + width / 2, y1 + width / 2, color);
+    return;
+  }
+
+  // The outline as a quad in sixteenths of a pixel: across the line by half the width each way,
+  //  and along it by half a pixel past each end point. Sixteenths overflow 16 bits beyond about
+  //  2047 pixels, and the length in them beyond 4096, so end points can be well off the screen.
+  uint32_t lengthSquared = (uint32_t) (dx * dx + dy * dy);
+  int32_t length = (lengthSquared < 0x1000000) ? isqrt(lengthSquared << 8) : isqrt(lengthSquared) << 4;
+  int32_t acrossX = -dy * width * 128 / length, acrossY = dx * width * 128 / length;
+  int32_t alongX = dx * 128 / length, alongY = dy * 128 / length;
+  int32_t ax = ((int32_t) x1 << 4) - alongX, ay = ((int32_t) y1 << 4) - alongY;
+  int32_t bx = ((int32_t) x2 << 4) + alongX, by = ((int32_t) y2 << 4) + alongY;
+
+  struct
+  {
+    int32_t x;
+    int32_t y;
+  }
+  quad[4] =
+  {
+    { ax + acrossX, ay + acrossY },
+    { bx + acrossX, by + acrossY },
+    { bx - acrossX, by - acrossY },
+    { ax - acrossX, ay - acrossY }
+  };
+  uint16_t count = 4;
+
+  rasterPolygon(quad, &count, 1, 4, color);
+}
+
+// Mixes two RGB565 colours, alpha / 255 of the way from background to color
+static uint16_t blend565(uint16_t color, uint16_t background, uint8_t alpha)
+{
+  // Spread the fields out so one multiply scales all three
+  uint32_t fg = (color | ((uint32_t) color << 16)) & 0x07E0F81F;
+  uint32_t bg = (background | ((uint32_t) background << 16)) & 0x07E0F81F;
+  uint32_t mix = ((((fg - bg) * ((alpha + 4) >> 3)) >> 5) + bg) & 0x07E0F81F;
+
+  return mix | (mix >> 16);
+}
+
+// Draws a one-pixel line with anti-aliased edges (Wu's algorithm). Edge pixels are blended with
+//  background, which should be the colour underneath.
+// Each row's pixels go out as one burst, so shallow lines cost little more than their pixels.
+void RA8875::drawLineAA(int x1, int y1, int x2, int y2, uint16_t color, uint16_t background)
+{
+  RA8875_STATS_OP(RA8875_OP_RASTER);
+
+  bool steep = abs(y2 - y1) > abs(x2 - x1);
+
+  // Step along the longer axis, forwards
+  if (steep ? (y1 > y2) : (x1 > x2))
+  {
+    int t = x1;
+    x1 = x2;
+    x2 = t;
+    t = y1;
+    y1 = y2;
+    y2 = t;
+  }
+
+  rasterBegin(min(x1, x2), min(y1, y2), max(x1, x2) + 1, max(y1, y2) + 1);
+
+  if (steep)
+  {
+    // Each row has the pixel the line passes through and the one to its right
+    int32_t gradient = ((int32_t) (x2 - x1) << 16) / (y2 - y1);
+    int32_t x = (int32_t) x1 << 16;
+
+    for (int y = y1; y <= y2; y++, x += gradient)
+    {
+      uint8_t frac = (x >> 8) & 0xFF;
+      uint16_t pixels[2] = { blend565(color, background, 255 - frac), blend565(color, background, frac) };
+
+      rasterPixels(x >> 16, y, pixels, frac ? 2 : 1);
+    }
+  }
+  else
+  {
+    // Each column has the pixel the line passes through and the one below. Pixels are collected
+    //  into runs along the two rows that covers, and a run is written when the line leaves its row.
+    struct Run
+    {
+      int x;
+      int y;
+      int count;
+      uint16_t pixels[RA8875_SPAN_PIXELS];
+    } runs[2];
+
+    runs[0].count = runs[1].count = 0;
+
+    int32_t gradient = (x2 > x1) ? ((int32_t) (y2 - y1) << 16) / (x2 - x1) : 0;
+    int32_t y = (int32_t) y1 << 16;
+
+    for (int x = x1; x <= x2; x++, y += gradient)
+    {
+      int row = y >> 16;
+      uint8_t frac = (y >> 8) & 0xFF;
+
+      for (int k = 0; k < 2; k++)
+      {
+        uint8_t weight = k ? frac : 255 - frac;
+        Run *run = NULL;
+
+        for (int i = 0; i < 2; i++)
+        {
+          if (runs[i].count && (runs[i].y == row + k))
+            run = &runs[i];
+        }
+
+        // A run ends at a pixel the line misses, or when it's full
+        if (run && ((weight == 0) || (run->count == RA8875_SPAN_PIXELS)))
+        {
+          rasterPixels(run->x, run->y, run->pixels, run->count);
+          run->count = 0;
+        }
+
+        if (weight == 0)
+          continue;
+
+        if (run == NULL)
+        {
+          // Finish a run on a row the line has moved off, to make room
+          for (int i = 0; i < 2; i++)
+          {
+            if (runs[i].count && (runs[i].y != row) && (runs[i].y != row + 1))
+            {
+              rasterPixels(runs[i].x, runs[i].y, runs[i].pixels, runs[i].count);
+              runs[i].count = 0;
+            }
+          }
+
+          run = runs[0].count ? &runs[1] : &runs[0];
+        }
+
+        if (run->count == 0)
+        {
+          run->x = x;
+          run->y = row + k;
+        }
+
+        run->pixels[run->count++] = blend565(color, background, weight);
+      }
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+      if (runs[i].count)
+        rasterPixels(runs[i].x, runs[i].y, runs[i].pixels, runs[i].count);
+    }
+  }
+
+  rasterEnd();
+}
+
+// Quarter of a sine wave, for drawArc(): sin(n degrees) * 32767
+static const uint16_t s_sine[91] PROGMEM =
+{
+      0,   572,  1144,  1715,  2286,  2856,  3425,  3993,  4560,  5126,
+   5690,  6252,  6813,  7371,  7927,  8481,  9032,  9580, 10126, 10668,
+  11207, 11743, 12275, 12803, 13328, 13848, 14364, 14876, 15383, 15886,
+  16383, 16876, 17364, 17846, 18323, 18794, 19260, 19720, 20173, 20621,
+  21062, 21497, 21925, 22347, 22762, 23170, 23571, 23964, 24351, 24730,
+  25101, 25465, 25821, 26169, 26509, 26841, 27165, 27481, 27788, 28087,
+  28377, 28659, 28932, 29196, 29451, 29697, 29934, 30162, 30381, 30591,
+  30791, 30982, 31163, 31335, 31498, 31650, 31794, 31927, 32051, 32165,
+  32269, 32364, 32448, 32523, 32587, 32642, 32687, 32722, 32747, 32762,
+  32767
+};
+
+// Direction of an angle in degrees, clockwise from 3 o'clock on screen, scaled to 32767
+static void angleVector(int degrees, int32_t *x, int32_t *y)
+{
+  degrees %= 360;
+  if (degrees < 0)
+    degrees += 360;
+
+  int d = degrees % 90;
+  int32_t sine = pgm_read_word(&s_sine[d]), cosine = pgm_read_word(&s_sine[90 - d]);
+
+  switch (degrees / 90)
+  {
+    case 0:  *x = cosine;  *y = sine;    break;
+    case 1:  *x = -sine;   *y = cosine;  break;
+    case 2:  *x = -cosine; *y = -sine;   break;
+    default: *x = sine;    *y = -cosine; break;
+  }
+}
+
+// Narrows [*lo, *hi] to the integers dx where k * dx <= m
+static void limitSpan(int32_t k, int32_t m, int32_t *lo, int32_t *hi)
+{
+  if (k > 0)
+    *hi = min(*hi, floorDiv(m, k));
+  else if (k < 0)
+    *lo = max(*lo, ceilDiv(-m, -k));
+  else if (m < 0)
+  {
+    *lo = 1;
+    *hi = 0;
+  }
+}
+
+// Draws part of a ring: the pixels within radius of (x, y) but not within radius - width, from
+//  startAngle clockwise to endAngle. Angles are in degrees, clockwise from 3 o'clock. A width of
+//  radius + 1 fills a pie slice, and angles 360 or more apart give the whole ring.
+void RA8875::drawArc(int x, int y, int radius, int width, int startAngle, int endAngle, uint16_t color)
+{
+  RA8875_STATS_OP(RA8875_OP_RASTER);
+
+  if ((radius < 0) || (width <= 0))
+    return;
 
-  SPI.endTransaction();
+  bool full = (endAngle - startAngle >= 360) || (endAngle - startAngle <= -360);
+  int sweep = ((endAngle - startAngle) % 360 + 360) % 360;
+
+  int32_t startX, startY, endX, endY;
+  angleVector(startAngle, &startX, &startY);
+  angleVector(endAngle, &endX, &endY);
+
+  // Pixel centres within half a pixel of the radii
+  int hole = radius - width;
+  int32_t outer = (int32_t) radius * radius + radius;
+  int32_t inner = (hole >= 0) ? (int32_t) hole * hole + hole : -1;
+
+  rasterBegin(x - radius, y - radius, x + radius, y + radius);
+
+  for (int dy = -radius; dy <= radius; dy++)
+  {
+    int32_t dy2 = (int32_t) dy * dy;
+    int32_t xo = isqrt(outer - dy2);
+    int32_t xi = (inner >= dy2) ? (int32_t) isqrt(inner - dy2) : -1;
+
+    // The ring's row: one span, or one either side of the hole
+    int32_t ring[2][2] = { { -xo, (xi < 0) ? xo : -xi - 1 }, { xi + 1, xo } };
+    int rings = (xi < 0) ? 1 : 2;
+
+    // The sector's row. Up to half a turn, it's what's clockwise of the start and anticlockwise of
+    //  the end. Beyond that, it's everything but the sector that's left out.
+    int32_t sector[2][2] = { { -xo, xo }, { 1, 0 } };
+    int sectors = 1;
+
+    if (!full && (sweep <= 180))
+    {
+      limitSpan(startY, startX * dy, &sector[0][0], &sector[0][1]);
+      limitSpan(-endY, -endX * dy, &sector[0][0], &sector[0][1]);
+    }
+    else if (!full)
+    {
+      int32_t lo = -xo, hi = xo;
+      limitSpan(endY, endX * dy - 1, &lo, &hi);
+      limitSpan(-startY, -startX * dy - 1, &lo, &hi);
+
+      if (lo <= hi)
+      {
+        sector[0][1] = lo - 1;
+        sector[1][0] = hi + 1;
+        sector[1][1] = xo;
+        sectors = 2;
+      }
+    }
+
+    for (int r = 0; r < rings; r++)
+    {
+      for (int s = 0; s < sectors; s++)
+      {
+        int32_t a = max(ring[r][0], sector[s][0]), b = min(ring[r][1], sector[s][1]);
+
+        if (a <= b)
+          rasterSpan(x + a, x + b, y + dy, color);
+      }
+    }
+  }
+
+  rasterEnd();
+}
+
+#if RA8875_ENABLE_STATS
+static const char *const s_statNames[RA8875_OP_COUNT] =
+{
+  "other", "init", "config", "clear", "text", "drawPixel", "pixels", "bitmap", "copy", "bteWrite", "pattern", "mono", "list", "sync",
+  "line", "rect", "fillRect", "triangle", "fillTriangle", "circle", "fillCircle",
+  "ellipse", "fillEllipse", "roundRect", "fillRoundRect", "raster"
+};
+
+const char *RA8875::getStatName(enum RA8875_Stat_Op op)
+{
+  return ((op >= 0) && (op < RA8875_OP_COUNT)) ? s_statNames[op] : "?";
+}
+
+void RA8875::resetStats(void)
+{
+  memset(m_stats, 0, sizeof(m_stats));
+}
+
+// Prints one line per call type that has been used, as space-separated key=value pairs.
+void RA8875::printStats(Print &p)
+{
+  for (int i = 0; i < RA8875_OP_COUNT; i++)
+  {
+    const RA8875_Op_Stats &st = m_stats[i];
+    if (!st.calls && !st.bytes)
+      continue;
+
+    p.print("op="); p.print(s_statNames[i]);
+    p.print(" calls="); p.print(st.calls);
+    p.print(" bytes="); p.print(st.bytes);
+    p.print(" cmd="); p.print(st.cmdCycles);
+    p.print(" data="); p.print(st.dataCycles);
+    p.print(" read="); p.print(st.readCycles);
+    p.print(" cs="); p.print(st.csToggles);
+    p.print(" trans="); p.print(st.transactions);
+    p.print(" waitUs="); p.println(st.waitMicros);
+  }
 }
+#endif
@@ -5,10 +5,23 @@
 
 #include <Arduino.h>
 #include <SPI.h>
+#include "NiftyRA8875Bus.h"
+#include "NiftyRA8875Convert.h"
 
 #define RA8875_PRINT_TIMING 0
 #define RA8875_ALLOW_TRACE 1
 
+// Per-call SPI cost counters. See getStats().
+// This and the other layout settings, which change the layout of class RA8875 or the structs
+//  passed to it (RA8875_BUS, RA8875_GLYPH_CACHE_SLOTS, RA8875_COMPOSITOR_RECTS,
+//  RA8875_CONSOLE_WORD), must be the same for the library as for the sketch. Edit them here, or
+//  define them for the whole build; a sketch that defines them before including this header fails
+//  to link (see RA8875_LAYOUT). The structs are filled in by the calls that take them, and a
+//  sketch only reads the fields each one's comment names.
+#ifndef RA8875_ENABLE_STATS
+# define RA8875_ENABLE_STATS 0
+#endif
+
 #if RA8875_ALLOW_TRACE
 # define RA8875_TRACE(fmt...) do { if (m_tracePrint) { char tracebuf[128]; snprintf(tracebuf, 128, fmt); m_tracePrint->println(tracebuf); } } while(false)
 #else
@@ -18,20 +31,56 @@
 //#define RGBPACK(r, g, b) ((((r) & 0x07) << 5) | (((g) & 0x07) << 2) | ((b) & 0x03))
 #define RGB332(r, g, b) (((r) & 0xE0) | (((g) & 0xE0) >> 3) | (((b) & 0xE0) >> 6))
 #define RGB565(r, g, b) ((((r) & 0xF8) << 8) | (((g) & 0xFC) << 3) | (((b) & 0xF8) >> 3))
+#define RGB565TO332(c) ((((c) >> 8) & 0xE0) | (((c) >> 6) & 0x1C) | (((c) >> 3) & 0x03))
 
-// TODO: Try 1MHz. What speed is the RA8875 capable of?
+// SPI clock.
 // Datasheet says:
 // --- snip ---
 // The maximum clock rate of 4-Wire SPI write SCL is system clock / 3 (i.e. SPI clock high duty
 //  must large than 1.5 system clock) and the maximum clock rate of 4-Wire SPI read SCL is system
 //  clock / 6.
 // --- snip ---
-// System clock (SYS_CLK) is set up by initPLL(). By default it is the same as the external
-//  crystal (presumed to be 20MHz), but can go as high as 60MHz.
-// The default of 20MHz / 6 is approximately 3MHz, so we wouldn't want to use a faster speed than
-//  that until the initPLL() step is completed. After initPLL() is done, we could conceivably try
-//  speeds as high as 9 or 10MHz.
-#define RA8875_SPI_SPEED 1000000
+// System clock (SYS_CLK) is set up by initPLL(). Until then it is the same as the external
+//  crystal (presumed to be 20MHz), and 20MHz / 6 is approximately 3MHz, so init() starts out at
+//  the safe speed below. Once the PLL is running, writes switch to SYS_CLK / 3 and reads to
+//  SYS_CLK / 6, or lower if capped with setSPIClock().
+#ifndef RA8875_SPI_SPEED
+# define RA8875_SPI_SPEED 1000000
+#endif
+
+// External crystal frequency assumed by the built-in panel table
+#ifndef RA8875_CRYSTAL_FREQ
+# define RA8875_CRYSTAL_FREQ 20000000
+#endif
+
+// Highest SYS_CLK the chip is rated for
+#ifndef RA8875_SYS_CLK_MAX
+# define RA8875_SYS_CLK_MAX 60000000
+#endif
+
+// Range the PLL's VCO (crystal * (PLLC1 + 1)) is kept in. Every configuration this library has
+//  been run with falls inside it.
+#ifndef RA8875_PLL_VCO_MIN
+# define RA8875_PLL_VCO_MIN 200000000
+#endif
+#ifndef RA8875_PLL_VCO_MAX
+# define RA8875_PLL_VCO_MAX 300000000
+#endif
+
+// Pixel data is packed into a buffer and sent with SPI.transfer(buf, n) where that pays off.
+// On AVR, the extra copy costs more than the per-byte calls it saves.
+#ifndef RA8875_BULK_SPI
+# if defined(__AVR__)
+#  define RA8875_BULK_SPI 0
+# else
+#  define RA8875_BULK_SPI 1
+# endif
+#endif
+
+// Size of the on-stack buffer used for bulk transfers, in bytes. Must be even.
+#ifndef RA8875_XFER_BUFFER_SIZE
+# define RA8875_XFER_BUFFER_SIZE 64
+#endif
 
 enum RA8875_Mode
 {
@@ -99,6 +148,240 @@ enum RA8875_External_Font_Family
 
 typedef uint8_t RA8875_Font_Flags;
 
+// How swapBuffers() times the flip to the vertical non-display period
+enum RA8875_Vsync_Mode
+{
+  RA8875_VSYNC_NONE,   // Flip straight away
+  RA8875_VSYNC_PIN,    // Wait for the panel's VSYNC line, wired to an input pin
+  RA8875_VSYNC_TIMED   // Estimate the frame position from the panel timings and the time the
+                       //  display was turned on, or VSYNC was last seen
+};
+
+// Source pixel formats for drawBitmap()
+enum RA8875_Bitmap_Format
+{
+  RA8875_BITMAP_RGB565,  // One uint16_t per pixel
+  RA8875_BITMAP_RGB332,  // One byte per pixel
+  RA8875_BITMAP_RGB888,  // Three bytes per pixel: R, G, B
+  RA8875_BITMAP_INDEX1,  // Palette indices, packed most significant bits first
+  RA8875_BITMAP_INDEX2,
+  RA8875_BITMAP_INDEX4,
+  RA8875_BITMAP_INDEX8
+};
+
+typedef uint8_t RA8875_Bitmap_Flags;
+
+#define RA8875_BITMAP_PROGMEM 0x01  // Pixels and palette are in flash
+
+// Pattern sizes. The chip holds sixteen 8x8 patterns or four 16x16 patterns in the same RAM, and
+//  the size applies to all of them.
+enum RA8875_Pattern_Size
+{
+  RA8875_PATTERN_8X8   = 0x00,
+  RA8875_PATTERN_16X16 = 0x80
+};
+
+// BTE raster operations: how each source pixel (S) combines with the destination pixel (D)
+enum RA8875_ROP
+{
+  RA8875_ROP_BLACK         = 0x0,  // 0
+  RA8875_ROP_NOR           = 0x1,  // ~(S | D)
+  RA8875_ROP_NOT_S_AND_D   = 0x2,  // ~S & D
+  RA8875_ROP_NOT_S         = 0x3,  // ~S
+  RA8875_ROP_S_AND_NOT_D   = 0x4,  // S & ~D
+  RA8875_ROP_NOT_D         = 0x5,  // ~D
+  RA8875_ROP_XOR           = 0x6,  // S ^ D
+  RA8875_ROP_NAND          = 0x7,  // ~(S & D)
+  RA8875_ROP_AND           = 0x8,  // S & D
+  RA8875_ROP_XNOR          = 0x9,  // ~(S ^ D)
+  RA8875_ROP_D             = 0xA,  // D, i.e. no change
+  RA8875_ROP_NOT_S_OR_D    = 0xB,  // ~S | D
+  RA8875_ROP_S             = 0xC,  // S, i.e. plain copy
+  RA8875_ROP_S_OR_NOT_D    = 0xD,  // S | ~D
+  RA8875_ROP_OR            = 0xE,  // S | D
+  RA8875_ROP_WHITE         = 0xF   // 1
+};
+
+// Proportional fonts for drawFontChar(), laid out like Adafruit GFX fonts so that fonts made with
+//  its fontconvert tool can be used as they are. If gfxfont.h has been included first, its types
+//  are used; otherwise, #define GFXglyph and GFXfont as the types below before including a font.
+// The glyph bitmaps are one bit per pixel, most significant bit first, with rows running on from
+//  one another without padding. The font, glyphs and bitmaps are all in flash.
+#ifdef _GFXFONT_H_
+typedef GFXglyph RA8875_Glyph;
+typedef GFXfont RA8875_Font;
+#else
+typedef struct
+{
+  uint16_t bitmapOffset;  // Offset of the glyph's bitmap in the font's bitmap array
+  uint8_t width;
+  uint8_t height;
+  uint8_t xAdvance;       // Distance to the next glyph's origin
+  int8_t xOffset;         // Top left of the bitmap, relative to the origin on the baseline
+  int8_t yOffset;
+} RA8875_Glyph;
+
+typedef struct
+{
+  uint8_t *bitmap;
+  RA8875_Glyph *glyph;
+  uint16_t first;         // Character codes covered
+  uint16_t last;
+  uint8_t yAdvance;       // Line spacing
+} RA8875_Font;
+#endif
+
+// Most glyphs a glyph cache can hold. Each takes 6 bytes of RAM in RA8875_Glyph_Cache.
+#ifndef RA8875_GLYPH_CACHE_SLOTS
+# define RA8875_GLYPH_CACHE_SLOTS 96
+#endif
+
+// Rows of cells the default glyph cache area holds, at the bottom of layer 2
+#ifndef RA8875_GLYPH_CACHE_ROWS
+# define RA8875_GLYPH_CACHE_ROWS 3
+#endif
+
+// Off-screen glyph cache for drawFontChar(): each glyph is drawn once, in its colour, into a cell
+//  of an unused area of display memory, and from then on copied into place with a transparent BTE
+//  move. The cells form a grid sized to the largest glyph in the font, and the least recently used
+//  one is reused when they're all full. See setGlyphCache(). hits and misses count lookups since
+//  then.
+// With an INT pin, a cached glyph costs about 17 SPI bytes at any size, against 23 at 6x8 and 256
+//  at 40x48 drawn directly; polling adds status reads while the move runs. Whether that's faster
+//  depends on the SPI clock. At 18 MHz the BTE move takes about as long as sending the glyph, so it
+//  only wins below 16x20. Capped at 8 MHz, as on a 16 MHz AVR, it wins at every size measured:
+//  46 rather than 85 us at 20x24. Draw text pipelined, so the next glyph's lookup overlaps each
+//  move. Figures are from extras/host/glyph_cache_bench at 480x272.
+struct RA8875_Glyph_Cache
+{
+  const RA8875_Font *font;  // Font the cells were sized for
+  uint8_t layer;
+  uint16_t x;               // Top left of the cache area
+  uint16_t y;
+  uint16_t width;
+  uint16_t height;
+  uint8_t cellWidth;
+  uint8_t cellHeight;
+  uint8_t columns;
+  uint8_t slotCount;        // Cells in use as slots
+  uint8_t filled;           // Slots holding a glyph, from the start
+  uint16_t clock;           // Advances on every lookup, for LRU
+
+  struct
+  {
+    uint16_t code;
+    uint16_t color;
+    uint16_t lastUsed;
+  } slots[RA8875_GLYPH_CACHE_SLOTS];
+
+  uint32_t hits;
+  uint32_t misses;
+};
+
+// Most damaged rectangles a compositor tracks between presents. Each takes 8 bytes of RAM in
+//  RA8875_Compositor. When they run out, the two that are cheapest to combine are merged.
+#ifndef RA8875_COMPOSITOR_RECTS
+# define RA8875_COMPOSITOR_RECTS 16
+#endif
+
+// Default cost of setting up one BTE copy, in the time it takes to copy this many pixels: about
+//  fourteen register writes at a typical SPI clock, plus the completion poll.
+#ifndef RA8875_COMPOSITOR_SETUP_COST
+# define RA8875_COMPOSITOR_SETUP_COST 512
+#endif
+
+// Rectangle with inclusive corners, as taken by fillRect()
+struct RA8875_Rect
+{
+  int16_t x1;
+  int16_t y1;
+  int16_t x2;
+  int16_t y2;
+};
+
+// Point, as taken by drawPolyline() and the other batch calls
+struct RA8875_Point
+{
+  int16_t x;
+  int16_t y;
+};
+
+// Damage tracking for drawing into layer 2 as a back buffer. Drawing calls that target layer 2
+//  record the rectangle they touch, and present() copies just those areas to layer 1. See
+//  setCompositor(). copies and copiedPixels tell what the last present() sent.
+struct RA8875_Compositor
+{
+  uint32_t setupCost;  // Cost of one copy, in pixels. Rects merge when that's no dearer.
+  uint8_t count;
+  RA8875_Rect rects[RA8875_COMPOSITOR_RECTS];
+
+  // Last present()
+  uint8_t copies;
+  uint32_t copiedPixels;
+};
+
+// Longest word a console moves down to the next row whole when word wrapping. Longer words are
+//  broken at the right edge.
+#ifndef RA8875_CONSOLE_WORD
+# define RA8875_CONSOLE_WORD 24
+#endif
+
+// A scrolling text area for Print output, drawn in the scroll window. Rows are laid out in display
+//  memory as a ring, and the vertical scroll offset picks which one shows at the top, so scrolling
+//  clears one row instead of redrawing the rest. See setConsole(). scrolls counts the rows
+//  scrolled since then; with scrollback, viewBack is how many rows the view is scrolled back, and
+//  historyCount how many rows the scrollback holds.
+struct RA8875_Console
+{
+  int16_t x1;          // Window, inclusive, a whole number of rows high
+  int16_t y1;
+  int16_t x2;
+  int16_t y2;
+  int16_t rowHeight;
+  int16_t ascent;      // Baseline within a row, for proportional fonts
+  int16_t rows;
+  int16_t top;         // Row of memory shown at the top of the window
+  int16_t row;         // Row being written, from the top of the window
+  int16_t penX;        // Where the next character goes
+  uint16_t background;
+  bool wordWrap;
+
+  // Word being written, in case it has to move down a row
+  int16_t wordX;
+  uint8_t wordLength;
+  char word[RA8875_CONSOLE_WORD];
+
+  // Scrollback, if any: a ring of rows, each historyColumns characters, NUL padded
+  char *history;
+  uint16_t historyRows;
+  uint16_t historyColumns;
+  uint16_t historyLast;    // Row being written
+  uint16_t historyCount;   // Rows in use, including that one
+  uint16_t historyColumn;
+  uint16_t viewBack;       // Rows scrolled back, 0 when showing the latest
+
+  uint32_t scrolls;
+};
+
+// Software-rasterised shapes go out as horizontal spans. Solid spans at least this long are drawn
+//  by the draw engine as one-row lines; shorter ones, and anti-aliased ones, are written as pixels
+//  in a single MRWC burst. With the line registers shadowed, the next row's line usually only needs
+//  its Y registers written, so the engine wins from two pixels up (see extras/host/raster_bench).
+#ifndef RA8875_SPAN_FILL_MIN
+# define RA8875_SPAN_FILL_MIN 2
+#endif
+
+// Most edges fillComplexPolygon() finds crossing one row. Beyond that, the rest of the row is
+//  left out.
+#ifndef RA8875_RASTER_CROSSINGS
+# define RA8875_RASTER_CROSSINGS 16
+#endif
+
+// Longest run of pixels the rasteriser buffers on the stack before writing it
+#ifndef RA8875_SPAN_PIXELS
+# define RA8875_SPAN_PIXELS 32
+#endif
+
 // Dimensions of the built-in ROM font
 #define RA8875_ROM_TEXT_WIDTH  8
 #define RA8875_ROM_TEXT_HEIGHT 16
@@ -226,6 +509,15 @@ typedef uint8_t RA8875_Font_Flags;
 #define RA8875_REG_DCVR0  0x9B  // Draw Circle Vertical Register 0
 #define RA8875_REG_DCVR1  0x9C  // Draw Circle Vertical Register 1
 #define RA8875_REG_DCRR   0x9D  // Draw Cricle Radius Register
+#define RA8875_REG_ELLCR  0xA0  // Draw Ellipse/Ellipse Curve/Circle Square Control Register
+#define RA8875_REG_ELLA0  0xA1  // Draw Ellipse/Circle Square Long axis Setting Register 0
+#define RA8875_REG_ELLA1  0xA2  // Draw Ellipse/Circle Square Long axis Setting Register 1
+#define RA8875_REG_ELLB0  0xA3  // Draw Ellipse/Circle Square Short axis Setting Register 0
+#define RA8875_REG_ELLB1  0xA4  // Draw Ellipse/Circle Square Short axis Setting Register 1
+#define RA8875_REG_DEHR0  0xA5  // Draw Ellipse/Circle Square Center Horizontal Address Register 0
+#define RA8875_REG_DEHR1  0xA6  // Draw Ellipse/Circle Square Center Horizontal Address Register 1
+#define RA8875_REG_DEVR0  0xA7  // Draw Ellipse/Circle Square Center Vertical Address Register 0
+#define RA8875_REG_DEVR1  0xA8  // Draw Ellipse/Circle Square Center Vertical Address Register 1
 #define RA8875_REG_DTPH0  0xA9  // Draw Triangle Point Horizontal Register 0
 #define RA8875_REG_DTPH1  0xAA  // Draw Triangle Point Horizontal Register 1
 #define RA8875_REG_DTPV0  0xAB  // Draw Triangle Point Vertical Register 0
@@ -241,6 +533,243 @@ typedef uint8_t RA8875_Font_Flags;
 #define RA8875_REG_INTC1  0xF0  // Interrupt control register 1
 #define RA8875_REG_INTC2  0xF1  // Interrupt control register 2
 
+// Interrupt source bits, as used in INTC1 (enable) and INTC2 (status/clear)
+#define RA8875_INT_BTE     0x02  // BTE process complete
+#define RA8875_INT_TOUCH   0x04  // Touch panel
+#define RA8875_INT_DMA     0x08  // DMA transfer complete
+#define RA8875_INT_KEYSCAN 0x10  // Key scan
+
+// How long to wait on the INT pin before falling back to polling, in milliseconds
+#define RA8875_INT_TIMEOUT 100
+
+// Call types that SPI costs are accounted to
+enum RA8875_Stat_Op
+{
+  RA8875_OP_OTHER,
+  RA8875_OP_INIT,
+  RA8875_OP_CONFIG,         // Register setters: fonts, windows, layers, backlight
+  RA8875_OP_CLEAR,          // clearMemory()
+  RA8875_OP_TEXT,           // write(), putChars(), cursor
+  RA8875_OP_DRAW_PIXEL,     // drawPixel()
+  RA8875_OP_PIXELS,         // setDrawPosition(), pushPixel(), pixel streaming
+  RA8875_OP_BITMAP,         // drawBitmap()
+  RA8875_OP_COPY,           // copy(), copyToScreen(), copyFromScreen()
+  RA8875_OP_BTE_WRITE,      // bteWrite(), bteWriteTransparent()
+  RA8875_OP_PATTERN,        // uploadPattern(), fillRectPattern()
+  RA8875_OP_MONO,           // drawMono(), drawFontChar(), drawFontString()
+  RA8875_OP_LIST,           // beginRecording(), endRecording(), playDisplayList()
+  RA8875_OP_SYNC,           // sync()
+  RA8875_OP_LINE,
+  RA8875_OP_RECT,
+  RA8875_OP_FILL_RECT,
+  RA8875_OP_TRIANGLE,
+  RA8875_OP_FILL_TRIANGLE,
+  RA8875_OP_CIRCLE,
+  RA8875_OP_FILL_CIRCLE,
+  RA8875_OP_ELLIPSE,        // drawEllipse(), drawCurve()
+  RA8875_OP_FILL_ELLIPSE,   // fillEllipse(), fillCurve()
+  RA8875_OP_ROUND_RECT,
+  RA8875_OP_FILL_ROUND_RECT,
+  RA8875_OP_RASTER,         // drawThickLine(), drawLineAA(), drawArc(), fillComplexPolygon()
+  RA8875_OP_COUNT
+};
+
+struct RA8875_Op_Stats
+{
+  uint32_t calls;
+  uint32_t bytes;         // All SPI bytes, including cycle type bytes
+  uint32_t cmdCycles;
+  uint32_t dataCycles;    // A pixel stream counts as one data cycle
+  uint32_t readCycles;    // Data and status reads
+  uint32_t csToggles;     // CS assertions
+  uint32_t transactions;  // SPI transactions begun
+  uint32_t waitMicros;    // Time spent polling for the chip
+};
+
+#if RA8875_ENABLE_STATS
+# define RA8875_STATS_OP(op) StatScope statScope(this, op)
+# define RA8875_STATS_ADD(field, n) (m_stats[m_statOp].field += (n))
+# define RA8875_STATS_WAIT_BEGIN() uint32_t statWaitStart = micros()
+# define RA8875_STATS_WAIT_END() RA8875_STATS_ADD(waitMicros, micros() - statWaitStart)
+#else
+# define RA8875_STATS_OP(op)
+# define RA8875_STATS_ADD(field, n)
+# define RA8875_STATS_WAIT_BEGIN()
+# define RA8875_STATS_WAIT_END()
+#endif
+
+// Describes a panel: its size, the clocks to drive it with, and its sync timings. Horizontal
+//  values are in pixels and vertical values in lines, as in panel datasheets. init() computes the
+//  PLL settings and timing registers from this.
+struct RA8875_Panel
+{
+  uint16_t width;
+  uint16_t height;
+
+  uint32_t crystal;   // External crystal, Hz
+  uint32_t sysClock;  // Wanted SYS_CLK, Hz. The PLL gets as close as it can without going over.
+  uint8_t pcsr;       // PCSR: bit 7 fetches PDAT on the falling edge, bits 1-0 divide SYS_CLK for PCLK
+
+  uint16_t hNonDisplay;  // Horizontal back porch. Multiple of 8
+  uint16_t hSyncStart;   // Horizontal front porch. Multiple of 8
+  uint16_t hSyncWidth;   // HSYNC pulse width. Multiple of 8
+  uint16_t vNonDisplay;  // Vertical back porch
+  uint16_t vSyncStart;   // Vertical front porch
+  uint16_t vSyncWidth;   // VSYNC pulse width
+};
+
+// Completion condition for an operation started on the draw engine or BTE
+enum RA8875_Engine_Wait
+{
+  RA8875_WAIT_NONE,
+  RA8875_WAIT_DRAW,    // Line, rect or triangle: DCR bit 7
+  RA8875_WAIT_CIRCLE,  // Circle: DCR bit 6
+  RA8875_WAIT_BTE,     // Block transfer: status bit 6
+  RA8875_WAIT_ELLIPSE  // Ellipse, curve or rounded rect: ELLCR bit 7
+};
+
+// Quarter of an ellipse drawn by drawCurve() and fillCurve(), in ELLCR's numbering
+enum RA8875_Curve_Part
+{
+  RA8875_CURVE_LOWER_LEFT,
+  RA8875_CURVE_UPPER_LEFT,
+  RA8875_CURVE_UPPER_RIGHT,
+  RA8875_CURVE_LOWER_RIGHT
+};
+
+// Slots in the shadow register cache. Multi-byte registers occupy consecutive slots, low byte first.
+enum RA8875_Shadow_Reg
+{
+  RA8875_SHADOW_PWRR,
+  RA8875_SHADOW_DPCR,
+  RA8875_SHADOW_FNCR0,
+  RA8875_SHADOW_FNCR1,
+  RA8875_SHADOW_FWTSR,
+  RA8875_SHADOW_SFRS,
+  RA8875_SHADOW_HSAW0,
+  RA8875_SHADOW_HSAW1,
+  RA8875_SHADOW_VSAW0,
+  RA8875_SHADOW_VSAW1,
+  RA8875_SHADOW_HEAW0,
+  RA8875_SHADOW_HEAW1,
+  RA8875_SHADOW_VEAW0,
+  RA8875_SHADOW_VEAW1,
+  RA8875_SHADOW_HSSW0,
+  RA8875_SHADOW_HSSW1,
+  RA8875_SHADOW_VSSW0,
+  RA8875_SHADOW_VSSW1,
+  RA8875_SHADOW_HESW0,
+  RA8875_SHADOW_HESW1,
+  RA8875_SHADOW_VESW0,
+  RA8875_SHADOW_VESW1,
+  RA8875_SHADOW_HOFS0,
+  RA8875_SHADOW_HOFS1,
+  RA8875_SHADOW_VOFS0,
+  RA8875_SHADOW_VOFS1,
+  RA8875_SHADOW_MWCR0,
+  RA8875_SHADOW_MWCR1,
+  RA8875_SHADOW_LTPR0,
+  RA8875_SHADOW_LTPR1,
+  RA8875_SHADOW_BGCR0,
+  RA8875_SHADOW_BGCR1,
+  RA8875_SHADOW_BGCR2,
+  RA8875_SHADOW_FGCR0,
+  RA8875_SHADOW_FGCR1,
+  RA8875_SHADOW_FGCR2,
+  RA8875_SHADOW_BECR1,
+  RA8875_SHADOW_HSBE0,
+  RA8875_SHADOW_HSBE1,
+  RA8875_SHADOW_VSBE0,
+  RA8875_SHADOW_VSBE1,
+  RA8875_SHADOW_HDBE0,
+  RA8875_SHADOW_HDBE1,
+  RA8875_SHADOW_VDBE0,
+  RA8875_SHADOW_VDBE1,
+  RA8875_SHADOW_BEWR0,
+  RA8875_SHADOW_BEWR1,
+  RA8875_SHADOW_BEHR0,
+  RA8875_SHADOW_BEHR1,
+  RA8875_SHADOW_DLHSR0,
+  RA8875_SHADOW_DLHSR1,
+  RA8875_SHADOW_DLVSR0,
+  RA8875_SHADOW_DLVSR1,
+  RA8875_SHADOW_DLHER0,
+  RA8875_SHADOW_DLHER1,
+  RA8875_SHADOW_DLVER0,
+  RA8875_SHADOW_DLVER1,
+  RA8875_SHADOW_DCHR0,
+  RA8875_SHADOW_DCHR1,
+  RA8875_SHADOW_DCVR0,
+  RA8875_SHADOW_DCVR1,
+  RA8875_SHADOW_DCRR,
+  RA8875_SHADOW_DTPH0,
+  RA8875_SHADOW_DTPH1,
+  RA8875_SHADOW_DTPV0,
+  RA8875_SHADOW_DTPV1,
+  RA8875_SHADOW_ELLA0,
+  RA8875_SHADOW_ELLA1,
+  RA8875_SHADOW_ELLB0,
+  RA8875_SHADOW_ELLB1,
+  RA8875_SHADOW_DEHR0,
+  RA8875_SHADOW_DEHR1,
+  RA8875_SHADOW_DEVR0,
+  RA8875_SHADOW_DEVR1,
+  RA8875_SHADOW_COUNT
+};
+
+// Display lists hold the register writes, data and waits that a sequence of calls produced, so
+//  they can be sent again without working any of it out. A list starts with a header of
+//  RA8875_DL_VERSION, RA8875_SHADOW_COUNT and the colour depth, and ends with RA8875_DL_END.
+//  Runs of register writes keep the first register, and the count in the op byte itself, and
+//  repeat for consecutive registers; pixel runs have a 16-bit length, low byte first. Cursor
+//  positions are 16-bit x then y, low bytes first.
+#define RA8875_DL_VERSION 2
+#define RA8875_DL_HEADER  3
+
+#define RA8875_DL_RUN_MAX 63     // Most values in one register run
+
+enum RA8875_DL_Op
+{
+  RA8875_DL_END,
+  RA8875_DL_CMD,         // Register, selected without a write
+  RA8875_DL_DATA,        // Count, data cycles
+  RA8875_DL_TEXT,        // Count, characters, each waiting for the one before
+  RA8875_DL_PIXELS,      // Length, bytes in one data burst
+  RA8875_DL_WAIT,        // RA8875_Engine_Wait
+  RA8875_DL_WAIT_BUSY,   // Poll the status register
+  RA8875_DL_WAIT_TEXT,   // Wait for the last character
+  RA8875_DL_WAIT_CLEAR,  // Poll MCLR
+  RA8875_DL_CURSOR,      // Position, for a text cursor move from wherever it was
+  RA8875_DL_CURSOR_AT,   // Position the text cursor has been left at, with nothing sent
+  RA8875_DL_REG    = 0x40,  // Plus the count: first register, values
+  RA8875_DL_SHADOW = 0x80   // Plus the count: first shadow cache slot, values
+};
+
+// A display list being recorded. See beginRecording().
+struct RA8875_Recorder
+{
+  uint8_t *buffer;
+  size_t size;
+  size_t length;
+  size_t run;        // Offset of the run that can still be extended, or 0
+  int16_t cmd;       // Register selected by a command cycle with no data yet, or -1
+  int8_t shadow;     // Shadow cache slot of the register being written, or -1
+  bool text;         // The next data cycle is a character
+  bool waitText;     // A character wait is due before whatever comes next
+  bool overflow;
+  uint8_t known[(RA8875_SHADOW_COUNT + 7) / 8];  // Shadow cache slots written since recording began
+};
+
+// A symbol named after the layout settings, defined only by the library. Every RA8875 built by a
+//  sketch refers to the one named after the sketch's settings, so a sketch whose settings differ
+//  from the library's fails to link instead of corrupting memory.
+#define RA8875_LAYOUT_NAME(bus, stats, glyphs, rects, word) ra8875_layout_##bus##_##stats##_##glyphs##_##rects##_##word
+#define RA8875_LAYOUT_EXPAND(bus, stats, glyphs, rects, word) RA8875_LAYOUT_NAME(bus, stats, glyphs, rects, word)
+#define RA8875_LAYOUT \
+  RA8875_LAYOUT_EXPAND(RA8875_BUS, RA8875_ENABLE_STATS, RA8875_GLYPH_CACHE_SLOTS, RA8875_COMPOSITOR_RECTS, RA8875_CONSOLE_WORD)
+
+extern const uint8_t RA8875_LAYOUT;
+
 class RA8875 : public Print
 {
 private:
@@ -252,46 +781,203 @@ private:
   int m_height;
   int m_depth;
 
+  RA8875_Panel m_panel;
+  enum RA8875_Pattern_Size m_patternSize;
+
   uint16_t m_textColor;
+  const RA8875_Font *m_font;
+
+  // ROM font text. The cursor is tracked here while its position is known, so printing needs no
+  //  register reads. Text mode is left on after printing, until the next call that isn't text.
+  int m_cursorX;
+  int m_cursorY;
+  bool m_cursorValid;
+  int m_cmdReg;             // Register selected by the last command cycle, or -1
+  int m_textCellWidth;      // Character cell, scaled
+  int m_textCellHeight;
+  bool m_textFixed;         // False for the proportional external ROM fonts
+  bool m_textPending;       // A character may still be being drawn
+  RA8875_Glyph_Cache *m_glyphCache;
+  RA8875_Compositor *m_compositor;
+  RA8875_Console *m_console;
+  RA8875_Recorder *m_recorder;
+
+  // Double buffering
+  int m_frontLayer;  // 0 until beginFrame()
+  enum RA8875_Vsync_Mode m_vsyncMode;
+  int m_vsyncPin;
+  uint32_t m_frameStart;  // micros() at the start of some frame
 
-  SPISettings m_spiSettings;
+  RA8875_BUS m_bus;
+
+  // SPI clocks. Reads must be slower than writes, so read cycles switch the bus over to the read
+  //  clock and the next command write switches it back.
+  uint32_t m_sysClock;
+  bool m_pllReady;
+  uint32_t m_writeClockLimit;
+  uint32_t m_readClockLimit;
+  uint32_t m_writeClock;
+  uint32_t m_readClock;
+  SPISettings m_writeSettings;
+  SPISettings m_readSettings;
+  bool m_splitClocks;  // Read and write clocks differ
+  bool m_readActive;   // Bus is currently at the read clock
 
   Print *m_tracePrint;
 
+  bool m_pipelined;
+  enum RA8875_Engine_Wait m_pendingWait;
+
+#if RA8875_ENABLE_STATS
+  RA8875_Op_Stats m_stats[RA8875_OP_COUNT];
+  enum RA8875_Stat_Op m_statOp;
+
+  // Accounts everything up to the end of the scope to a call type. Nested public calls are
+  //  accounted to the outermost one.
+  class StatScope
+  {
+  private:
+    RA8875 *m_owner;
+    enum RA8875_Stat_Op m_saved;
+  public:
+    StatScope(RA8875 *owner, enum RA8875_Stat_Op op) : m_owner(owner), m_saved(owner->m_statOp)
+    {
+      if (m_saved == RA8875_OP_OTHER)
+      {
+        m_owner->m_statOp = op;
+        m_owner->m_stats[op].calls++;
+      }
+    };
+    ~StatScope() { m_owner->m_statOp = m_saved; };
+  };
+#endif
+
+  // Last value written to each register in the shadow cache
+  static const uint8_t s_shadowRegs[RA8875_SHADOW_COUNT];
+  uint8_t m_shadow[RA8875_SHADOW_COUNT];
+
   void hardReset(void);
   void softReset(void);
 
   void writeCmd(uint8_t x);
   void writeData(uint8_t x);
+  void writePixelData(uint16_t color);
   uint8_t readData(void);
   uint8_t readStatus(void);
 
   void writeReg(uint8_t reg, uint8_t x);
   uint8_t readReg(uint8_t reg);
 
-  inline void waitBusy(void) { while (readStatus() & 0xC0); };
+  void writeShadowReg(enum RA8875_Shadow_Reg index, uint8_t x);
+  void writeShadowReg16(enum RA8875_Shadow_Reg index, uint16_t x);
+  uint8_t readShadowReg(enum RA8875_Shadow_Reg index) { return m_shadow[index]; };
+  uint16_t readShadowReg16(enum RA8875_Shadow_Reg index) { return m_shadow[index] | (m_shadow[index + 1] << 8); };
+
+  void setForegroundColor(uint16_t color);
+  void setDrawPoint(enum RA8875_Shadow_Reg index, int x, int y) { writeShadowReg16(index, x); writeShadowReg16((enum RA8875_Shadow_Reg) (index + 2), y); };
+
+  inline void waitBusy(void) { if (m_recorder) recordWait(RA8875_DL_WAIT_BUSY, -1); RA8875_STATS_WAIT_BEGIN(); while (readStatus() & 0xC0); RA8875_STATS_WAIT_END(); };
+  void waitClear(void);
+
+  void waitEngine(enum RA8875_Engine_Wait wait);
+  void finishEngine(enum RA8875_Engine_Wait wait);
+  bool waitInterrupt(uint8_t source);
+  void syncEngine(void);
+
+  // Every transaction starts at the write clock. Anything but text also leaves text mode. A
+  //  pipelined engine operation is waited for by the first register access.
+  inline void beginBusTransaction(void) { m_bus.beginTransaction(m_writeSettings); m_readActive = false; };
+  inline void beginTextTransaction(void) { RA8875_STATS_ADD(transactions, 1); beginBusTransaction(); };
+  inline void beginTransaction(void) { beginTextTransaction(); if (m_shadow[RA8875_SHADOW_MWCR0] & 0x80) setGraphicsMode(); };
+  inline void endTransaction(void) { m_bus.endTransaction(); };
+
+  void setBusClock(bool read);
+  void updateClocks(void);
+
+  void startMemoryWrite(int x, int y);
+  void beginPixelData(void);
+  void setForegroundPixel(uint16_t pixel);
+  void setBackgroundPixel(uint16_t pixel);
+  void splitPixel(uint16_t pixel, uint8_t *r, uint8_t *g, uint8_t *b);
+  void drawMonoBits(int x, int y, int width, int height, int layer, const uint8_t *bits, size_t rowBits, bool transparent, bool flash);
+  void resetGlyphCache(void);
+
+  inline void markDamage(int layer, int x1, int y1, int x2, int y2) { if (m_compositor && (layer == 2)) addDamage(x1, y1, x2, y2); };
+  // Whether a layer is all in use as a frame buffer, so nothing else can be kept in it
+  inline bool isBufferLayer(int layer) { return (m_frontLayer != 0) || (m_compositor && (layer == 2)); };
+  void markWindowDamage(int y);
+
+  uint32_t getLineNanos(void);
+  void waitVsync(void);
+  int findGlyphSlot(uint8_t c, uint16_t color, const RA8875_Glyph &glyph, const uint8_t *bitmap);
+  void fillPattern(int x, int y, int width, int height, int patternNo, uint8_t becr1);
+  void bteWritePixels(int x, int y, int width, int height, int layer, uint8_t becr1, const uint16_t *pixels);
+  void convertBitmap(uint16_t *dst, const uint8_t *row, int first, int count, enum RA8875_Bitmap_Format format, const uint16_t *palette, bool flash);
 
   void setTextMode(void);
   void setGraphicsMode(void);
+  void updateTextMetrics(void);
+  void waitText(void);
+  void putText(uint8_t c);
+  void newLine(void);
+  void moveTextCursor(int x, int y);
+  void readTextCursor(void);
+
+  int consoleAdvance(uint8_t c);
+  int consoleRowY(int row) { return m_console->y1 + ((m_console->top + row) % m_console->rows) * m_console->rowHeight; };
+  void consoleWrite(uint8_t c);
+  void consoleDraw(uint8_t c, bool record);
+  void consoleNewLine(void);
+  void renderConsole(void);
+
+  void recordByte(uint8_t x);
+  void recordRun(uint8_t op, int first, uint8_t x);
+  void recordCmd(uint8_t reg);
+  void recordData(uint8_t x);
+  void recordPixels(const uint8_t *bytes, size_t count);
+  void recordWait(uint8_t op, int arg);
+  void recordCursor(uint8_t op, int x, int y);
+  void recordPending(void);
+
+  void rasterBegin(int x1, int y1, int x2, int y2);
+  void rasterSpan(int x1, int x2, int y, uint16_t color);
+  void rasterPixels(int x, int y, const uint16_t *pixels, int count);
+  void rasterEnd(void);
+  template <typename Point> void rasterPolygon(const Point *points, const uint16_t *counts, int contours, int shift, uint16_t color);
+
+  static const RA8875_Panel s_panels[];
 
   bool initPLL(void);
   bool initDisplay(void);
+
+  RA8875(const uint8_t *layout, int csPin, int resetPin, int intPin);
 public:
-  RA8875(int csPin, int resetPin = -1);
+  RA8875(int csPin, int resetPin = -1, int intPin = -1) : RA8875(&RA8875_LAYOUT, csPin, resetPin, intPin) {};
 
   // Init
   bool init(int width, int height, int depth);
+  bool init(const RA8875_Panel &panel, int depth);
   void initExternalFontRom(int spiIf, enum RA8875_External_Font_Rom chip);
+  void resyncRegisters(void);
 
   void clearMemory();
   void setBacklight(bool enabled);
-  
+
+  // SPI clocks
+  void setSPIClock(uint32_t writeHz, uint32_t readHz = 0);
+  uint32_t getSPIWriteClock(void) { return m_writeClock; };
+  uint32_t getSPIReadClock(void) { return m_readClock; };
+  uint32_t getSysClock(void) { return m_sysClock; };
+
   void setActiveWindow(int xStart, int xEnd, int yStart, int yEnd);
 
   // Dimensions
   int getWidth() { return m_width; };
   int getHeight() { return m_height; };
 
+  // Layers that fit in display memory: one at 16bpp wider than 480 pixels, otherwise two
+  int getLayerCount(void) { return ((m_depth == 16) && (m_width > 480)) ? 1 : 2; };
+
   // Text cursor
   void setCursor(int x, int y);
   int getCursorX(void);
@@ -325,15 +1011,51 @@ public:
   void setScrollWindow(int xStart, int xEnd, int yStart, int yEnd);
   void setScrollOffset(int x, int y);
 
+  // Display lists
+  void beginRecording(RA8875_Recorder *recorder, uint8_t *buffer, size_t size);
+  size_t endRecording(void);
+  bool playDisplayList(const uint8_t *list, bool progmem = false);
+
+  // Console: Print output scrolls up within a window
+  bool setConsole(RA8875_Console *console, int x1, int y1, int x2, int y2, uint16_t background);
+  void endConsole(void);
+  void setConsoleWordWrap(bool enabled);
+  void setConsoleScrollback(char *buffer, int rows, int columns);
+  void clearConsole(void);
+  int scrollConsoleBack(int rows);
+
   // Layers
   void setLayerMode(enum RA8875_Layer_Mode mode);
   void setDrawLayer(int layer);
+  int getDrawLayer(void) { return (readShadowReg(RA8875_SHADOW_MWCR1) & 0x01) + 1; };
+
+  // Back buffer compositing
+  bool setCompositor(RA8875_Compositor *compositor, uint32_t setupCost = RA8875_COMPOSITOR_SETUP_COST);
+  void addDamage(int x1, int y1, int x2, int y2);
+  void addDamageAll(void) { addDamage(0, 0, m_width - 1, m_height - 1); };
+  void present(void);
+
+  // Double buffering: draw into the hidden layer, then show it
+  void setVsync(enum RA8875_Vsync_Mode mode, int pin = -1);
+  bool beginFrame(void);
+  bool swapBuffers(void);
+  int getFrontLayer(void) { return m_frontLayer; };
+  uint32_t getFramePeriod(void);
 
   // Drawing
   void drawPixel(int x, int y, uint16_t color);
   void setDrawPosition(int x, int y);
   void pushPixel(uint16_t color);
 
+  // Pixel streaming
+  void beginPixels(int x, int y);
+  void pushPixels(const uint16_t *pixels, size_t count);
+  void pushPixelBytes(const uint8_t *bytes, size_t count);
+  void endPixels(void);
+
+  // Bitmaps
+  void drawBitmap(int x, int y, int width, int height, const void *src, size_t stride, enum RA8875_Bitmap_Format format, const uint16_t *palette = NULL, RA8875_Bitmap_Flags flags = 0);
+
   // Block transfer
   void copyToScreen(int srcX, int srcY, int width, int height, int dstX, int dstY) { copyToScreen(srcX, srcY, width, height, dstX, dstY, false, 0); };
   void copyToScreen(int srcX, int srcY, int width, int height, int dstX, int dstY, bool transparent, uint8_t bgColor);
@@ -341,10 +1063,41 @@ public:
   void copy(int srcLayer, int srcX, int srcY, int width, int height, int dstLayer, int dstX, int dstY) { copy(srcLayer, srcX, srcY, width, height, dstLayer, dstX, dstY, false, 0); };
   void copy(int srcLayer, int srcX, int srcY, int width, int height, int dstLayer, int dstX, int dstY, bool transparent, uint8_t bgColor);
 
+  // Block transfer from the MCU. Pixels are in the same format as for pushPixels().
+  void bteWrite(int x, int y, int width, int height, int layer, enum RA8875_ROP rop, const uint16_t *pixels);
+  void bteWriteTransparent(int x, int y, int width, int height, int layer, uint16_t key, const uint16_t *pixels);
+
+  // Pattern fills
+  void uploadPattern(int patternNo, enum RA8875_Pattern_Size size, const uint16_t *pixels);
+  void fillRectPattern(int x, int y, int width, int height, int patternNo, enum RA8875_ROP rop = RA8875_ROP_S);
+  void fillRectPatternTransparent(int x, int y, int width, int height, int patternNo, uint16_t key);
+
+  // 1bpp images, expanded to colours by the BTE
+  void drawMono(int x, int y, int width, int height, const uint8_t *bits, uint16_t fg, uint16_t bg, bool transparent = false, RA8875_Bitmap_Flags flags = 0);
+
+  // Proportional fonts. Text is drawn with the origin of the first character at x, on the baseline
+  //  at y, leaving the background as it is.
+  void setFont(const RA8875_Font *font) { m_font = font; };
+  const RA8875_Font *getFont(void) { return m_font; };
+  int drawFontChar(int x, int y, uint8_t c, uint16_t color);
+  int drawFontString(int x, int y, const char *str, uint16_t color);
+  int getFontStringWidth(const char *str);
+
+  // Glyph cache for proportional fonts
+  bool setGlyphCache(RA8875_Glyph_Cache *cache);
+  bool setGlyphCache(RA8875_Glyph_Cache *cache, int layer, int x, int y, int width, int height);
+
+  // Pipelining
+  void setPipelined(bool enabled);
+  bool getPipelined(void) { return m_pipelined; };
+  void sync(void);
+
   // Low-level shapes
   void drawTwoPointShape(int x1, int y1, int x2, int y2, uint16_t color, uint8_t cmd);
   void drawThreePointShape(int x1, int y1, int x2, int y2, int x3, int y3, uint16_t color, uint8_t cmd);
   void drawCircleShape(int x, int y, int radius, uint16_t color, uint8_t cmd);
+  void drawEllipseShape(int x, int y, int xRadius, int yRadius, uint16_t color, uint8_t cmd);
+  void drawRoundRectShape(int x1, int y1, int x2, int y2, int xRadius, int yRadius, uint16_t color, uint8_t cmd);
 
   // Shapes
   void drawRect(int x1, int y1, int x2, int y2, uint16_t color) { drawTwoPointShape(x1, y1, x2, y2, color, 0x10); };
@@ -354,9 +1107,153 @@ public:
   void fillTriangle(int x1, int y1, int x2, int y2, int x3, int y3, uint16_t color) { drawThreePointShape(x1, y1, x2, y2, x3, y3, color, 0x21); };
   void drawCircle(int x, int y, int radius, uint16_t color) { drawCircleShape(x, y, radius, color, 0x00); };
   void fillCircle(int x, int y, int radius, uint16_t color) { drawCircleShape(x, y, radius, color, 0x20); };
+  void drawEllipse(int x, int y, int xRadius, int yRadius, uint16_t color) { drawEllipseShape(x, y, xRadius, yRadius, color, 0x00); };
+  void fillEllipse(int x, int y, int xRadius, int yRadius, uint16_t color) { drawEllipseShape(x, y, xRadius, yRadius, color, 0x40); };
+  void drawCurve(int x, int y, int xRadius, int yRadius, enum RA8875_Curve_Part part, uint16_t color) { drawEllipseShape(x, y, xRadius, yRadius, color, 0x10 | part); };
+  void fillCurve(int x, int y, int xRadius, int yRadius, enum RA8875_Curve_Part part, uint16_t color) { drawEllipseShape(x, y, xRadius, yRadius, color, 0x50 | part); };
+  void drawRoundRect(int x1, int y1, int x2, int y2, int radius, uint16_t color) { drawRoundRectShape(x1, y1, x2, y2, radius, radius, color, 0x20); };
+  void fillRoundRect(int x1, int y1, int x2, int y2, int radius, uint16_t color) { drawRoundRectShape(x1, y1, x2, y2, radius, radius, color, 0x60); };
+
+  // Batches of shapes in one colour, sent in one transaction
+  void drawLines(const RA8875_Point *points, size_t count, uint16_t color);
+  void drawPolyline(const RA8875_Point *points, size_t count, uint16_t color);
+  void fillPolygon(const RA8875_Point *points, size_t count, uint16_t color);
+  void fillRects(const RA8875_Rect *rects, size_t count, uint16_t color);
+
+  // Software-rasterised shapes, sent as runs of pixels or one-row lines
+  void drawThickLine(int x1, int y1, int x2, int y2, int width, uint16_t color);
+  void drawLineAA(int x1, int y1, int x2, int y2, uint16_t color, uint16_t background);
+  void drawArc(int x, int y, int radius, int width, int startAngle, int endAngle, uint16_t color);
+  void fillComplexPolygon(const RA8875_Point *points, const uint16_t *counts, int contours, uint16_t color);
 
   // Debug trace
   void setTrace(Print *p) { m_tracePrint = p; };
+
+  // Bus access, e.g. for attaching a device to RA8875_RecordingBus
+  RA8875_BUS &getBus(void) { return m_bus; };
+
+#if RA8875_ENABLE_STATS
+  // SPI cost counters
+  const RA8875_Op_Stats &getStats(enum RA8875_Stat_Op op) { return m_stats[op]; };
+  void resetStats(void);
+  void printStats(Print &p);
+  static const char *getStatName(enum RA8875_Stat_Op op);
+#endif
 };
 
+// Low-level cycles are defined here so they can be inlined into their callers.
+
+// Each cycle is a type byte followed by one byte of payload. Register cycles can't be merged
+//  into longer bursts, since every cycle needs its own CS assertion, but sending both bytes as
+//  one 16-bit transfer saves a round trip through the SPI library.
+inline void RA8875::writeCmd(uint8_t x)
+{
+  if (m_pendingWait != RA8875_WAIT_NONE)
+    syncEngine();
+
+  if (m_readActive)
+    setBusClock(false);
+
+  RA8875_STATS_ADD(cmdCycles, 1);
+  RA8875_STATS_ADD(csToggles, 1);
+  RA8875_STATS_ADD(bytes, 2);
+  m_bus.select();
+  m_bus.transfer16((RA8875_CMD_WRITE << 8) | x);
+  m_bus.deselect();
+
+  m_cmdReg = x;
+  if (m_recorder)
+    recordCmd(x);
+}
+
+inline void RA8875::writeData(uint8_t x)
+{
+  if (m_recorder)
+    recordData(x);
+
+  RA8875_STATS_ADD(dataCycles, 1);
+  RA8875_STATS_ADD(csToggles, 1);
+  RA8875_STATS_ADD(bytes, 2);
+  m_bus.select();
+  m_bus.transfer16((RA8875_DATA_WRITE << 8) | x);
+  m_bus.deselect();
+}
+
+// Sends a single pixel as one data cycle. At 16bpp both bytes go out under the same CS assertion.
+inline void RA8875::writePixelData(uint16_t color)
+{
+  if (m_recorder)
+  {
+    uint8_t bytes[2] = { (uint8_t) (color >> 8), (uint8_t) color };
+    if (m_depth == 8)
+      recordPixels(bytes + 1, 1);
+    else
+      recordPixels(bytes, 2);
+  }
+
+  RA8875_STATS_ADD(dataCycles, 1);
+  RA8875_STATS_ADD(csToggles, 1);
+  RA8875_STATS_ADD(bytes, 1 + m_depth / 8);
+  m_bus.select();
+  if (m_depth == 8)
+    m_bus.transfer16((RA8875_DATA_WRITE << 8) | (color & 0xFF));
+  else
+  {
+    m_bus.transfer(RA8875_DATA_WRITE);
+    m_bus.transfer16(color);
+  }
+  m_bus.deselect();
+}
+
+inline uint8_t RA8875::readData(void)
+{
+  if (m_splitClocks && !m_readActive)
+    setBusClock(true);
+
+  // Reads aren't recorded, nor is the command cycle that selected the register
+  if (m_recorder)
+    m_recorder->cmd = -1;
+
+  RA8875_STATS_ADD(readCycles, 1);
+  RA8875_STATS_ADD(csToggles, 1);
+  RA8875_STATS_ADD(bytes, 2);
+  m_bus.select();
+  m_bus.transfer(RA8875_DATA_READ);
+  uint8_t x = m_bus.transfer(0);
+  m_bus.deselect();
+  return x;
+}
+
+// Reads the special status register.
+// This register uses a special cycle type instead of having an address like other registers.
+inline uint8_t RA8875::readStatus(void)
+{
+  if (m_pendingWait != RA8875_WAIT_NONE)
+    syncEngine();
+
+  if (m_splitClocks && !m_readActive)
+    setBusClock(true);
+
+  RA8875_STATS_ADD(readCycles, 1);
+  RA8875_STATS_ADD(csToggles, 1);
+  RA8875_STATS_ADD(bytes, 2);
+  m_bus.select();
+  m_bus.transfer(RA8875_STATUS_READ);
+  uint8_t x = m_bus.transfer(0);
+  m_bus.deselect();
+  return x;
+}
+
+inline void RA8875::writeReg(uint8_t reg, uint8_t x)
+{
+  writeCmd(reg);
+  writeData(x);
+}
+
+inline uint8_t RA8875::readReg(uint8_t reg)
+{
+  writeCmd(reg);
+  return readData();
+}
+
 #endif
@@ -0,0 +1,171 @@
+#pragma GCC diagnostic warning "-Wall"
+
+#ifndef RA8875_BUS_H
+#define RA8875_BUS_H
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// Bus policies. The RA8875 class talks to the chip only through one of these, selected at compile
+//  time with RA8875_BUS. They are plain classes with no virtual methods, so for the hardware
+//  policies the compiler can inline a whole register write down to the SPI and port accesses.
+//
+// A policy provides:
+//   void begin(int csPin);
+//   void beginTransaction(const SPISettings &settings);
+//   void endTransaction(void);
+//   void select(void);    // CS low
+//   void deselect(void);  // CS high
+//   uint8_t transfer(uint8_t x);
+//   uint16_t transfer16(uint16_t x);
+//   void transfer(void *buf, size_t count);  // Buffer contents are replaced by received bytes
+
+// Default policy: the global SPI object and digitalWrite() for CS.
+class RA8875_ArduinoBus
+{
+protected:
+  int m_csPin;
+
+public:
+  RA8875_ArduinoBus() { m_csPin = -1; };
+
+  void begin(int csPin)
+  {
+    m_csPin = csPin;
+    pinMode(m_csPin, OUTPUT);
+    digitalWrite(m_csPin, HIGH);
+    SPI.begin();
+  };
+
+  void beginTransaction(const SPISettings &settings) { SPI.beginTransaction(settings); };
+  void endTransaction(void) { SPI.endTransaction(); };
+
+  void select(void) { digitalWrite(m_csPin, LOW); };
+  void deselect(void) { digitalWrite(m_csPin, HIGH); };
+
+  uint8_t transfer(uint8_t x) { return SPI.transfer(x); };
+  uint16_t transfer16(uint16_t x) { return SPI.transfer16(x); };
+  void transfer(void *buf, size_t count) { SPI.transfer(buf, count); };
+};
+
+// Same as the default policy, but drives CS through the port registers instead of digitalWrite().
+#if defined(__AVR__)
+class RA8875_PortBus : public RA8875_ArduinoBus
+{
+private:
+  volatile uint8_t *m_csPort;
+  uint8_t m_csMask;
+
+public:
+  void begin(int csPin)
+  {
+    RA8875_ArduinoBus::begin(csPin);
+    m_csPort = portOutputRegister(digitalPinToPort(csPin));
+    m_csMask = digitalPinToBitMask(csPin);
+  };
+
+  // Not atomic, so CS must not share a port with pins written from interrupt handlers
+  void select(void) { *m_csPort &= ~m_csMask; };
+  void deselect(void) { *m_csPort |= m_csMask; };
+};
+#elif defined(ARDUINO_ARCH_SAMD)
+class RA8875_PortBus : public RA8875_ArduinoBus
+{
+private:
+  volatile uint32_t *m_csClr;
+  volatile uint32_t *m_csSet;
+  uint32_t m_csMask;
+
+public:
+  void begin(int csPin)
+  {
+    RA8875_ArduinoBus::begin(csPin);
+    m_csClr  = &(digitalPinToPort(csPin)->OUTCLR.reg);
+    m_csSet  = &(digitalPinToPort(csPin)->OUTSET.reg);
+    m_csMask = digitalPinToBitMask(csPin);
+  };
+
+  void select(void) { *m_csClr = m_csMask; };
+  void deselect(void) { *m_csSet = m_csMask; };
+};
+#endif
+
+// Something on the other end of a RA8875_RecordingBus, such as a chip emulator.
+class RA8875_BusDevice
+{
+public:
+  virtual ~RA8875_BusDevice() {};
+
+  virtual void select(void) {};
+  virtual void deselect(void) {};
+  virtual void setClock(uint32_t hz) { (void) hz; };
+  virtual uint8_t transfer(uint8_t x) = 0;
+};
+
+// Policy with no hardware behind it. It counts traffic and passes bytes to an optional
+//  RA8875_BusDevice, so the driver can be built and run on a host machine.
+class RA8875_RecordingBus
+{
+private:
+  RA8875_BusDevice *m_device;
+
+  uint32_t m_bytes;
+  uint32_t m_selects;
+  uint32_t m_transactions;
+
+public:
+  RA8875_RecordingBus() { m_device = NULL; resetCounts(); };
+
+  void setDevice(RA8875_BusDevice *device) { m_device = device; };
+  RA8875_BusDevice *getDevice(void) { return m_device; };
+
+  // Counters
+  void resetCounts(void) { m_bytes = 0; m_selects = 0; m_transactions = 0; };
+  uint32_t getBytes(void) { return m_bytes; };
+  uint32_t getSelects(void) { return m_selects; };
+  uint32_t getTransactions(void) { return m_transactions; };
+
+  void begin(int csPin) { (void) csPin; };
+
+  void beginTransaction(const SPISettings &settings)
+  {
+    m_transactions++;
+#ifdef RA8875_HOST_SPI_H
+    // Only the host SPI stand-in lets us see the clock
+    if (m_device)
+      m_device->setClock(settings.clock);
+#else
+    (void) settings;
+#endif
+  };
+  void endTransaction(void) {};
+
+  void select(void) { m_selects++; if (m_device) m_device->select(); };
+  void deselect(void) { if (m_device) m_device->deselect(); };
+
+  uint8_t transfer(uint8_t x)
+  {
+    m_bytes++;
+    return m_device ? m_device->transfer(x) : 0x00;  // Nothing attached: never busy
+  };
+
+  uint16_t transfer16(uint16_t x)
+  {
+    uint8_t hi = transfer(x >> 8);
+    return (hi << 8) | transfer(x & 0xFF);
+  };
+
+  void transfer(void *buf, size_t count)
+  {
+    uint8_t *p = (uint8_t *) buf;
+    for (size_t i = 0; i < count; i++)
+      p[i] = transfer(p[i]);
+  };
+};
+
+// Policy used by the RA8875 class. One of the layout settings listed in NiftyRA8875.h.
+#ifndef RA8875_BUS
+# define RA8875_BUS RA8875_ArduinoBus
+#endif
+
+#endif
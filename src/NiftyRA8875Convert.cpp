@@ -0,0 +1,392 @@
+#pragma GCC diagnostic warning "-Wall"
+#include "NiftyRA8875Convert.h"
+
+#if RA8875_CONVERT_KERNEL == 2
+# if defined(__ARM_NEON)
+#  include <arm_neon.h>
+# elif defined(__SSSE3__)
+#  include <tmmintrin.h>
+# else
+#  error "RA8875_CONVERT_KERNEL 2 needs NEON or SSSE3"
+# endif
+#elif (RA8875_CONVERT_KERNEL == 1) && defined(__ARM_FEATURE_SIMD32)
+# include <arm_acle.h>
+#endif
+
+// 4x4 ordered dither matrix, values 0-15
+static const uint8_t s_bayer[4][4] PROGMEM =
+{
+  {  0,  8,  2, 10 },
+  { 12,  4, 14,  6 },
+  {  3, 11,  1,  9 },
+  { 15,  7, 13,  5 }
+};
+
+// Dither amounts for one row of the pattern, indexed by column and then channel (R, G, B). Each
+//  is scaled to the number of bits its channel loses.
+typedef uint8_t RA8875_Dither_Row[4][3];
+
+static void ditherRow(RA8875_Dither_Row row, int y, int dropR, int dropG, int dropB)
+{
+  for (int x = 0; x < 4; x++)
+  {
+    uint8_t m = pgm_read_byte(&s_bayer[y & 3][x]);
+    row[x][0] = (m << dropR) >> 4;
+    row[x][1] = (m << dropG) >> 4;
+    row[x][2] = (m << dropB) >> 4;
+  }
+}
+
+static inline uint8_t addSat(uint8_t a, uint8_t b)
+{
+  uint16_t s = a + b;
+  return (s > 255) ? 255 : s;
+}
+
+// --- Portable kernels ---
+// Dithering is skipped when dither is NULL.
+
+static void scalar565(uint8_t *dst, const uint8_t *src, size_t count, const RA8875_Dither_Row dither, int x)
+{
+  for (size_t i = 0; i < count; i++, src += 3, dst += 2)
+  {
+    uint8_t r = src[0], g = src[1], b = src[2];
+
+    if (dither)
+    {
+      const uint8_t *d = dither[(x + i) & 3];
+      r = addSat(r, d[0]);
+      g = addSat(g, d[1]);
+      b = addSat(b, d[2]);
+    }
+
+    dst[0] = (r & 0xF8) | (g >> 5);
+    dst[1] = ((g << 3) & 0xE0) | (b >> 3);
+  }
+}
+
+static void scalar332(uint8_t *dst, const uint8_t *src, size_t count, const RA8875_Dither_Row dither, int x)
+{
+  for (size_t i = 0; i < count; i++, src += 3)
+  {
+    uint8_t r = src[0], g = src[1], b = src[2];
+
+    if (dither)
+    {
+      const uint8_t *d = dither[(x + i) & 3];
+      r = addSat(r, d[0]);
+      g = addSat(g, d[1]);
+      b = addSat(b, d[2]);
+    }
+
+    dst[i] = (r & 0xE0) | ((g & 0xE0) >> 3) | (b >> 6);
+  }
+}
+
+#if RA8875_CONVERT_KERNEL == 1
+// --- Word at a time ---
+// Four pixels are twelve bytes, so three 32-bit words. Little-endian targets only.
+
+static inline uint32_t load32(const uint8_t *p) { uint32_t w; memcpy(&w, p, 4); return w; }
+static inline void store32(uint8_t *p, uint32_t w) { memcpy(p, &w, 4); }
+
+// Saturating add of four bytes at once
+static inline uint32_t addSat4(uint32_t a, uint32_t b)
+{
+#if defined(__ARM_FEATURE_SIMD32)
+  return __uqadd8(a, b);
+#else
+  uint32_t s = (a & 0x7F7F7F7F) + (b & 0x7F7F7F7F);      // Bits 0-6 of each byte, carry into bit 7
+  uint32_t c = ((a & b) | ((a | b) & s)) & 0x80808080;  // Carry out of each byte
+  return (s ^ ((a ^ b) & 0x80808080)) | ((c >> 7) * 0xFF);
+#endif
+}
+
+// Lays a row of the dither pattern out the way four pixels sit in three words.
+static void ditherWords(uint32_t *t, const RA8875_Dither_Row dither, int x)
+{
+  uint8_t b[12];
+  for (int i = 0; i < 4; i++)
+    memcpy(&b[i * 3], dither[(x + i) & 3], 3);
+
+  t[0] = load32(&b[0]);
+  t[1] = load32(&b[4]);
+  t[2] = load32(&b[8]);
+}
+
+// Two pixels packed as they go on the wire: high byte first
+static inline uint32_t pack565x2(uint32_t r0, uint32_t g0, uint32_t b0, uint32_t r1, uint32_t g1, uint32_t b1)
+{
+  uint32_t p0 = ((r0 & 0xF8) | (g0 >> 5)) | ((((g0 << 3) & 0xE0) | (b0 >> 3)) << 8);
+  uint32_t p1 = ((r1 & 0xF8) | (g1 >> 5)) | ((((g1 << 3) & 0xE0) | (b1 >> 3)) << 8);
+  return p0 | (p1 << 16);
+}
+
+static size_t kernel565(uint8_t *dst, const uint8_t *src, size_t count, const RA8875_Dither_Row dither, int x)
+{
+  uint32_t t[3];
+  if (dither)
+    ditherWords(t, dither, x);
+
+  size_t groups = count / 4;
+  for (size_t i = 0; i < groups; i++, src += 12, dst += 8)
+  {
+    uint32_t w0 = load32(src), w1 = load32(src + 4), w2 = load32(src + 8);
+
+    if (dither)
+    {
+      w0 = addSat4(w0, t[0]);
+      w1 = addSat4(w1, t[1]);
+      w2 = addSat4(w2, t[2]);
+    }
+
+    // w0 = R0 G0 B0 R1, w1 = G1 B1 R2 G2, w2 = B2 R3 G3 B3
+    store32(dst,     pack565x2(w0 & 0xFF, (w0 >> 8) & 0xFF, (w0 >> 16) & 0xFF, w0 >> 24, w1 & 0xFF, (w1 >> 8) & 0xFF));
+    store32(dst + 4, pack565x2((w1 >> 16) & 0xFF, w1 >> 24, w2 & 0xFF, (w2 >> 8) & 0xFF, (w2 >> 16) & 0xFF, w2 >> 24));
+  }
+
+  return groups * 4;
+}
+
+static size_t kernel332(uint8_t *dst, const uint8_t *src, size_t count, const RA8875_Dither_Row dither, int x)
+{
+  uint32_t t[3];
+  if (dither)
+    ditherWords(t, dither, x);
+
+  size_t groups = count / 4;
+  for (size_t i = 0; i < groups; i++, src += 12, dst += 4)
+  {
+    uint32_t w0 = load32(src), w1 = load32(src + 4), w2 = load32(src + 8);
+
+    if (dither)
+    {
+      w0 = addSat4(w0, t[0]);
+      w1 = addSat4(w1, t[1]);
+      w2 = addSat4(w2, t[2]);
+    }
+
+    // Mask every channel in place, then gather. Bytes are R0 G0 B0 R1 | G1 B1 R2 G2 | B2 R3 G3 B3.
+    w0 &= 0xE0C0E0E0;
+    w1 &= 0xE0E0C0E0;
+    w2 &= 0xC0E0E0C0;
+
+    uint32_t p0 = (w0 & 0xFF) | ((w0 >> 11) & 0x1C) | ((w0 >> 22) & 0x03);
+    uint32_t p1 = (w0 >> 24) | ((w1 >> 3) & 0x1C) | ((w1 >> 14) & 0x03);
+    uint32_t p2 = ((w1 >> 16) & 0xFF) | ((w1 >> 27) & 0x1C) | ((w2 >> 6) & 0x03);
+    uint32_t p3 = ((w2 >> 8) & 0xFF) | ((w2 >> 19) & 0x1C) | (w2 >> 30);
+
+    store32(dst, p0 | (p1 << 8) | (p2 << 16) | (p3 << 24));
+  }
+
+  return groups * 4;
+}
+
+#elif RA8875_CONVERT_KERNEL == 2
+// --- SIMD, sixteen pixels at a time ---
+
+// Lays a row of the dither pattern out for sixteen pixels, one array per channel.
+static void ditherLanes(uint8_t lanes[3][16], const RA8875_Dither_Row dither, int x)
+{
+  for (int i = 0; i < 16; i++)
+  {
+    for (int c = 0; c < 3; c++)
+      lanes[c][i] = dither[(x + i) & 3][c];
+  }
+}
+
+# if defined(__ARM_NEON)
+
+static size_t kernel565(uint8_t *dst, const uint8_t *src, size_t count, const RA8875_Dither_Row dither, int x)
+{
+  uint8_t lanes[3][16];
+  uint8x16_t tr = vdupq_n_u8(0), tg = tr, tb = tr;
+  if (dither)
+  {
+    ditherLanes(lanes, dither, x);
+    tr = vld1q_u8(lanes[0]);
+    tg = vld1q_u8(lanes[1]);
+    tb = vld1q_u8(lanes[2]);
+  }
+
+  size_t blocks = count / 16;
+  for (size_t i = 0; i < blocks; i++, src += 48, dst += 32)
+  {
+    uint8x16x3_t rgb = vld3q_u8(src);  // Splits the channels
+    uint8x16_t r = vqaddq_u8(rgb.val[0], tr);
+    uint8x16_t g = vqaddq_u8(rgb.val[1], tg);
+    uint8x16_t b = vqaddq_u8(rgb.val[2], tb);
+
+    uint8x16x2_t out;
+    out.val[0] = vorrq_u8(vandq_u8(r, vdupq_n_u8(0xF8)), vshrq_n_u8(g, 5));
+    out.val[1] = vorrq_u8(vandq_u8(vshlq_n_u8(g, 3), vdupq_n_u8(0xE0)), vshrq_n_u8(b, 3));
+    vst2q_u8(dst, out);  // Interleaves high and low bytes
+  }
+
+  return blocks * 16;
+}
+
+static size_t kernel332(uint8_t *dst, const uint8_t *src, size_t count, const RA8875_Dither_Row dither, int x)
+{
+  uint8_t lanes[3][16];
+  uint8x16_t tr = vdupq_n_u8(0), tg = tr, tb = tr;
+  if (dither)
+  {
+    ditherLanes(lanes, dither, x);
+    tr = vld1q_u8(lanes[0]);
+    tg = vld1q_u8(lanes[1]);
+    tb = vld1q_u8(lanes[2]);
+  }
+
+  size_t blocks = count / 16;
+  for (size_t i = 0; i < blocks; i++, src += 48, dst += 16)
+  {
+    uint8x16x3_t rgb = vld3q_u8(src);
+    uint8x16_t r = vqaddq_u8(rgb.val[0], tr);
+    uint8x16_t g = vqaddq_u8(rgb.val[1], tg);
+    uint8x16_t b = vqaddq_u8(rgb.val[2], tb);
+
+    uint8x16_t p = vandq_u8(r, vdupq_n_u8(0xE0));
+    p = vorrq_u8(p, vandq_u8(vshrq_n_u8(g, 3), vdupq_n_u8(0x1C)));
+    p = vorrq_u8(p, vshrq_n_u8(b, 6));
+    vst1q_u8(dst, p);
+  }
+
+  return blocks * 16;
+}
+
+# else  // SSSE3
+
+// Splits sixteen RGB888 pixels into one register per channel.
+static inline void loadRGB16(const uint8_t *src, __m128i *r, __m128i *g, __m128i *b)
+{
+  __m128i a = _mm_loadu_si128((const __m128i *) src);
+  __m128i m = _mm_loadu_si128((const __m128i *) (src + 16));
+  __m128i z = _mm_loadu_si128((const __m128i *) (src + 32));
+
+  // Byte picks for each third of the input; -1 gives zero
+  *r = _mm_or_si128(_mm_or_si128(
+    _mm_shuffle_epi8(a, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+    _mm_shuffle_epi8(m, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1))),
+    _mm_shuffle_epi8(z, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)));
+  *g = _mm_or_si128(_mm_or_si128(
+    _mm_shuffle_epi8(a, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+    _mm_shuffle_epi8(m, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1))),
+    _mm_shuffle_epi8(z, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)));
+  *b = _mm_or_si128(_mm_or_si128(
+    _mm_shuffle_epi8(a, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+    _mm_shuffle_epi8(m, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1))),
+    _mm_shuffle_epi8(z, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)));
+}
+
+// There are no 8-bit shifts, so shift 16-bit lanes and mask off what crossed between bytes
+#define RA8875_SRL8(v, n) _mm_and_si128(_mm_srli_epi16(v, n), _mm_set1_epi8((char) (0xFF >> (n))))
+#define RA8875_SLL8(v, n) _mm_and_si128(_mm_slli_epi16(v, n), _mm_set1_epi8((char) ((0xFF << (n)) & 0xFF)))
+
+static size_t kernel565(uint8_t *dst, const uint8_t *src, size_t count, const RA8875_Dither_Row dither, int x)
+{
+  uint8_t lanes[3][16];
+  __m128i tr = _mm_setzero_si128(), tg = tr, tb = tr;
+  if (dither)
+  {
+    ditherLanes(lanes, dither, x);
+    tr = _mm_loadu_si128((const __m128i *) lanes[0]);
+    tg = _mm_loadu_si128((const __m128i *) lanes[1]);
+    tb = _mm_loadu_si128((const __m128i *) lanes[2]);
+  }
+
+  size_t blocks = count / 16;
+  for (size_t i = 0; i < blocks; i++, src += 48, dst += 32)
+  {
+    __m128i r, g, b;
+    loadRGB16(src, &r, &g, &b);
+    r = _mm_adds_epu8(r, tr);
+    g = _mm_adds_epu8(g, tg);
+    b = _mm_adds_epu8(b, tb);
+
+    __m128i hi = _mm_or_si128(_mm_and_si128(r, _mm_set1_epi8((char) 0xF8)), RA8875_SRL8(g, 5));
+    __m128i lo = _mm_or_si128(_mm_and_si128(RA8875_SLL8(g, 3), _mm_set1_epi8((char) 0xE0)), RA8875_SRL8(b, 3));
+
+    // Interleave high and low bytes
+    _mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i *) (dst + 16), _mm_unpackhi_epi8(hi, lo));
+  }
+
+  return blocks * 16;
+}
+
+static size_t kernel332(uint8_t *dst, const uint8_t *src, size_t count, const RA8875_Dither_Row dither, int x)
+{
+  uint8_t lanes[3][16];
+  __m128i tr = _mm_setzero_si128(), tg = tr, tb = tr;
+  if (dither)
+  {
+    ditherLanes(lanes, dither, x);
+    tr = _mm_loadu_si128((const __m128i *) lanes[0]);
+    tg = _mm_loadu_si128((const __m128i *) lanes[1]);
+    tb = _mm_loadu_si128((const __m128i *) lanes[2]);
+  }
+
+  size_t blocks = count / 16;
+  for (size_t i = 0; i < blocks; i++, src += 48, dst += 16)
+  {
+    __m128i r, g, b;
+    loadRGB16(src, &r, &g, &b);
+    r = _mm_adds_epu8(r, tr);
+    g = _mm_adds_epu8(g, tg);
+    b = _mm_adds_epu8(b, tb);
+
+    __m128i p = _mm_and_si128(r, _mm_set1_epi8((char) 0xE0));
+    p = _mm_or_si128(p, _mm_and_si128(RA8875_SRL8(g, 3), _mm_set1_epi8(0x1C)));
+    p = _mm_or_si128(p, RA8875_SRL8(b, 6));
+    _mm_storeu_si128((__m128i *) dst, p);
+  }
+
+  return blocks * 16;
+}
+
+#undef RA8875_SRL8
+#undef RA8875_SLL8
+
+# endif
+
+#else
+// --- Portable only ---
+
+static inline size_t kernel565(uint8_t *, const uint8_t *, size_t, const RA8875_Dither_Row, int) { return 0; }
+static inline size_t kernel332(uint8_t *, const uint8_t *, size_t, const RA8875_Dither_Row, int) { return 0; }
+
+#endif
+
+// --- Entry points ---
+// The kernel takes as many whole blocks as it can, and the portable loop finishes the row.
+
+void RA8875_rgb888To565(uint8_t *dst, const uint8_t *src, size_t count)
+{
+  size_t done = kernel565(dst, src, count, NULL, 0);
+  scalar565(dst + done * 2, src + done * 3, count - done, NULL, 0);
+}
+
+void RA8875_rgb888To332(uint8_t *dst, const uint8_t *src, size_t count)
+{
+  size_t done = kernel332(dst, src, count, NULL, 0);
+  scalar332(dst + done, src + done * 3, count - done, NULL, 0);
+}
+
+void RA8875_rgb888To565Dither(uint8_t *dst, const uint8_t *src, size_t count, int x, int y)
+{
+  RA8875_Dither_Row dither;
+  ditherRow(dither, y, 3, 2, 3);  // Red and blue lose 3 bits, green 2
+
+  size_t done = kernel565(dst, src, count, dither, x);
+  scalar565(dst + done * 2, src + done * 3, count - done, dither, x + done);
+}
+
+void RA8875_rgb888To332Dither(uint8_t *dst, const uint8_t *src, size_t count, int x, int y)
+{
+  RA8875_Dither_Row dither;
+  ditherRow(dither, y, 5, 5, 6);  // Red and green lose 5 bits, blue 6
+
+  size_t done = kernel332(dst, src, count, dither, x);
+  scalar332(dst + done, src + done * 3, count - done, dither, x + done);
+}
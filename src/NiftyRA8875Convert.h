@@ -0,0 +1,41 @@
+#pragma GCC diagnostic warning "-Wall"
+
+#ifndef RA8875_CONVERT_H
+#define RA8875_CONVERT_H
+
+#include <Arduino.h>
+
+// Row conversion from RGB888 (R, G, B bytes) to the chip's pixel formats.
+//
+// Output is in the byte order the chip is sent pixels in, so it can go straight to
+//  RA8875::pushPixelBytes(): RGB565 is two bytes per pixel, high byte first, and RGB332 is one
+//  byte per pixel.
+//
+// The dithering variants add a 4x4 ordered (Bayer) pattern before dropping the low bits, which
+//  hides banding in gradients. x and y are the screen position of the first pixel, so that the
+//  pattern lines up from row to row and between calls.
+
+// Which kernel does the work:
+//   0: Portable, one pixel at a time
+//   1: Word at a time: four pixels from three 32-bit loads, with the dither added to four bytes at
+//       once (a single UQADD8 on Cortex-M4/M7, such as the SAMD51)
+//   2: SIMD, sixteen pixels at a time (NEON, or SSSE3 in the host build)
+// The default is the best one available. Any leftover pixels at the end of a row go through the
+//  portable kernel.
+#ifndef RA8875_CONVERT_KERNEL
+# if defined(__ARM_NEON) || defined(__SSSE3__)
+#  define RA8875_CONVERT_KERNEL 2
+# elif defined(__AVR__)
+#  define RA8875_CONVERT_KERNEL 0
+# else
+#  define RA8875_CONVERT_KERNEL 1
+# endif
+#endif
+
+void RA8875_rgb888To565(uint8_t *dst, const uint8_t *src, size_t count);
+void RA8875_rgb888To332(uint8_t *dst, const uint8_t *src, size_t count);
+
+void RA8875_rgb888To565Dither(uint8_t *dst, const uint8_t *src, size_t count, int x, int y);
+void RA8875_rgb888To332Dither(uint8_t *dst, const uint8_t *src, size_t count, int x, int y);
+
+#endif